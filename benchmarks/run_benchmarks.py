@@ -0,0 +1,196 @@
+#!/usr/bin/env python3
+#
+# Geant4 based dose simulation for insects
+# Copyright (C) 2025
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 3 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+"""End-to-end performance benchmark of the six production scenarios.
+
+Runs the benchmark macros (reduced-event, fixed-seed versions of macros/run_*_mono.mac and run_*_wb.mac) one after
+the other and records per scenario:
+
+  initTime         s, process start until the run starts (geometry, physics tables) = elapsed - run wall time
+  eventsPerSecond  from the JSON summary of the run
+  peakRssMB        peak resident memory of the process
+  fom              figure of merit of the insect dose, 1 / (relative error^2 * run wall time)
+
+The results are written as JSON and compared with a stored baseline: a metric more than the tolerance worse than
+the baseline is a regression (exit status 1). Without a baseline, or for a scenario missing from it, the results of
+this run are recorded as the baseline and there is nothing to compare. Run from the build directory (the macros use
+the copied assets):
+
+  cmake --build . --target bench            # compare with benchmarks/baseline.json
+  cmake --build . --target bench_baseline   # record the baseline on this machine
+"""
+
+import argparse
+import json
+import os
+import platform
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+# Metric, whether larger values are better
+METRICS = [("initTime", False), ("eventsPerSecond", True), ("peakRssMB", False), ("fom", True)]
+
+
+def run_scenario(executable, macro, log_file):
+    """Runs one macro and returns its metrics, or None if the run failed."""
+    with tempfile.NamedTemporaryFile(suffix=".json", delete=False) as summary:
+        summary_file = summary.name
+    try:
+        with open(log_file, "w") as log:
+            start = time.monotonic()
+            process = subprocess.Popen([executable, "--json", summary_file, macro], stdout=log,
+                                       stderr=subprocess.STDOUT)
+            # wait4: resource usage of this child only
+            _, status, usage = os.wait4(process.pid, 0)
+            elapsed = time.monotonic() - start
+            process.returncode = os.waitstatus_to_exitcode(status)
+        if process.returncode != 0:
+            return None
+        with open(summary_file) as f:
+            lines = [line for line in f if line.strip()]
+        if not lines:
+            return None
+        result = json.loads(lines[-1])
+    finally:
+        os.unlink(summary_file)
+
+    insect = result["insect"]
+    wall_time = result["wallTime"]
+    rel_error = result["volumes"].get(insect, {}).get("relError", 0.0)
+    return {
+        "insect": insect,
+        "events": result["events"],
+        "wallTime": wall_time,
+        "initTime": max(0.0, elapsed - wall_time),
+        "eventsPerSecond": result["eventsPerSecond"],
+        # ru_maxrss is in kB on Linux
+        "peakRssMB": usage.ru_maxrss / 1024.0,
+        "fom": 1.0 / (rel_error * rel_error * wall_time) if rel_error > 0.0 and wall_time > 0.0 else 0.0,
+    }
+
+
+def median_metrics(runs):
+    merged = dict(runs[0])
+    for name, _ in METRICS + [("wallTime", False)]:
+        merged[name] = statistics.median(run[name] for run in runs)
+    return merged
+
+
+def compare(results, baseline, tolerance, fom_tolerance):
+    """Prints the comparison table and returns the lists of regressions and of scenarios without a baseline."""
+    regressions = []
+    missing = []
+    print("%-22s %-16s %14s %14s %9s" % ("Scenario", "Metric", "Baseline", "Current", "Change"))
+    for scenario, metrics in results.items():
+        reference = baseline.get(scenario)
+        if reference is None:
+            print("%-22s %-16s %14s" % (scenario, "", "no baseline"))
+            missing.append(scenario)
+            continue
+        for name, larger_is_better in METRICS:
+            old, new = reference.get(name, 0.0), metrics[name]
+            change = (new - old) / old if old > 0.0 else 0.0
+            allowed = fom_tolerance if name == "fom" else tolerance
+            worse = -change if larger_is_better else change
+            flag = ""
+            if worse > allowed:
+                flag = "  REGRESSION"
+                regressions.append("%s %s %+.1f%%" % (scenario, name, 100.0 * change))
+            print("%-22s %-16s %14.4g %14.4g %+8.1f%%%s" % (scenario, name, old, new, 100.0 * change, flag))
+    return regressions, missing
+
+
+def main():
+    script_dir = os.path.dirname(os.path.abspath(__file__))
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--executable", default="./insect_dose_sim_batch", help="simulation executable")
+    parser.add_argument("--macros", default=os.path.join(script_dir, "macros"), help="directory of bench_*.mac")
+    parser.add_argument("--scenarios", nargs="*", help="only these scenarios (e.g. drosophila_mono)")
+    parser.add_argument("--repetitions", type=int, default=1, help="runs per scenario, the median is kept")
+    parser.add_argument("--output", default="bench_results.json", help="results file")
+    parser.add_argument("--baseline", default=os.path.join(script_dir, "baseline.json"), help="baseline file")
+    parser.add_argument("--tolerance", type=float, default=0.10,
+                        help="allowed relative degradation of time, rate and memory (default 0.10)")
+    parser.add_argument("--fom-tolerance", type=float, default=0.20,
+                        help="allowed relative degradation of the figure of merit (default 0.20)")
+    parser.add_argument("--update-baseline", action="store_true", help="write the results as the new baseline")
+    args = parser.parse_args()
+
+    macros = sorted(f for f in os.listdir(args.macros) if f.startswith("bench_") and f.endswith(".mac"))
+    scenarios = {f[len("bench_"):-len(".mac")]: os.path.join(args.macros, f) for f in macros}
+    if args.scenarios:
+        unknown = set(args.scenarios) - set(scenarios)
+        if unknown:
+            sys.exit("Unknown scenarios: " + ", ".join(sorted(unknown)))
+        scenarios = {name: scenarios[name] for name in args.scenarios}
+
+    results = {}
+    for name, macro in scenarios.items():
+        runs = []
+        for repetition in range(args.repetitions):
+            print("Running %s (%d/%d)" % (name, repetition + 1, args.repetitions), flush=True)
+            run = run_scenario(args.executable, macro, "bench_%s.log" % name)
+            if run is None:
+                sys.exit("Scenario %s failed, see bench_%s.log" % (name, name))
+            runs.append(run)
+        results[name] = median_metrics(runs)
+
+    report = {"machine": platform.node(), "cpus": os.cpu_count(), "date": time.strftime("%Y-%m-%d %H:%M:%S"),
+              "scenarios": results}
+    with open(args.output, "w") as f:
+        json.dump(report, f, indent=2)
+    print("Results saved to " + args.output)
+
+    if args.update_baseline:
+        with open(args.baseline, "w") as f:
+            json.dump(report, f, indent=2)
+        print("Baseline saved to " + args.baseline)
+        return 0
+
+    if not os.path.exists(args.baseline):
+        with open(args.baseline, "w") as f:
+            json.dump(report, f, indent=2)
+        print("No baseline at %s: recorded this run as the baseline, nothing to compare. Re-record it on the "
+              "reference machine with --update-baseline (target bench_baseline)" % args.baseline)
+        return 0
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+    if baseline.get("machine") != report["machine"] or baseline.get("cpus") != report["cpus"]:
+        print("Warning: the baseline was recorded on %s (%s CPUs), timings are not comparable across machines"
+              % (baseline.get("machine"), baseline.get("cpus")))
+
+    regressions, missing = compare(results, baseline.get("scenarios", {}), args.tolerance, args.fom_tolerance)
+    if regressions:
+        print("Performance regressions: " + "; ".join(regressions))
+        return 1
+    if missing:
+        baseline.setdefault("scenarios", {}).update({name: results[name] for name in missing})
+        with open(args.baseline, "w") as f:
+            json.dump(baseline, f, indent=2)
+        print("No baseline for %s: recorded this run for them, nothing to compare (re-record the whole baseline "
+              "with --update-baseline, target bench_baseline)" % ", ".join(missing))
+    print("No performance regressions")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
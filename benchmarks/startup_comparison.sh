@@ -0,0 +1,34 @@
+#!/bin/bash
+# Start-up time and resident memory of the interactive and the batch-only executable, side by side.
+# Both initialise the same simulation (/run/initialize, no events); run from the build directory:
+#   ../benchmarks/startup_comparison.sh [repetitions]
+set -euo pipefail
+
+repetitions=${1:-5}
+macro=$(mktemp --suffix=.mac)
+trap 'rm -f "$macro"' EXIT
+echo "/run/initialize" > "$macro"
+
+if [ ! -x /usr/bin/time ]; then
+    echo "GNU time (/usr/bin/time) is needed to measure the resident memory" >&2
+    exit 1
+fi
+
+printf "%-25s %18s %18s\n" "Executable" "Start-up (s)" "Max. RSS (MB)"
+for executable in insect_dose_sim insect_dose_sim_batch; do
+    if [ ! -x "./$executable" ]; then
+        printf "%-25s %18s %18s\n" "$executable" "not built" "-"
+        continue
+    fi
+    times=()
+    memory=()
+    for ((i = 0; i < repetitions; i++)); do
+        read -r seconds kilobytes < <(/usr/bin/time -f "%e %M" "./$executable" "$macro" 2>&1 >/dev/null | tail -n 1)
+        times+=("$seconds")
+        memory+=("$kilobytes")
+    done
+    # Median over the repetitions
+    median_time=$(printf "%s\n" "${times[@]}" | sort -g | awk '{ v[NR] = $1 } END { print v[int((NR + 1) / 2)] }')
+    median_memory=$(printf "%s\n" "${memory[@]}" | sort -g | awk '{ v[NR] = $1 } END { printf "%.1f", v[int((NR + 1) / 2)] / 1024 }')
+    printf "%-25s %18s %18s\n" "$executable" "$median_time" "$median_memory"
+done
@@ -22,6 +22,8 @@
 
 #include "G4VUserActionInitialization.hh"
 
+class PrimaryGeneratorAction;
+
 class ActionInitialization final : public G4VUserActionInitialization {
 public:
     ActionInitialization();
@@ -31,6 +33,10 @@ public:
     void BuildForMaster() const override;
 
     void Build() const override;
+
+private:
+    // Master-side copy of the generator configuration, see PrimaryGeneratorAction::GetMasterInstance()
+    mutable PrimaryGeneratorAction *masterGenerator{nullptr};
 };
 
 #endif
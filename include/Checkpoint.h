@@ -0,0 +1,130 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef Checkpoint_h
+#define Checkpoint_h
+
+#include "SteppingAction.h"
+#include "globals.hh"
+#include <map>
+#include <string>
+
+class CheckpointMessenger;
+class G4Run;
+
+/**
+ * Crash-safe checkpoints of long runs, and continuing a run from one.
+ *
+ * Every worker periodically stores a snapshot of its own tallies, event count and RNG engine state; the snapshots
+ * of all threads (each consistent in itself) plus the accumulators of earlier segments make up the checkpoint,
+ * which is written to a temporary file and renamed over the previous one, so the file always holds a complete
+ * checkpoint. At the end of a run the master writes the final checkpoint of the merged result.
+ *
+ * Resuming or extending loads a checkpoint as the starting point of the next run: its accumulators are added to
+ * the dose maps and its events to the event count, so the report and its uncertainties cover all segments. A
+ * segment continues on an RNG stream of its own (the master engine is restored from the checkpoint and reseeded
+ * with the segment number), so its events are independent of those of the earlier segments. The engine states of
+ * the workers are recorded as well, but Geant4 reseeds worker engines for every event, so they are not restored.
+ */
+class Checkpoint final {
+public:
+    Checkpoint();
+
+    ~Checkpoint();
+
+    struct State {
+        std::string insect;
+        G4long targetEvents{0}; // events of the logical run (all segments)
+        G4long events{0}; // events in the accumulators
+        G4int segment{0}; // segments (runs) the accumulators come from
+        G4double sourcePhotonsPerEvent{1.0};
+        std::map<std::string, SteppingAction::Tally> tallies;
+        std::string masterEngine; // master RNG engine at the start of the last segment
+        std::map<G4int, std::string> threadEngines; // per thread at its last snapshot
+    };
+
+    /**
+     * Enables periodic checkpoints (empty file name: off)
+     * @param filename checkpoint file
+     * @param interval seconds between the snapshots of a thread
+     */
+    static void Enable(const std::string &filename, G4double interval);
+
+    [[nodiscard]] static G4bool IsEnabled() { return !filename.empty(); }
+
+    [[nodiscard]] static const std::string &GetFilename() { return filename; }
+
+    /**
+     * Loads a checkpoint as the starting point of the next run
+     * @return false (with an error message) if the file cannot be read
+     */
+    static G4bool Load(const std::string &filename);
+
+    /**
+     * Loads a checkpoint and runs its missing events (/run/resume) or *events* more (/run/extend)
+     * @param filename checkpoint file
+     * @param events events to add (0: the events still missing for the logical run of the checkpoint)
+     */
+    static void Continue(const std::string &filename, G4long events = 0);
+
+    /**
+     * Events of the loaded checkpoint still missing for its logical run (0 if it is complete)
+     */
+    [[nodiscard]] static G4long GetRemainingEvents();
+
+    // Events in the accumulators of the loaded checkpoint (0 without one), added to those of the current run
+    [[nodiscard]] static G4long GetBaseEvents() { return base.events; }
+
+    // Segment number of the current run (0 unless it continues a checkpoint)
+    [[nodiscard]] static G4int GetSegment() { return base.segment; }
+
+    /**
+     * Start of a run on every thread; on the master (before the worker seeds are drawn) also adds the loaded
+     * checkpoint to the dose maps and derives the RNG stream of the segment
+     */
+    static void BeginOfRun(const G4Run *run, G4bool master);
+
+    /**
+     * End of an event on a worker: stores a snapshot and writes the checkpoint if the interval has passed
+     */
+    static void EndOfEvent();
+
+    /**
+     * Master, after the merge: writes the final checkpoint of the run and forgets the loaded one
+     * @param events events in the merged dose maps (including those of the loaded checkpoint)
+     */
+    static void EndOfRun(G4long events);
+
+    static G4bool Write(const std::string &filename, const State &state);
+
+    static G4bool Read(const std::string &filename, State &state);
+
+private:
+    static void WriteSnapshots();
+
+    static std::string filename;
+    static G4double interval; // s
+
+    static State base; // loaded checkpoint (accumulators of the earlier segments)
+    static State current; // header of the current run
+
+    CheckpointMessenger *messenger{nullptr};
+};
+
+#endif
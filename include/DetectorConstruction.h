@@ -23,8 +23,10 @@
 #include "G4VUserDetectorConstruction.hh"
 #include "G4LogicalVolume.hh"
 #include <map>
+#include <vector>
 
 class DetectorMessenger; // forward
+class G4TessellatedSolid;
 
 class DetectorConstruction final : public G4VUserDetectorConstruction {
 public:
@@ -41,12 +43,29 @@ public:
 
     [[nodiscard]] G4String GetSelectedInsect() const;
 
+    // Air envelope and region around the meshes, built only for Woodcock tracking (see PhysicsList::SetWoodcock)
+    static constexpr const char *kSpecimenRegion = "Specimen";
+
+    // A loaded STL mesh as placed in the world (placements use no offset or rotation)
+    struct MeshInfo {
+        G4String name; // physical/scoring volume name
+        const G4TessellatedSolid *solid; // raw tessellated mesh (for Ethanol: before the insect is subtracted)
+        G4Material *material;
+    };
+
+    /**
+     * Loaded meshes in navigation priority: the insect first, then Ethanol (which has the insect subtracted)
+     * and the Tube. A point inside several meshes belongs to the first one listed.
+     * @return meshes of the current geometry
+     */
+    [[nodiscard]] const std::vector<MeshInfo> &GetMeshes() const { return meshes; }
+
 private:
     void ConstructMeshes();
 
     static G4ThreeVector GetSTLMeshCenter(const G4String &filename);
 
-    static G4VSolid *LoadSTLSolid(const G4String &filename, const G4String &name, G4double scaleFactor,
+    static G4TessellatedSolid *LoadSTLSolid(const G4String &filename, const G4String &name, G4double scaleFactor,
                                   const G4ThreeVector &offset);
 
     G4VPhysicalVolume *worldPhys;
@@ -54,6 +73,8 @@ private:
 
     std::map<G4String, G4LogicalVolume *> meshLogicalVolumes;
 
+    std::vector<MeshInfo> meshes;
+
     // currently selected insect (default)
     G4String selectedInsect;
 
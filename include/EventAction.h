@@ -21,6 +21,7 @@
 #define EventAction_h
 
 #include "G4UserEventAction.hh"
+#include "globals.hh"
 
 class EventAction final : public G4UserEventAction {
 public:
@@ -31,6 +32,16 @@ public:
     void BeginOfEventAction(const G4Event *event) override;
 
     void EndOfEventAction(const G4Event *event) override;
+
+    /**
+     * Marks every k-th event to be kept (0: none), so that with /vis/drawOnlyToBeKeptEvents the viewer only
+     * receives a decimated sample of the trajectories
+     * @param k event interval
+     */
+    static void SetKeepEvery(const G4int k) { keepEvery = k; }
+
+private:
+    static G4int keepEvery;
 };
 
 #endif
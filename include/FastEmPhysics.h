@@ -0,0 +1,41 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef FastEmPhysics_h
+#define FastEmPhysics_h
+
+#include "G4VPhysicsConstructor.hh"
+
+/**
+ * Lean electromagnetic physics for the keV photon beam: photons (Livermore photo-effect, Klein-Nishina Compton,
+ * Livermore Rayleigh) and electrons (Urban msc, ionisation, bremsstrahlung) only. Positrons are not produced
+ * below the pair threshold and no other particle gets EM processes.
+ */
+class FastEmPhysics final : public G4VPhysicsConstructor {
+public:
+    FastEmPhysics();
+
+    ~FastEmPhysics() override;
+
+    void ConstructParticle() override;
+
+    void ConstructProcess() override;
+};
+
+#endif
@@ -0,0 +1,138 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef ImportanceBiasing_h
+#define ImportanceBiasing_h
+
+#include "globals.hh"
+#include "G4ThreeVector.hh"
+#include <string>
+#include <vector>
+
+class DetectorConstruction;
+class G4GeometrySampler;
+class G4Step;
+class G4VPhysicalVolume;
+class ImportanceMessenger;
+
+/**
+ * Geometry-importance splitting and Russian roulette of photons toward the insect.
+ *
+ * A parallel world (ImportanceWorld) holds nested boxes around the insect: the outermost encloses all meshes, the
+ * innermost the insect, the others are evenly spaced in between. Cell 0 is the space outside the boxes, cell k the
+ * k-th box from the outside. Geant4's importance sampling (G4ImportanceBiasing) splits a photon entering a cell of
+ * higher importance into importance ratio copies of reduced weight and plays Russian roulette when it enters one of
+ * lower importance. The scoring weights every deposit by the track weight, so the dose stays unbiased while more
+ * photon histories reach the insect; the scattered dose, carried by the few photons that scatter in the ethanol
+ * or tube toward the insect, profits most.
+ *
+ * The importances either follow a geometric series (ratio^k, the default) or are set explicitly, or they are
+ * estimated by a pilot run: the importance of a cell is the mean insect dose caused by a unit weight of photons
+ * entering it (and their progeny), relative to the source photons.
+ */
+class ImportanceBiasing final {
+public:
+    // Name of the parallel world
+    static constexpr const char *kWorldName = "ImportanceWorld";
+
+    explicit ImportanceBiasing(DetectorConstruction *detector);
+
+    ~ImportanceBiasing();
+
+    /**
+     * Registers the parallel world and the importance sampling physics (PreInit only; cannot be undone)
+     */
+    void Enable();
+
+    [[nodiscard]] static G4bool IsEnabled() { return enabled; }
+
+    /**
+     * Sets the number of nested boxes (PreInit only) and resets the importances to the geometric series
+     * @param n boxes around the insect
+     */
+    void SetShells(G4int n);
+
+    /**
+     * Sets the importances to ratio^k, k counted from the outside
+     * @param ratio importance ratio of neighbouring cells
+     */
+    void SetRatio(G4double ratio);
+
+    /**
+     * Sets the importances of the boxes from the outermost to the innermost (the outside has importance 1)
+     * @param values one importance per box
+     */
+    void SetImportances(const std::vector<G4double> &values);
+
+    /**
+     * Runs a pilot of *events* events (master, Idle state) and replaces the importances by its estimate. Its
+     * output files get the suffix _pilot.
+     * @param events events of the pilot run
+     */
+    void RunPilot(G4int events);
+
+    /**
+     * Builds the nested boxes in the parallel world around the current meshes (master, ImportanceWorld::Construct)
+     * @param ghostWorld world volume of the parallel world
+     */
+    void BuildCells(G4VPhysicalVolume *ghostWorld);
+
+    /**
+     * Fills the importance store of the calling thread (ImportanceWorld::ConstructSD and after changes)
+     */
+    static void ApplyToThreadStore();
+
+    /**
+     * Brings the importance store of the calling thread up to date with the current importances (every thread)
+     */
+    static void BeginOfRun();
+
+    [[nodiscard]] static G4bool IsPiloting() { return piloting; }
+
+    /**
+     * Pilot run: follows cell crossings of photons and the insect dose of their progeny
+     * @param step
+     */
+    static void ProcessStep(const G4Step *step);
+
+    /**
+     * Pilot run: adds the crossings of the event to the tally of the thread
+     */
+    static void EndOfEvent();
+
+    /**
+     * Pilot run: adds the tally of the calling thread to the merged one and resets it (thread-safe)
+     */
+    static void MergeThreadTally();
+
+private:
+    // Importance cell of a point: the number of boxes containing it
+    static G4int CellOf(const G4ThreeVector &position);
+
+    static void PrintImportances(const std::string &origin);
+
+    DetectorConstruction *detector{nullptr};
+    G4GeometrySampler *sampler{nullptr};
+    ImportanceMessenger *messenger{nullptr};
+
+    static G4bool enabled;
+    static G4bool piloting;
+};
+
+#endif
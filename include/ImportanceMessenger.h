@@ -0,0 +1,50 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef ImportanceMessenger_h
+#define ImportanceMessenger_h
+
+#include "G4UImessenger.hh"
+#include "G4String.hh"
+
+class G4UIcmdWithABool;
+class G4UIcmdWithAnInteger;
+class G4UIcmdWithADouble;
+class G4UIcmdWithAString;
+class ImportanceBiasing;
+
+class ImportanceMessenger final : public G4UImessenger {
+public:
+    explicit ImportanceMessenger(ImportanceBiasing *biasing);
+
+    ~ImportanceMessenger() override;
+
+    void SetNewValue(G4UIcommand *command, G4String newValue) override;
+
+private:
+    ImportanceBiasing *biasing{nullptr};
+    G4UIdirectory *importanceDir{nullptr};
+    G4UIcmdWithABool *enableCmd{nullptr};
+    G4UIcmdWithAnInteger *shellsCmd{nullptr};
+    G4UIcmdWithADouble *ratioCmd{nullptr};
+    G4UIcmdWithAString *importancesCmd{nullptr};
+    G4UIcmdWithAnInteger *pilotCmd{nullptr};
+};
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef ImportanceWorld_h
+#define ImportanceWorld_h
+
+#include "G4VUserParallelWorld.hh"
+
+class ImportanceBiasing;
+
+/**
+ * Parallel world of the importance cells around the insect (see ImportanceBiasing). It holds geometry only, no
+ * materials, and does not change the navigation in the mass world.
+ */
+class ImportanceWorld final : public G4VUserParallelWorld {
+public:
+    explicit ImportanceWorld(ImportanceBiasing *biasing);
+
+    ~ImportanceWorld() override;
+
+    void Construct() override;
+
+    // Every thread fills its importance store here
+    void ConstructSD() override;
+
+private:
+    ImportanceBiasing *biasing{nullptr};
+};
+
+#endif
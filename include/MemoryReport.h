@@ -0,0 +1,82 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef MemoryReport_h
+#define MemoryReport_h
+
+#include "globals.hh"
+#include <cstddef>
+
+/**
+ * Memory footprint of the simulation, to size runs on memory-constrained nodes.
+ *
+ * Shared parts are measured as the growth of the heap (glibc mallinfo2, all arenas; resident memory otherwise)
+ * between marks: geometry and solids around DetectorConstruction::Construct(), physics processes until SetCuts()
+ * and physics tables until the master's PhysicsList::BuildPhysicsTable() returns. /run/initialize starts the
+ * workers right after that (G4MTRunManager::Initialize() runs BeamOn(0)), and each builds its physics, user
+ * actions and navigator: the memory of one worker is the growth from the tables mark until the start of the first
+ * run, divided by the threads. Per-thread state is counted: each thread reports the containers of its user actions
+ * and its scoring buffers at the end of the run; what a thread adds while processing events is the growth during
+ * the run, divided by the threads.
+ *
+ * The report (/run/memoryReport) is printed by the master at the start of the run and at its end.
+ */
+class MemoryReport final {
+public:
+    enum Mark { kGeometryBegin, kGeometryEnd, kProcessesEnd, kTablesEnd, kMarks };
+
+    struct Usage {
+        G4double heap{-1.0}; // bytes in use on the heap, < 0 if unknown
+        G4double resident{0.0}; // bytes
+    };
+
+    static void SetActive(const G4bool on) { active = on; }
+
+    [[nodiscard]] static G4bool IsActive() { return active; }
+
+    [[nodiscard]] static Usage Current();
+
+    /**
+     * Records the current usage at *mark* (master only, other threads are ignored)
+     */
+    static void Record(Mark mark);
+
+    /**
+     * Master, start of the run (physics tables built, workers started): prints the initialisation report
+     */
+    static void BeginOfRun();
+
+    /**
+     * Any thread processing events, end of the run before its tallies are merged
+     * @param userActionBytes containers of the thread's user actions
+     * @param scoringBytes scoring buffers of the thread
+     */
+    static void RecordThread(std::size_t userActionBytes, std::size_t scoringBytes);
+
+    /**
+     * Master, end of the run (after all threads): prints the per-thread report and the memory needed per thread
+     * @param sharedScoringBytes shared dose maps
+     */
+    static void EndOfRun(std::size_t sharedScoringBytes);
+
+private:
+    static G4bool active;
+};
+
+#endif
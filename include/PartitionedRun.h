@@ -0,0 +1,131 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef PartitionedRun_h
+#define PartitionedRun_h
+
+#include "globals.hh"
+#include <string>
+#include <vector>
+
+class PartitionMessenger;
+
+/**
+ * One logical run split over several processes (or nodes).
+ *
+ * Partition i of n draws the same two numbers from the macro-seeded master engine as every other partition and
+ * reseeds it with (those, i, n): MixMax gives distinct seed tuples streams that are guaranteed not to overlap, so
+ * the partitions are statistically independent although all macros call /random/setSeeds with the same seeds.
+ * With quasi-random sampling each partition uses its own set of replica shifts instead.
+ *
+ * At the end of every run a partition writes its raw accumulators (per-volume sums and sums of squares of the
+ * per-event deposits, replica sums, tomographic sector sums, events, CPU and wall time) and the settings the
+ * partitions must share to a binary partial-result file. Merge() adds any number of partials of the same settings
+ * exactly and writes the final dose report with the uncertainties of the combined run.
+ */
+class PartitionedRun final {
+public:
+    PartitionedRun();
+
+    ~PartitionedRun();
+
+    struct VolumeAccumulator {
+        std::string name;
+        G4double volume{0.0}; // mm3
+        G4double density{0.0}; // g/mm3
+        G4double sum{0.0}; // MeV
+        G4double sumSquares{0.0}; // MeV2, per-event deposits
+        std::vector<G4double> replicaSums; // MeV, quasi-random replicas
+        std::vector<G4double> sectorSums; // MeV, angular sectors of a tomographic scan
+    };
+
+    struct Partial {
+        std::string insect;
+        G4int index{0};
+        G4int count{1};
+        G4long events{0};
+        G4double sourcePhotonsPerEvent{1.0};
+        G4double photonFlux{0.0}; // photons/s/mm2
+        G4double beamArea{0.0}; // mm2
+        std::string preset;
+        std::string sampling;
+        G4int sectors{0}; // angular sectors of a tomographic scan (0: none)
+        G4double sectorStart{0.0}; // rad
+        G4double sectorRange{0.0}; // rad
+        G4double cpuTime{0.0}; // s
+        G4double wallTime{0.0}; // s
+        std::vector<VolumeAccumulator> volumes;
+    };
+
+    /**
+     * Makes this process partition *index* of *count* (count 1: not partitioned)
+     */
+    static void Select(G4int index, G4int count);
+
+    [[nodiscard]] static G4bool IsActive() { return count > 1; }
+
+    [[nodiscard]] static G4int GetIndex() { return index; }
+
+    [[nodiscard]] static G4int GetCount() { return count; }
+
+    // Partial files are written as <prefix><insect><suffix>.part<i>of<n> (default prefix: the output prefix)
+    static void SetPartialPrefix(const std::string &prefix) { partialPrefix = prefix; }
+
+    [[nodiscard]] static const std::string &GetPartialPrefix() { return partialPrefix; }
+
+    /**
+     * Derives the RNG stream of this partition (master, start of every run, before the worker seeds are drawn)
+     */
+    static void BeginOfRun();
+
+    /**
+     * Writes a partial-result file
+     * @return false (with an error message) if it cannot be written
+     */
+    static G4bool WritePartial(const std::string &filename, const Partial &partial);
+
+    static G4bool ReadPartial(const std::string &filename, Partial &partial);
+
+    /**
+     * Adds partial results and writes the dose report of the combined run
+     * @param files partial-result files of one logical run
+     * @param output report file
+     * @return 0 on success
+     */
+    static int Merge(const std::vector<std::string> &files, const std::string &output);
+
+    /**
+     * Local stand-in for a scheduler: runs the macro in *count* child processes at once (partition i of count
+     * each, threads shared out), then merges the partials of every run into <name>_merged.txt
+     * @param executable path of this program
+     * @param macro macro to run
+     * @param count number of partitions
+     * @return 0 on success
+     */
+    static int RunPartitions(const std::string &executable, const std::string &macro, G4int count);
+
+private:
+    static G4int index;
+    static G4int count;
+    static std::string partialPrefix;
+
+    PartitionMessenger *messenger{nullptr};
+};
+
+#endif
@@ -0,0 +1,118 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef PhaseSpaceFile_h
+#define PhaseSpaceFile_h
+
+#include "globals.hh"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Binary phase-space file: a fixed header followed by packed records of the particles that crossed the
+ * phase-space plane downward (along -z). Records of one source history are consecutive, the first one carries
+ * kHistoryStart.
+ *
+ * Files are read through a read-only memory map, so a file is loaded lazily by the OS, exists once in memory and
+ * is shared by all worker threads. Open() caches the mapping of the last file.
+ */
+class PhaseSpaceFile final {
+public:
+    struct Header {
+        char magic[8]; // "IDSPHSP1"
+        std::uint32_t version;
+        std::uint32_t recordSize;
+        std::uint64_t nRecords;
+        std::uint64_t nHistories; // source histories with at least one record
+        std::uint64_t sourceEvents; // events of the recording run (incl. histories without records)
+        double planeZ; // mm
+        double maxEnergy; // MeV
+    };
+
+    struct Record {
+        float x, y; // mm, at the plane
+        float u, v; // direction cosines, w = -sqrt(1 - u^2 - v^2)
+        float energy; // MeV
+        float weight;
+        std::int32_t pdg;
+        std::uint32_t flags;
+    };
+
+    static constexpr std::uint32_t kHistoryStart = 1;
+
+    ~PhaseSpaceFile();
+
+    PhaseSpaceFile(const PhaseSpaceFile &) = delete;
+
+    PhaseSpaceFile &operator=(const PhaseSpaceFile &) = delete;
+
+    /**
+     * Maps a phase-space file (thread-safe; the last file stays mapped and is returned again)
+     * @param filename path of the file
+     * @return the mapped file or nullptr (with an error message) if it cannot be read
+     */
+    static std::shared_ptr<const PhaseSpaceFile> Open(const std::string &filename);
+
+    /**
+     * Fills a header for a new file
+     * @param planeZ z of the phase-space plane
+     * @return header with zero counts
+     */
+    static Header MakeHeader(G4double planeZ);
+
+    /**
+     * Converts a text ray file of a beamline ray-tracing code into a phase-space file with one history per ray.
+     * Lines hold "x y dx dy dz energy [weight]" (mm, direction, eV); '#' starts a comment. The beam travels along
+     * +z of the ray file; it is turned by 180 degrees about x onto the -z beam of the simulation and started at
+     * beamStartZ. Weights are rescaled to a mean of 1, so doses stay per source ray.
+     * @param textFile ray file to read
+     * @param outputFile phase-space file to write
+     * @return false (with an error message) if nothing could be converted
+     */
+    static bool ConvertRayFile(const std::string &textFile, const std::string &outputFile);
+
+    [[nodiscard]] const Header &GetHeader() const { return *header; }
+
+    [[nodiscard]] const Record *GetRecords() const { return records; }
+
+    [[nodiscard]] const std::string &GetFilename() const { return filename; }
+
+    /**
+     * First record of every history, built on first use (thread-safe) and shared by all threads
+     * @return record indices; empty if every record starts a history (e.g. converted ray files), so that history i
+     *         is record i
+     */
+    [[nodiscard]] const std::vector<std::uint64_t> &GetHistoryStarts() const;
+
+private:
+    PhaseSpaceFile() = default;
+
+    std::string filename;
+    void *mapping{nullptr};
+    std::size_t mappingSize{0};
+    const Header *header{nullptr};
+    const Record *records{nullptr};
+    mutable std::vector<std::uint64_t> historyStarts;
+    mutable std::atomic<bool> historyStartsBuilt{false};
+};
+
+#endif
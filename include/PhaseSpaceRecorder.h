@@ -0,0 +1,92 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef PhaseSpaceRecorder_h
+#define PhaseSpaceRecorder_h
+
+#include "globals.hh"
+#include <string>
+
+class G4Step;
+class PhaseSpaceMessenger;
+
+/**
+ * Records the particles crossing a plane just upstream of the tube into a phase-space file (see PhaseSpaceFile).
+ *
+ * Transport from the source through the air down to the sample is the same for every insect. A recording run
+ * stores every particle that crosses the plane downward and stops it there; later runs replay the file with
+ * /generator/setPhaseSpaceFile, so the upstream part is simulated once per beam configuration. The dose output
+ * of a recording run itself is not meaningful (only secondaries of the last step reach the sample).
+ *
+ * The file is opened on the master at the start of the run; workers buffer whole histories thread-locally and
+ * append them under a lock, the master completes the header at the end of the run.
+ */
+class PhaseSpaceRecorder final {
+public:
+    PhaseSpaceRecorder();
+
+    ~PhaseSpaceRecorder();
+
+    /**
+     * Sets the file of the next runs (empty: stop recording)
+     * @param filename phase-space file, overwritten at the start of each run
+     */
+    static void SetOutputFile(const std::string &filename) { outputFile = filename; }
+
+    /**
+     * Sets the z position of the plane. By default it is placed 10 um above the highest mesh.
+     * @param z plane position
+     */
+    static void SetPlaneZ(G4double z) { planeZ = z; autoPlane = false; }
+
+    [[nodiscard]] static G4bool IsRecording() { return recording; }
+
+    /**
+     * Opens the file and places the plane (master, start of the run)
+     */
+    static void BeginOfRun();
+
+    /**
+     * Records and stops a particle crossing the plane downward
+     * @param step
+     */
+    static void ProcessStep(const G4Step *step);
+
+    /**
+     * Closes the history of the finished event and appends the buffer to the file once it is large
+     */
+    static void EndOfEvent();
+
+    /**
+     * Appends the remaining records of the calling thread; on the master also writes the header and closes the file
+     * @param master true on the master thread
+     * @param nEvents number of events of the run (master)
+     */
+    static void EndOfRun(G4bool master, G4int nEvents);
+
+private:
+    static std::string outputFile;
+    static G4double planeZ;
+    static G4bool autoPlane;
+    static G4bool recording;
+
+    PhaseSpaceMessenger *messenger{nullptr};
+};
+
+#endif
@@ -21,14 +21,114 @@
 #define PhysicsList_h
 
 #include "G4VModularPhysicsList.hh"
+#include "G4VStateDependent.hh"
+#include <CLHEP/Units/SystemOfUnits.h>
+#include <string>
 
-class PhysicsList final : public G4VModularPhysicsList {
+class PhysicsMessenger; // forward
+
+class PhysicsList final : public G4VModularPhysicsList, public G4VStateDependent {
 public:
     PhysicsList();
 
     ~PhysicsList() override;
 
     void SetCuts() override;
+
+    /**
+     * Builds (or retrieves) the physics tables; on the master this happens before the workers are started, so the
+     * memory report can tell the tables from the workers
+     */
+    void BuildPhysicsTable() override;
+
+    /**
+     * Re-selects the table cache entry when a run starts (Idle -> Init, before the tables are built), so cuts
+     * changed after /run/initialize (/run/setCut..., /run/setCutForRegion) select their own entry
+     * @param requestedState state being entered
+     * @return true
+     */
+    G4bool Notify(G4ApplicationState requestedState) override;
+
+    /**
+     * Selects the electromagnetic physics (PreInit only):
+     *  - penelope: G4EmPenelopePhysics, reference
+     *  - livermore: G4EmLivermorePhysics
+     *  - option4: G4EmStandardPhysics_option4
+     *  - fast: FastEmPhysics (photons and electrons only) with a looser step function and no Auger electrons
+     * @param name preset name
+     * @return false for an unknown preset
+     */
+    G4bool SelectPreset(const std::string &name);
+
+    [[nodiscard]] const std::string &GetPreset() const { return preset; }
+
+    // Override the fluorescence/Auger setting of the preset
+    void SetFluorescence(G4bool enable);
+
+    void SetAuger(G4bool enable);
+
+    /**
+     * Woodcock (delta) tracking of photons in the specimen region (PreInit only, Geant4 11.1 or later): photons
+     * cross the small insect, ethanol and tube volumes without stopping at their boundaries, sampling
+     * interactions against the largest cross section of the region. Enables the general gamma process.
+     * @param enable true to track photons with the Woodcock method inside DetectorConstruction::kSpecimenRegion
+     */
+    void SetWoodcock(G4bool enable);
+
+    [[nodiscard]] G4bool IsWoodcock() const { return woodcock; }
+
+    /**
+     * Tailors the table energy range to the source: tables are built up to a decade-rounded multiple of the
+     * highest photon energy instead of 1 GeV. Called by the master generator whenever its spectrum changes.
+     * @param energy highest energy of the source spectrum
+     */
+    void SetBeamMaxEnergy(G4double energy);
+
+    /**
+     * Keeps the table energy range at least at the range for *energy* until released (0), so a series of runs
+     * with different sources (e.g. a parameter sweep) builds the tables once
+     * @param energy highest energy of all sources to come, 0 to release
+     */
+    void HoldBeamMaxEnergy(G4double energy);
+
+    // Persistent physics table cache
+    void SetTableCacheEnabled(G4bool enable);
+
+    void SetTableCacheDirectory(const std::string &directory);
+
+    /**
+     * Stores the physics tables of the current configuration in the cache if they were built (not retrieved).
+     * Must be called on the master after the tables exist, i.e. from the master BeginOfRunAction.
+     */
+    void StoreTablesIfNeeded();
+
+    [[nodiscard]] static PhysicsList *GetInstance() { return instance; }
+
+private:
+    // Selects retrieval or storage for the cache entry matching materials, cuts, energy range and models
+    void UpdateTableCache();
+
+    [[nodiscard]] std::string TableCacheKey() const;
+
+    // Step functions, energy range and de-excitation switches; physics constructors reset these to their defaults
+    void ApplyEmParameters() const;
+
+    std::string preset{"penelope"};
+    G4int fluorescence{-1}; // -1: preset default, 0: off, 1: on
+    G4int auger{-1};
+    G4bool woodcock{false};
+
+    G4bool tableCacheEnabled{true};
+    std::string tableCacheDirectory{"physics_cache"};
+    std::string pendingStoreDirectory; // cache entry to write after the tables are built
+
+    G4bool cutsSet{false}; // SetCuts has run, the regions and their cuts exist
+    G4double tableMaxEnergy{1 * CLHEP::GeV};
+    G4double heldMaxEnergy{0.0};
+
+    PhysicsMessenger *messenger{nullptr};
+
+    static PhysicsList *instance;
 };
 
 #endif
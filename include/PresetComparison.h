@@ -0,0 +1,73 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef PresetComparison_h
+#define PresetComparison_h
+
+#include <string>
+#include <vector>
+
+/**
+ * Runs the same macro once per physics preset (each in its own process, since the physics list cannot change
+ * after initialization) and reports events per second and, per volume, the dose per event with its relative error
+ * and its difference to the first preset, also in units of the combined standard error.
+ *
+ * @param executable path of this program, used to start the child runs
+ * @param macro macro to run (use a reduced /run/beamOn)
+ * @param presets presets to compare, the first is the reference
+ * @return 0 on success
+ */
+int RunPresetComparison(const std::string &executable, const std::string &macro,
+                        const std::vector<std::string> &presets);
+
+/**
+ * Runs the same macro once per source sampling mode (/generator/setSampling) and reports the relative error and
+ * the figure of merit 1 / (relative error^2 * wall time) of every volume, relative to the first mode.
+ *
+ * @param executable path of this program, used to start the child runs
+ * @param macro macro to run (use a reduced /run/beamOn)
+ * @param modes sampling modes to compare, the first is the reference
+ * @return 0 on success
+ */
+int RunSamplingComparison(const std::string &executable, const std::string &macro,
+                          const std::vector<std::string> &modes);
+
+/**
+ * Runs the same macro with standard photon navigation and with Woodcock tracking in the specimen region
+ * (/physics/setWoodcock) and reports the speedup and, per volume, the dose difference in units of its combined
+ * standard error. Both runs must agree within the statistics for the Woodcock result to be trusted.
+ *
+ * @param executable path of this program, used to start the child runs
+ * @param macro macro to run (use a reduced /run/beamOn)
+ * @return 0 on success, 1 if a run failed or a dose differs by more than three standard errors
+ */
+int RunWoodcockComparison(const std::string &executable, const std::string &macro);
+
+/**
+ * Runs the same macro without and with importance sampling of photons toward the insect (--importance) and
+ * reports the relative error and the figure of merit of every volume, relative to the analog run. A pilot
+ * (/importance/pilot) in the macro is run by the biased child only.
+ *
+ * @param executable path of this program, used to start the child runs
+ * @param macro macro to run (use a reduced /run/beamOn)
+ * @return 0 on success
+ */
+int RunImportanceComparison(const std::string &executable, const std::string &macro);
+
+#endif
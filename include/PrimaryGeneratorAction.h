@@ -22,12 +22,19 @@
 
 #include "G4VUserPrimaryGeneratorAction.hh"
 #include "G4ParticleGun.hh"
+#include "SobolSequence.h"
+#include "TomographyScan.h"
+#include <algorithm>
+#include <cstdint>
+#include <memory>
 #include <vector>
 #include <string>
 #include <CLHEP/Units/SystemOfUnits.h>
 
 class G4Event;
 class PrimaryGeneratorMessenger; // forward
+class PhaseSpaceFile;
+class Spectrum;
 
 class PrimaryGeneratorAction final : public G4VUserPrimaryGeneratorAction {
 public:
@@ -56,27 +63,152 @@ public:
 
     [[nodiscard]] G4double GetMonoEnergy() const { return monoEnergy; }
 
+    /**
+     * Number of independent source photons (phase-space replay: recorded histories) per event. Larger values
+     * spread the fixed per-event cost over more photons; each event then is a batch of photons for the error
+     * estimate, which is still based on per-event tallies.
+     * @param n photons per event (>= 1)
+     */
+    void SetPhotonsPerEvent(G4int n);
+
+    [[nodiscard]] G4int GetPhotonsPerEvent() const { return photonsPerEvent; }
+
+    // Number of primaries sampled per block (1 = sample each event on its own)
+    void SetBatchSize(std::size_t n);
+
+    /**
+     * Selects how beam position and energy are sampled: "pseudo" (independent random numbers) or "sobol"
+     * (randomised quasi-random points indexed by the event ID, see SobolSequence)
+     * @param mode sampling mode
+     * @return false for an unknown mode
+     */
+    bool SetSampling(const std::string &mode);
+
+    [[nodiscard]] std::string GetSampling() const { return quasiRandom ? "sobol" : "pseudo"; }
+
+    // Number of independently shifted replicas of the quasi-random sequence (for the error estimate)
+    void SetQuasiRandomReplicas(G4int n);
+
+    void SetQuasiRandomSeed(const std::uint64_t seed) { quasiRandomSeed = seed; sobolRun = -1; }
+
+    /**
+     * Tomographic scan of the specimen: the beam is rotated about the scan axis by an angle sampled per event
+     * from the schedule (beam source only, not for phase-space replays). Call UpdateTomography() after changing it.
+     * @return scan settings
+     */
+    [[nodiscard]] TomographyScan &GetTomography() { return tomography; }
+
+    [[nodiscard]] const TomographyScan &GetTomography() const { return tomography; }
+
+    // Applies changed scan settings (scoring of the angular sectors is configured by the master)
+    void UpdateTomography();
+
+    // Angular sector of the scan the current event of this thread belongs to (0 without a scan)
+    [[nodiscard]] static G4int GetEventSector() { return eventSector; }
+
+    // Normalized source spectrum (mono mode: a single bin at the mono energy)
+    [[nodiscard]] const std::vector<G4double> &GetSpectrumEnergies() const;
+
+    [[nodiscard]] const std::vector<G4double> &GetSpectrumProbabilities() const;
+
+    /**
+     * Replays a phase-space file (see PhaseSpaceRecorder, or a beamline ray file converted with
+     * PhaseSpaceFile::ConvertRayFile) instead of the beam: each event is one recorded source history, started at the
+     * phase-space plane. Every worker replays its own contiguous slice of the mapped file without copying it.
+     * @param filename phase-space file (empty: back to the beam)
+     */
+    void SetPhaseSpaceFile(const std::string &filename);
+
+    /**
+     * Position jitter for reused phase-space histories: once a worker has replayed its slice, every further pass
+     * shifts each history by a uniform offset in [-jitter/2, jitter/2] in x and y
+     * @param jitter full width of the offset (0: replay unchanged)
+     */
+    void SetPhaseSpaceJitter(const G4double jitter) { phaseSpaceJitter = std::max(0.0, jitter); }
+
+    /**
+     * Source photons represented by one event: photons per event for the beam, times recorded source photons per
+     * recorded history for a phase-space replay (histories without particles at the plane were not stored)
+     * @return source photons per event of the master generator
+     */
+    [[nodiscard]] static G4double GetSourcePhotonsPerEvent();
+
+    // Bytes held by this (thread's) generator: the object, its gun and its buffers; the spectrum is shared
+    [[nodiscard]] std::size_t GetThreadFootprint() const;
+
+    /**
+     * The generator living on the master thread. In MT mode it is created by ActionInitialization::BuildForMaster
+     * and never generates events, but receives the same /generator/ commands as the workers, so master-side tools
+     * (e.g. the ray-cast dose engine) see the current source configuration.
+     * @return master generator or nullptr if none was created yet
+     */
+    [[nodiscard]] static const PrimaryGeneratorAction *GetMasterInstance() { return masterInstance; }
+
 private:
     G4ParticleGun *fParticleGun;
 
-    // For polychromatic spectrum sampling
-    G4double SampleEnergyFromSpectrum();
+    // Pre-generates the positions and energies of the next batchSize primaries
+    void RefillBatch();
 
+    // Master: loads and publishes the spectrum of the current settings; workers: take the published one
     void InitializeSpectrum();
 
-    std::vector<G4double> spectrumEnergies; // Energy bins
-    std::vector<G4double> spectrumIntensities; // Relative intensities
-    std::vector<G4double> cumulativeDistribution; // For inverse transform sampling
-    G4double maxIntensity;
+    // Switches to the currently published spectrum
+    void RefreshSpectrum();
+
+    // Adds the particles of the next recorded history of this thread's slice (or of *history*, if >= 0) to the event
+    void GeneratePhaseSpacePrimaries(G4Event *event, std::int64_t history = -1);
+
+    // Centre of the meshes as point on the scan axis unless one was set (once per run)
+    void ResolveTomographyAxis();
+
+    // Limits the physics table energy range to the highest source energy (master only)
+    void UpdatePhysicsEnergyRange() const;
+
+    std::shared_ptr<const Spectrum> spectrum; // shared, immutable
+    std::uint64_t spectrumGeneration{0}; // Spectrum::GetGeneration() when *spectrum* was taken
 
     // Configurable parameters (settable from macros)
     std::string spectrumFilename; // if empty -> auto-detect
     static G4double photonFlux; // default photons/s/mm2
     bool monochromatic{false};
     G4double monoEnergy{15.2 * CLHEP::keV};
+    G4int photonsPerEvent{1};
+
+    // Primaries are sampled in blocks per thread: one engine call and branch-free loops instead of three
+    // G4UniformRand() calls and a table search per event
+    std::size_t batchSize{1024};
+    std::size_t batchNext{0};
+    std::vector<G4double> batchUniforms;
+    std::vector<G4double> batchX, batchY, batchEnergy;
+
+    // Quasi-random sampling: event i uses point i / replicas of the sequence shifted for replica i % replicas
+    bool quasiRandom{false};
+    G4int quasiRandomReplicas{16};
+    std::uint64_t quasiRandomSeed{20250};
+    SobolSequence sobol;
+    std::vector<SobolSequence::Shift> sobolShifts;
+    G4int sobolRun{-1}; // run the shifts were made for
+
+    // Tomographic scan: axis point used in the current run
+    TomographyScan tomography;
+    G4ThreeVector tomographyAxisPoint;
+    G4int tomographyRun{-1};
+    static thread_local G4int eventSector;
+
+    // Phase-space replay (shared, memory-mapped) and the slice [begin, end) of records of this thread
+    std::shared_ptr<const PhaseSpaceFile> phaseSpace;
+    std::uint64_t phaseSpaceBegin{0};
+    std::uint64_t phaseSpaceEnd{0};
+    std::uint64_t phaseSpaceCursor{0};
+    std::uint64_t phaseSpacePass{0}; // completed passes over the slice
+    G4double phaseSpaceJitter{0.0};
+    bool phaseSpaceSliced{false};
 
     // Messenger to receive macro commands
     PrimaryGeneratorMessenger *messenger{nullptr};
+
+    static PrimaryGeneratorAction *masterInstance;
 };
 
 #endif
@@ -27,6 +27,10 @@ class G4UIcmdWithAString;
 class G4UIcmdWithADoubleAndUnit;
 class G4UIcmdWithABool;
 class G4UIcmdWithADouble;
+class G4UIcmdWithAnInteger;
+class G4UIcmdWith3Vector;
+class G4UIcmdWith3VectorAndUnit;
+class G4UIcmdWithoutParameter;
 class PrimaryGeneratorAction;
 
 class PrimaryGeneratorMessenger final : public G4UImessenger {
@@ -44,6 +48,20 @@ private:
     G4UIcmdWithADouble *photonFluxCmd{nullptr};
     G4UIcmdWithABool *monoCmd{nullptr};
     G4UIcmdWithADoubleAndUnit *monoEnergyCmd{nullptr};
+    G4UIcmdWithAString *phaseSpaceFileCmd{nullptr};
+    G4UIcmdWithADoubleAndUnit *phaseSpaceJitterCmd{nullptr};
+    G4UIcmdWithAnInteger *batchSizeCmd{nullptr};
+    G4UIcmdWithAnInteger *photonsPerEventCmd{nullptr};
+    G4UIcmdWithAString *samplingCmd{nullptr};
+    G4UIcmdWithAnInteger *replicasCmd{nullptr};
+    G4UIcmdWithAnInteger *quasiRandomSeedCmd{nullptr};
+    G4UIdirectory *tomographyDir{nullptr};
+    G4UIcommand *scanCmd{nullptr};
+    G4UIcmdWithAString *scheduleFileCmd{nullptr};
+    G4UIcmdWith3Vector *axisCmd{nullptr};
+    G4UIcmdWith3VectorAndUnit *axisPointCmd{nullptr};
+    G4UIcmdWithAnInteger *sectorsCmd{nullptr};
+    G4UIcmdWithoutParameter *tomographyOffCmd{nullptr};
 };
 
 #endif
@@ -0,0 +1,47 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef RayCastMessenger_h
+#define RayCastMessenger_h
+
+#include "G4UImessenger.hh"
+#include "G4String.hh"
+
+class G4UIcmdWithoutParameter;
+class G4UIcmdWithAnInteger;
+class RayCastDoseEngine;
+
+class RayCastMessenger final : public G4UImessenger {
+public:
+    explicit RayCastMessenger(RayCastDoseEngine *engine);
+
+    ~RayCastMessenger() override;
+
+    void SetNewValue(G4UIcommand *command, G4String newValue) override;
+
+private:
+    RayCastDoseEngine *engine{nullptr};
+    G4UIdirectory *rayCastDir{nullptr};
+    G4UIcmdWithoutParameter *runCmd{nullptr};
+    G4UIcmdWithAnInteger *raysPerAxisCmd{nullptr};
+    G4UIcmdWithAnInteger *threadsCmd{nullptr};
+    G4UIcmdWithAnInteger *energyGroupsCmd{nullptr};
+};
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef ResponseMatrix_h
+#define ResponseMatrix_h
+
+#include "globals.hh"
+#include <string>
+#include <vector>
+
+class ResponseMessenger;
+
+/**
+ * Energy-response matrix: the dose per photon of every volume on a grid of monochromatic energies.
+ *
+ * Dose is linear in the source spectrum, so once the matrix of an insect is known the dose of any spectrum follows
+ * from folding: D = sum_k p_k R(E_k) with R interpolated linearly between the grid energies. The grid runs are
+ * independent, so the uncertainty of the folded dose is sqrt(sum_i c_i^2 sigma_i^2), c_i being the total weight
+ * of grid energy i. Building runs one monochromatic run per grid energy through the /generator/ commands; folding
+ * takes milliseconds and needs no Geant4 initialisation (see --fold).
+ */
+class ResponseMatrix final {
+public:
+    struct Table {
+        std::string insect;
+        G4int eventsPerEnergy{0};
+        std::vector<G4double> energies; // ascending
+        std::vector<std::string> volumes;
+        std::vector<std::vector<G4double> > dose; // [volume][energy], Gy per photon
+        std::vector<std::vector<G4double> > error; // [volume][energy], absolute standard error
+    };
+
+    struct Folded {
+        std::string volume;
+        G4double dosePerPhoton{0.0}; // Gy
+        G4double doseRate{0.0}; // Gy/s
+        G4double relError{0.0};
+    };
+
+    ResponseMatrix();
+
+    ~ResponseMatrix();
+
+    /**
+     * Sets the grid: *n* energies evenly spaced from *min* to *max* (max 0: the range of the current spectrum file)
+     */
+    void SetEnergies(G4double min, G4double max, G4int n);
+
+    void SetEvents(const G4int n) { events = n; }
+
+    /**
+     * Runs the grid for the current insect and writes the matrix (master, Idle state)
+     * @param filename response file (empty: response_<insect>.bin)
+     */
+    void Build(const std::string &filename);
+
+    static G4bool Write(const std::string &filename, const Table &table);
+
+    static G4bool Read(const std::string &filename, Table &table);
+
+    /**
+     * Folds a spectrum with the matrix
+     * @param energies spectrum energies
+     * @param probabilities normalised spectrum probabilities
+     * @param photonsPerSecond photons per second on the beam area, for the dose rate
+     * @param outside set to the spectrum probability outside the grid (those energies take the nearest grid value)
+     */
+    static std::vector<Folded> Fold(const Table &table, const std::vector<G4double> &energies,
+                                    const std::vector<G4double> &probabilities, G4double photonsPerSecond,
+                                    G4double &outside);
+
+    /**
+     * Folds a spectrum file with a response file and prints the doses
+     * @param photonFlux photons/s/mm2
+     * @param outputFile results table (empty: console only)
+     * @return 0 on success
+     */
+    static G4int FoldFiles(const std::string &responseFile, const std::string &spectrumFile, G4double photonFlux,
+                           const std::string &outputFile);
+
+private:
+    G4double minEnergy{0.0};
+    G4double maxEnergy{0.0};
+    G4int nEnergies{50};
+    G4int events{100000};
+
+    ResponseMessenger *messenger{nullptr};
+};
+
+#endif
@@ -22,7 +22,11 @@
 
 #include "G4UserRunAction.hh"
 #include "globals.hh"
+#include <chrono>
+#include <ctime>
+#include <map>
 #include <string>
+#include <vector>
 
 class RunMessenger; // forward
 
@@ -41,12 +45,91 @@ public:
 
     [[nodiscard]] const std::string &GetOutputFilePrefix() const;
 
+    // Appended to the output filename (before '.txt'), e.g. to tell runs with different physics presets apart
+    void SetOutputFileSuffix(const std::string &suffix) { outputSuffix = suffix; }
+
+    [[nodiscard]] const std::string &GetOutputFileSuffix() const { return outputSuffix; }
+
+    // If set, a one-line JSON summary of each run is appended to this file
+    void SetJsonSummaryFile(const std::string &filename) { jsonSummaryFile = filename; }
+
+    /**
+     * Reproducible mode: every event is seeded from the run and its event ID and the doses are summed in fixed
+     * point, so the results do not depend on the number of threads or the order the events finish in
+     * @param on true to enable
+     */
+    static void SetReproducible(const G4bool on) { reproducible = on; }
+
+    [[nodiscard]] static G4bool IsReproducible() { return reproducible; }
+
+    /**
+     * Reseeds the engine of the calling thread for an event (reproducible mode, before its primaries are made)
+     * @param eventID event ID within the current run
+     */
+    static void SeedEvent(G4int eventID);
+
+    // Density (g/mm3) used for the dose of a scoring volume
+    static G4double VolumeDensity(const std::string &volName);
+
+    /**
+     * Relative standard error of a mean dose
+     * @param sum sum of the per-event deposits
+     * @param sumSquares sum of the squared per-event deposits
+     * @param nEvents number of events
+     * @param replicaMeans mean deposit per event of each replica; with two or more (quasi-random events, which are
+     *                     not independent) the error comes from their spread instead of the per-event deposits
+     * @return relative error (0 without deposits)
+     */
+    static G4double RelativeError(G4double sum, G4double sumSquares, G4long nEvents,
+                                  const std::vector<G4double> &replicaMeans = {});
+
+    /**
+     * Mean deposit per event of each replica (event i belongs to replica i % replicas)
+     * @param replicaSums deposit summed per replica
+     * @param nEvents number of events of the run
+     * @return mean per replica
+     */
+    static std::vector<G4double> ReplicaMeans(const std::vector<G4double> &replicaSums, G4long nEvents);
+
+    struct VolumeResult {
+        G4double dosePerEvent; // Gy per source photon
+        G4double doseRate; // Gy/s at the configured flux
+        G4double relError;
+    };
+
+    struct Summary {
+        G4String insect;
+        G4long events{0};
+        G4double wallTime{0.0}; // s
+        std::map<std::string, VolumeResult> volumes;
+    };
+
+    /**
+     * Getter for the results of the last run written by the master (e.g. for a sweep over several runs)
+     * @return last summary (no volumes before the first run)
+     */
+    static const Summary &GetLastSummary() { return lastSummary; }
+
+    // Forgets the last summary, so a run that ends without one (failed, or no events) is not taken for it
+    static void ClearLastSummary() { lastSummary = Summary{}; }
+
 private:
     // configurable output prefix (default 'dose_results_')
     std::string outputPrefix{"dose_results_"};
+    std::string outputSuffix;
+    std::string jsonSummaryFile;
+
+    // wall clock start of the current run (master)
+    std::chrono::steady_clock::time_point runStart;
+    std::clock_t cpuStart{0}; // process CPU time (all threads)
 
     // messenger to receive macro commands
     RunMessenger *messenger{nullptr};
+
+    static Summary lastSummary;
+
+    static G4bool reproducible;
+    static long eventSeedKey[2]; // drawn by the master at the start of every reproducible run
 };
 
 #endif
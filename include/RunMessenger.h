@@ -24,6 +24,8 @@
 #include "G4String.hh"
 
 class G4UIcmdWithAString;
+class G4UIcmdWithAnInteger;
+class G4UIcmdWithABool;
 class RunAction;
 
 class RunMessenger final : public G4UImessenger {
@@ -38,6 +40,11 @@ private:
     RunAction *runAction{nullptr};
     G4UIdirectory *runDir{nullptr};
     G4UIcmdWithAString *outputPrefixCmd{nullptr};
+    G4UIcmdWithAString *outputSuffixCmd{nullptr};
+    G4UIcmdWithAString *jsonSummaryCmd{nullptr};
+    G4UIcmdWithAnInteger *keepEveryCmd{nullptr};
+    G4UIcmdWithABool *reproducibleCmd{nullptr};
+    G4UIcmdWithABool *memoryReportCmd{nullptr};
 };
 
 #endif
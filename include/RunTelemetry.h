@@ -0,0 +1,83 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef RunTelemetry_h
+#define RunTelemetry_h
+
+#include "globals.hh"
+#include <string>
+
+class TelemetryMessenger;
+
+/**
+ * Live progress of a run: a monitor thread on the master periodically writes a snapshot with the events completed,
+ * the event rate of every thread, the ETA, the running dose per source photon and relative error of every volume
+ * and the resident memory of the process.
+ *
+ * Workers only touch counters of their own: the event count is a relaxed atomic the monitor reads, and the tallies
+ * are copied into the thread's slot at the end of an event when the monitor asks for a new sample (one relaxed
+ * load per event otherwise). The snapshot goes to a JSON file (replaced atomically) or a CSV file (one row per
+ * sample) and, optionally, is served over HTTP on a Unix domain socket.
+ */
+class RunTelemetry final {
+public:
+    RunTelemetry();
+
+    ~RunTelemetry();
+
+    // Snapshot file: JSON unless the name ends in ".csv" (empty: off)
+    static void SetFile(const std::string &filename) { file = filename; }
+
+    // Unix domain socket the latest snapshot is served on (empty: none)
+    static void SetSocket(const std::string &path) { socketPath = path; }
+
+    // Seconds between samples
+    static void SetInterval(G4double seconds);
+
+    [[nodiscard]] static G4bool IsEnabled() { return !file.empty() || !socketPath.empty(); }
+
+    /**
+     * Master: starts the monitor thread (before the workers start); workers: nothing
+     * @param eventsToProcess events of the run
+     */
+    static void BeginOfRun(G4bool master, G4long eventsToProcess);
+
+    /**
+     * End of an event on the thread processing it
+     */
+    static void EndOfEvent();
+
+    /**
+     * Workers: publish their final tallies; master (after the workers): stops the monitor and writes the last
+     * snapshot
+     */
+    static void EndOfRun(G4bool master);
+
+    // Resident memory of the process in bytes (0 if unknown)
+    static G4long ResidentMemory();
+
+private:
+    static std::string file;
+    static std::string socketPath;
+    static G4double interval; // s
+
+    TelemetryMessenger *messenger{nullptr};
+};
+
+#endif
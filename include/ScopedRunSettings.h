@@ -0,0 +1,59 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef ScopedRunSettings_h
+#define ScopedRunSettings_h
+
+#include "globals.hh"
+#include <string>
+
+/**
+ * Run settings of a command that starts runs of its own (sweep, response matrix, daemon job, importance pilot),
+ * restored when it goes out of scope, also on early returns: the output file suffix, the visualisation (disabled
+ * while the runs go on) and the energy range of the physics tables (held at the largest energy of all runs, so
+ * the tables are built once).
+ */
+class ScopedRunSettings final {
+public:
+    /**
+     * @param maxEnergy largest beam energy of the runs to build the physics tables for (0: not held)
+     */
+    explicit ScopedRunSettings(G4double maxEnergy = 0.0);
+
+    ~ScopedRunSettings();
+
+    ScopedRunSettings(const ScopedRunSettings &) = delete;
+
+    ScopedRunSettings &operator=(const ScopedRunSettings &) = delete;
+
+    /**
+     * Runs *events* events with *label* appended to the configured output file suffix
+     * @return false (with an error message) if /run/beamOn failed or the run left no summary
+     */
+    G4bool BeamOn(G4long events, const std::string &label) const;
+
+    [[nodiscard]] const std::string &GetSuffix() const { return suffix; }
+
+private:
+    std::string suffix;
+    G4bool visEnabled{false};
+    G4bool energyHeld{false};
+};
+
+#endif
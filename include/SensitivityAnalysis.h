@@ -0,0 +1,151 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef SensitivityAnalysis_h
+#define SensitivityAnalysis_h
+
+#include "globals.hh"
+#include <map>
+#include <string>
+#include <vector>
+
+class G4Step;
+class G4Material;
+class SensitivityMessenger;
+
+/**
+ * Correlated-sampling sensitivity of the dose to the insect material.
+ *
+ * Every photon history is transported once in the nominal insect material. For each perturbed material (a density
+ * scale or a changed elemental mass fraction) a weight is carried along that is the likelihood ratio of the
+ * sampled history in the perturbed and the nominal material: for every photon step of length s in the insect,
+ * w *= exp(-(mu' - mu) s), and for an interaction of type i, w *= mu_i' / mu_i. Secondaries inherit the weight of
+ * their parent at creation, deposits are scored with it. One run then gives the dose of all variants together,
+ * and since the variants share the histories of the nominal run, their differences have a much smaller variance
+ * than those of independent runs.
+ *
+ * Only photon interactions are reweighted: the electron transport in the perturbed material (stopping power and
+ * range) is taken from the nominal one. For the sub-mm electron ranges of a keV beam this is a small effect next
+ * to the change in photon attenuation.
+ *
+ * Variants are configured on the master (/sensitivity/ commands), the attenuation tables are built there at the
+ * start of each run; workers read both and keep their tallies thread-local until the end of the run.
+ */
+class SensitivityAnalysis final {
+public:
+    SensitivityAnalysis();
+
+    ~SensitivityAnalysis();
+
+    /**
+     * Adds a variant with the density of the insect material scaled by *scale*
+     * @param scale density factor (e.g. 1.05)
+     */
+    static void AddDensityScale(G4double scale);
+
+    /**
+     * Adds a variant with the mass fraction of an element changed by *delta*; the other fractions are rescaled so
+     * the sum stays 1. The element does not need to be part of the nominal material.
+     * @param element element symbol (e.g. "O")
+     * @param delta absolute change of the mass fraction (e.g. 0.02)
+     * @return false if the element is unknown or the resulting fraction is outside [0, 1]
+     */
+    static G4bool AddMassFractionChange(const G4String &element, G4double delta);
+
+    /**
+     * Removes all variants
+     */
+    static void Clear();
+
+    /**
+     * Builds the attenuation tables of all variants for the current insect material and source (master, start of
+     * the run). Disables the analysis for the run if there are no variants.
+     */
+    static void BeginOfRun();
+
+    [[nodiscard]] static G4bool IsActive() { return active; }
+
+    /**
+     * Updates the weights of the current track and its secondaries and scores the weighted deposit
+     * @param step
+     */
+    static void ProcessStep(const G4Step *step);
+
+    /**
+     * Adds the weighted deposits of the finished event to the tallies of the calling thread
+     */
+    static void EndOfEvent();
+
+    /**
+     * Adds the tallies of the calling thread to the shared tallies (thread-safe)
+     */
+    static void MergeThreadTallies();
+
+    /**
+     * Resets the tallies of the calling thread and, on the master, the shared tallies
+     * @param master true on the master thread
+     */
+    static void ClearTallies(G4bool master);
+
+    /**
+     * Writes the dose of every variant, its change against the nominal material and the uncertainty of that
+     * change (master, end of the run)
+     * @param fileName output file
+     * @param nEvents number of events of the run (the statistical unit of the uncertainties)
+     * @param sourcePhotons source photons of the run, the dose normalisation of the main dose table
+     */
+    static void WriteReport(const std::string &fileName, G4int nEvents, G4double sourcePhotons);
+
+private:
+    struct Variant {
+        std::string label;
+        G4double densityScale{1.0};
+        G4String element; // empty for density variants
+        G4double massFractionDelta{0.0};
+    };
+
+    // Sums over events of the weighted deposit x_v, x_v^2 and (x_v - x_0)^2 (MeV, MeV2); index 0 is nominal
+    struct Tally {
+        std::vector<G4double> sum;
+        std::vector<G4double> sum2;
+        std::vector<G4double> diff2;
+    };
+
+    // Index into the tabulated interactions for the process that limited the step, -1 for none
+    static G4int InteractionIndex(const G4Step *step);
+
+    // Linear interpolation in log(E) of the table of variant v (0 = nominal), interaction i (nInteractions = total)
+    static G4double Mu(std::size_t v, G4int i, G4double energy);
+
+    static std::vector<Variant> variants;
+    static G4bool active;
+    static const G4Material *insectMaterial;
+
+    // mu tables (1/mm): [(variant * (nInteractions + 1) + interaction) * nBins + bin], variant 0 nominal
+    static std::vector<G4double> muTable;
+    static G4double logEmin;
+    static G4double invDLogE;
+    static G4int nBins;
+
+    static std::map<std::string, Tally> tallies;
+
+    SensitivityMessenger *messenger{nullptr};
+};
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef SimulationDaemon_h
+#define SimulationDaemon_h
+
+#include "globals.hh"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Keeps an initialised simulation alive and runs jobs sent over a Unix domain socket or stdin.
+ *
+ * A job is one line: a JSON object such as
+ *   {"id": "a1", "insect": "leptopilina", "energy": 15, "events": 100000, "seed": 42}
+ * ("spectrum": file instead of "energy" in keV, optional "macro": [commands] applied before the run), or a
+ * single macro command starting with '/'. Every job is answered with JSON records, one per line: "queued",
+ * "started" and finally "done" with the dose per source photon, dose rate and relative error of every volume (or
+ * "error"/"rejected"). Settings persist from job to job. The id becomes part of the output file names and may only
+ * contain letters, digits, '_', '.' and '-'.
+ *
+ * Runs share one run manager, so the jobs of all clients run one after the other in the order they arrive, each
+ * with all worker threads (which stay alive between runs); at most *maxQueued* jobs wait, further jobs are
+ * rejected.
+ */
+class SimulationDaemon final {
+public:
+    explicit SimulationDaemon(G4int maxQueued = 16);
+
+    /**
+     * Serves jobs until a client sends {"command": "shutdown"} (or, on stdin, until end of input)
+     * @param socketPath path of the Unix domain socket, "-" for stdin/stdout
+     * @return 0 on a clean shutdown
+     */
+    int Serve(const std::string &socketPath);
+
+private:
+    // Where the records of a job go (a socket connection or stdout)
+    struct Client {
+        explicit Client(const int descriptor) : fd(descriptor) {}
+
+        ~Client();
+
+        int fd{-1};
+        std::mutex writeMutex;
+
+        void Send(const std::string &record);
+    };
+
+    struct Job {
+        std::string id;
+        std::map<std::string, std::string> fields;
+        std::vector<std::string> commands;
+        std::shared_ptr<Client> client;
+    };
+
+    void Submit(const std::string &line, const std::shared_ptr<Client> &client);
+
+    void Execute(const Job &job);
+
+    void ReadClient(const std::shared_ptr<Client> &client);
+
+    void Shutdown();
+
+    G4int maxQueued;
+    G4int jobCounter{0};
+    std::atomic<bool> stopping{false};
+    std::deque<Job> queue;
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+
+    int listenFd{-1};
+    // Connections are read by detached threads; on shutdown their sockets are closed and the threads awaited
+    G4int activeReaders{0};
+    std::condition_variable readersDone;
+    std::vector<std::weak_ptr<Client> > clients;
+};
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef SobolSequence_h
+#define SobolSequence_h
+
+#include "G4Types.hh"
+#include <array>
+#include <cstdint>
+
+/**
+ * Digitally shifted 4-dimensional Sobol sequence (direction numbers of Joe and Kuo).
+ *
+ * Points are computed directly from their index, so an event can take its point from its event ID, independent
+ * of the thread it runs on. XOR-ing every dimension with a random 32-bit shift randomises the sequence while
+ * keeping its low discrepancy; independent shifts give independent replicas for the error estimate.
+ */
+class SobolSequence final {
+public:
+    static constexpr int kDimensions = 4;
+
+    using Shift = std::array<std::uint32_t, kDimensions>;
+
+    SobolSequence();
+
+    /**
+     * Point *index* of the sequence, shifted by *shift*, in (0, 1)^4
+     */
+    void Point(std::uint32_t index, const Shift &shift, G4double *point) const;
+
+    /**
+     * Reproducible random shift for a (seed, run, replica) combination
+     */
+    static Shift MakeShift(std::uint64_t seed, G4int run, G4int replica);
+
+private:
+    std::array<std::array<std::uint32_t, 32>, kDimensions> directions{};
+};
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef Spectrum_h
+#define Spectrum_h
+
+#include "SpectrumSampler.h"
+#include "globals.hh"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Immutable source spectrum: normalised bins and their alias table.
+ *
+ * A spectrum is loaded once by the generator on the master and published; the generators of the worker threads
+ * share the published object instead of parsing the file themselves, so the tables exist once in memory and
+ * worker start-up does not depend on the size of the file. A new spectrum (macro command between runs) replaces
+ * the published one; workers pick it up before their next event, the old one is freed with its last user.
+ */
+class Spectrum final {
+public:
+    /**
+     * Single line at *energy*
+     */
+    static std::shared_ptr<const Spectrum> Monochromatic(G4double energy);
+
+    /**
+     * Reads a spectrum file (energy in eV, intensity per line); relative names are looked up in spectra/ first,
+     * an empty name takes the first spectrum file found there
+     * @throws std::runtime_error if no spectrum can be read
+     */
+    static std::shared_ptr<const Spectrum> FromFile(const std::string &filename);
+
+    /**
+     * Makes *spectrum* the shared current spectrum (thread-safe)
+     */
+    static void Publish(std::shared_ptr<const Spectrum> spectrum);
+
+    /**
+     * The shared current spectrum (thread-safe), nullptr before the first Publish()
+     */
+    static std::shared_ptr<const Spectrum> GetCurrent();
+
+    /**
+     * Counter increased by every Publish(); cheap to poll per event
+     */
+    static std::uint64_t GetGeneration() { return generation.load(std::memory_order_acquire); }
+
+    [[nodiscard]] const std::vector<G4double> &GetEnergies() const { return energies; }
+
+    [[nodiscard]] const std::vector<G4double> &GetProbabilities() const { return probabilities; }
+
+    [[nodiscard]] const SpectrumSampler &GetSampler() const { return sampler; }
+
+    // File the spectrum was read from, or "monochromatic"
+    [[nodiscard]] const std::string &GetDescription() const { return description; }
+
+private:
+    Spectrum() = default;
+
+    std::vector<G4double> energies; // ascending
+    std::vector<G4double> probabilities; // normalised
+    SpectrumSampler sampler;
+    std::string description;
+
+    static std::shared_ptr<const Spectrum> current;
+    static std::atomic<std::uint64_t> generation;
+};
+
+#endif
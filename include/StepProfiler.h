@@ -0,0 +1,98 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef StepProfiler_h
+#define StepProfiler_h
+
+#include "globals.hh"
+#include <string>
+
+class G4Step;
+class ProfilerMessenger;
+
+/**
+ * Counts steps, track length and tracking time per (particle, process, volume) to show where the CPU time goes.
+ *
+ * Every thread fills a flat table of its own, indexed through a small hash of the particle definition, the process
+ * that limited the step and the volume of the step (all pointers: no strings in the event loop). Steps and track
+ * length are exact. The time is sampled: every n-th step the clock is read, and the time until the next step ends is
+ * the cost of that step (navigation, physics, stacking and the user actions in between). The time of a row is its
+ * mean sampled cost times its steps. At the end of the run the tables are merged by name and ranked by time.
+ *
+ * Disabled (the default), the stepping action skips it with one test of a static flag.
+ */
+class StepProfiler final {
+public:
+    StepProfiler();
+
+    ~StepProfiler();
+
+    static void SetActive(const G4bool on) { active = on; }
+
+    [[nodiscard]] static G4bool IsActive() { return active; }
+
+    /**
+     * Sets the number of steps between two timed steps
+     * @param n sampling interval (1: time every other step)
+     */
+    static void SetSampleInterval(const G4int n) { sampleInterval = n; }
+
+    /**
+     * Sets the number of rows of the hot-spot table (0: all)
+     * @param n rows
+     */
+    static void SetTopRows(const G4int n) { topRows = n; }
+
+    /**
+     * Clears the merged table (master, start of the run)
+     * @param master true on the master thread
+     */
+    static void BeginOfRun(G4bool master);
+
+    /**
+     * Counts the step and, if it is a sampled one, its time
+     * @param step
+     */
+    static void ProcessStep(const G4Step *step);
+
+    /**
+     * Stops timing across the end of the event (event generation is not a step)
+     */
+    static void EndOfEvent();
+
+    /**
+     * Adds the table of the calling thread to the merged one and resets it (thread-safe)
+     */
+    static void MergeThreadTable();
+
+    /**
+     * Prints the ranked hot-spot table of the merged run and writes it to a file
+     * @param filename output file (empty: console only)
+     */
+    static void WriteReport(const std::string &filename);
+
+private:
+    static G4bool active;
+    static G4int sampleInterval;
+    static G4int topRows;
+
+    ProfilerMessenger *messenger{nullptr};
+};
+
+#endif
@@ -24,6 +24,7 @@
 #include "globals.hh"
 #include <map>
 #include <string>
+#include <vector>
 
 class SteppingAction final : public G4UserSteppingAction {
 public:
@@ -31,21 +32,109 @@ public:
 
     ~SteppingAction() override;
 
+    // Accumulated deposits of one volume (MeV), see EndOfEvent()
+    struct Tally {
+        G4double sum{0.0};
+        G4double sum2{0.0};
+        std::vector<G4double> replicaSum;
+        std::vector<G4double> sectorSum;
+
+        void Add(const Tally &other);
+    };
+
     /**
      * Stepping Action to accumulate energy deposition per volume
      *
-     * the *doseMap* holds the dose for each volume by name.
+     * Deposits are collected per event in thread-local storage; EndOfEvent() adds the event to the thread's
+     * tallies and MergeThreadTallies() adds those to the shared *doseMap* at the end of the run.
      *
      * @param step
      */
     void UserSteppingAction(const G4Step *step) override;
 
+    /**
+     * Adds the deposits of the finished event (and their squares) to the tallies of the calling thread
+     * @param replica replica of the event if replicas are tallied (quasi-random sampling), otherwise ignored
+     * @param sector angular sector of the event if sectors are tallied (tomographic scan), otherwise ignored
+     */
+    static void EndOfEvent(G4int replica = 0, G4int sector = 0);
+
+    /**
+     * Tallies the dose separately for *n* replicas (0: off). With quasi-random sampling events are not
+     * independent, so the uncertainty comes from the spread of independently randomised replicas instead.
+     * @param n number of replicas
+     */
+    static void SetReplicas(const G4int n) { replicas = n; }
+
+    [[nodiscard]] static G4int GetReplicas() { return replicas; }
+
+    /**
+     * Getter for the accumulated dose per replica (MeV), filled if replicas are tallied
+     * @return map of volume name to deposit per replica
+     */
+    static std::map<std::string, std::vector<G4double> > &getReplicaDoseMap();
+
+    /**
+     * Tallies the dose separately for *n* angular sectors of a tomographic scan (0: off)
+     * @param n number of sectors
+     */
+    static void SetSectors(const G4int n) { sectors = n; }
+
+    [[nodiscard]] static G4int GetSectors() { return sectors; }
+
+    /**
+     * Getter for the accumulated dose per angular sector (MeV), filled if sectors are tallied
+     * @return map of volume name to deposit per sector
+     */
+    static std::map<std::string, std::vector<G4double> > &getSectorDoseMap();
+
+    /**
+     * Adds the tallies of the calling thread to the shared dose maps and resets them (thread-safe)
+     */
+    static void MergeThreadTallies();
+
+    /**
+     * Adds tallies (e.g. those of a checkpoint) to the shared dose maps (thread-safe)
+     */
+    static void AddTallies(const std::map<std::string, Tally> &tallies);
+
+    /**
+     * Getter for a copy of the tallies of the calling thread (the events it finished so far in this run)
+     */
+    static std::map<std::string, Tally> GetThreadTallies();
+
+    /**
+     * Getter for the shared dose maps as tallies (complete after all threads merged)
+     */
+    static std::map<std::string, Tally> GetMergedTallies();
+
+    /**
+     * Approximate bytes held by the scoring buffers of the calling thread (event deposits and tallies)
+     */
+    static std::size_t GetThreadFootprint();
+
+    /**
+     * Approximate bytes held by the shared dose maps
+     */
+    static std::size_t GetSharedFootprint();
+
+    /**
+     * Resets the tallies of the calling thread and, on the master, the shared dose maps
+     * @param master true on the master thread
+     */
+    static void ClearTallies(G4bool master);
+
     /**
      * Getter for dose map
      * @return map of volume name to accumulated dose
      */
     static std::map<std::string, G4double> &getDoseMap();
 
+    /**
+     * Getter for the sum over events of the squared energy deposit per event (MeV2), for the statistical error
+     * @return map of volume name to sum of squares
+     */
+    static std::map<std::string, G4double> &getDoseSquaredMap();
 
     /**
      * Getter for volume map
@@ -61,11 +150,33 @@ public:
     static void setVolume(const std::string &name, const G4double volume) { volumeMap[name] = volume; }
 
 private:
+    // Reproducible runs: sets the dose maps to the shared fixed-point sums (with the merge lock held)
+    static void UpdateFromFixed();
+
     /**
      * Map of volume name to accumulated dose (in MeV)
      */
     static std::map<std::string, G4double> doseMap;
 
+    /**
+     * Map of volume name to accumulated squared energy deposit per event (in MeV2)
+     */
+    static std::map<std::string, G4double> doseSquaredMap;
+
+    /**
+     * Map of volume name to accumulated dose per replica (in MeV)
+     */
+    static std::map<std::string, std::vector<G4double> > replicaDoseMap;
+
+    static G4int replicas;
+
+    /**
+     * Map of volume name to accumulated dose per angular sector (in MeV)
+     */
+    static std::map<std::string, std::vector<G4double> > sectorDoseMap;
+
+    static G4int sectors;
+
     /**
      * Map of volume name to volume (in mm3)
      */
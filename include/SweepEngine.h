@@ -0,0 +1,77 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef SweepEngine_h
+#define SweepEngine_h
+
+#include "globals.hh"
+#include <string>
+#include <vector>
+
+class SweepMessenger;
+
+/**
+ * Parameter sweep inside one run manager lifetime.
+ *
+ * Loops over insects (outer loop, the geometry is rebuilt only when the insect changes) and sources
+ * (monochromatic energies, then spectrum files) by applying the usual /detector/ and /generator/ commands and
+ * /run/beamOn. The physics tables are built once for the highest energy of the sweep, so changing the source does
+ * not rebuild them; they are rebuilt only if the materials change. Visualisation is disabled during the sweep.
+ * Every run adds its rows to one combined results table.
+ */
+class SweepEngine final {
+public:
+    SweepEngine();
+
+    ~SweepEngine();
+
+    void SetInsects(const std::vector<std::string> &names) { insects = names; }
+
+    void SetEnergies(const std::vector<G4double> &values) { energies = values; }
+
+    void SetSpectra(const std::vector<std::string> &files) { spectra = files; }
+
+    void SetEvents(const G4int n) { events = n; }
+
+    void SetResultsFile(const std::string &filename) { resultsFile = filename; }
+
+    // Forget insects, energies and spectra
+    void Clear();
+
+    /**
+     * Reads a sweep file: each line is the name of a /sweep/ command and its arguments, e.g.
+     * "insects drosophila sitophilus", "energies 10 15.2 20 keV", "spectra a.txt b.txt", "events 100000"
+     * @param filename sweep file
+     */
+    void ReadFile(const std::string &filename);
+
+    // Runs all combinations (master, Idle state)
+    void Run();
+
+private:
+    std::vector<std::string> insects; // empty: the current insect
+    std::vector<G4double> energies;
+    std::vector<std::string> spectra;
+    G4int events{100000};
+    std::string resultsFile{"sweep_results.txt"};
+
+    SweepMessenger *messenger{nullptr};
+};
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef TomographyScan_h
+#define TomographyScan_h
+
+#include "G4ThreeVector.hh"
+#include "globals.hh"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+class G4Event;
+
+/**
+ * Angular schedule of a tomographic scan. The specimen rotates about an axis perpendicular to the beam while it is
+ * exposed; rotating the sample by +angle is equivalent to rotating the source by -angle about the same axis, so a
+ * single run with an angle sampled per event gives the dose accumulated over the whole scan.
+ *
+ * The schedule is either a regular scan (equal exposure per projection, or a continuous rotation) or a list of
+ * angles with relative exposures read from a file. Doses can be split into equal angular sectors of the scan.
+ */
+class TomographyScan final {
+public:
+    /**
+     * Regular scan: projections at start + i * range / projections, each exposed equally
+     * @param start first angle
+     * @param range scanned range (e.g. 180 or 360 deg)
+     * @param projections number of projections (0: continuous rotation over the range)
+     */
+    void SetRegular(G4double start, G4double range, G4int projections);
+
+    /**
+     * Reads a schedule: one "angle [exposure]" per line (angle in deg, exposure defaults to 1, '#' comments).
+     * The scan range of the sectors runs from the first to the last angle plus the mean angular step.
+     * @param filename schedule file
+     * @return false (schedule unchanged) if the file holds no angles
+     */
+    G4bool LoadSchedule(const std::string &filename);
+
+    // Back to a fixed specimen
+    void Disable() { active = false; }
+
+    [[nodiscard]] G4bool IsActive() const { return active; }
+
+    // Direction of the rotation axis (normalised; default +y, perpendicular to the -z beam)
+    void SetAxis(const G4ThreeVector &direction) { axis = direction.unit(); }
+
+    [[nodiscard]] const G4ThreeVector &GetAxis() const { return axis; }
+
+    // A point on the rotation axis; without one the axis passes through the centre of the meshes
+    void SetAxisPoint(const G4ThreeVector &point) { axisPoint = point; autoAxisPoint = false; }
+
+    [[nodiscard]] G4bool HasAxisPoint() const { return !autoAxisPoint; }
+
+    // Number of equal angular sectors of the scan range the dose is split into (0: no split)
+    void SetSectors(const G4int n) { sectors = std::max(0, n); }
+
+    [[nodiscard]] G4int GetSectors() const { return active ? sectors : 0; }
+
+    [[nodiscard]] G4double GetStart() const { return start; }
+
+    [[nodiscard]] G4double GetRange() const { return range; }
+
+    /**
+     * Samples a specimen angle of the schedule, projections weighted by their exposure
+     * @param u uniform random number in [0, 1)
+     * @return angle
+     */
+    [[nodiscard]] G4double Sample(G4double u) const;
+
+    // Sector of an angle of the schedule
+    [[nodiscard]] G4int Sector(G4double angle) const;
+
+    /**
+     * Rotates all primary vertices (positions and directions) of an event by -angle about the axis
+     * @param event event with its primaries
+     * @param angle specimen angle
+     * @param axisCentre point on the axis to use (see HasAxisPoint)
+     */
+    void RotateEvent(G4Event *event, G4double angle, const G4ThreeVector &axisCentre) const;
+
+    [[nodiscard]] const G4ThreeVector &GetAxisPoint() const { return axisPoint; }
+
+private:
+    G4bool active{false};
+    G4double start{0.0};
+    G4double range{0.0};
+    G4bool continuous{false};
+    std::vector<G4double> angles; // discrete schedule
+    std::vector<G4double> cumulative; // normalised cumulative exposure of *angles*
+    G4int sectors{0};
+    G4ThreeVector axis{0., 1., 0.};
+    G4ThreeVector axisPoint;
+    G4bool autoAxisPoint{true};
+};
+
+#endif
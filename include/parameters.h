@@ -24,6 +24,7 @@
 
 inline G4double beamSize = 10 * CLHEP::mm;
 inline G4double beamArea = beamSize * beamSize; // mm2
+inline G4double beamStartZ = 5 * CLHEP::mm; // source plane (before the scaled meshes), beam travels along -z
 
 
 #endif //DOSE_SIM_BEETLES_PARAMETERS_H
@@ -20,64 +20,277 @@
 #include "G4RunManager.hh"
 #include "G4MTRunManager.hh"
 #include "G4UImanager.hh"
+#include "G4Threading.hh"
+#ifndef INSECT_DOSE_HEADLESS
 #include "G4VisExecutive.hh"
 #include "G4UIExecutive.hh"
+#endif
 
 #include "DetectorConstruction.h"
 #include "PhysicsList.h"
 #include "ActionInitialization.h"
+#include "RayCastDoseEngine.h"
+#include "SensitivityAnalysis.h"
+#include "PhaseSpaceFile.h"
+#include "PhaseSpaceRecorder.h"
+#include "PresetComparison.h"
+#include "PartitionedRun.h"
+#include "Checkpoint.h"
+#include "RunTelemetry.h"
+#include "StepProfiler.h"
+#include "SweepEngine.h"
+#include "ResponseMatrix.h"
+#include "ImportanceBiasing.h"
+#include "SimulationDaemon.h"
 
 #include "QBBC.hh"
 
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
 
 int main(const int argc, char **argv) {
+    // Command line: [--physics <preset>] [--sampling <mode>] [--suffix <s>] [--json <file>] [--compare-presets]
+    //               [--compare-sampling] [--woodcock] [--compare-woodcock] [--importance] [--compare-importance]
+    //               [--convert-rays <ray file> <phase-space file>]
+    //               [--partition <index> <count>] [--partial-prefix <prefix>] [--run-partitions <count>]
+    //               [--merge <report> <partial>...] [--daemon <socket|->] [--daemon-queue <n>]
+    //               [--fold <response file> <spectrum file> <photon flux>] [macro]
+    std::string macroFile;
+    std::vector<G4String> setupCommands; // applied before the macro
+    bool comparePresets = false;
+    bool compareSampling = false;
+    bool compareWoodcock = false;
+    bool compareImportance = false;
+    std::string rayFile, rayOutput;
+    int runPartitions = 0;
+    std::vector<std::string> mergeFiles; // report, then partials
+    std::string daemonSocket; // "-": stdin
+    int daemonQueue = 16;
+    std::vector<std::string> foldArguments; // response file, spectrum file, photon flux
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--physics" && i + 1 < argc) {
+            setupCommands.push_back("/physics/selectPreset " + std::string(argv[++i]));
+        } else if (arg == "--sampling" && i + 1 < argc) {
+            setupCommands.push_back("/generator/setSampling " + std::string(argv[++i]));
+        } else if (arg == "--suffix" && i + 1 < argc) {
+            setupCommands.push_back("/output/setFileNameSuffix " + std::string(argv[++i]));
+        } else if (arg == "--json" && i + 1 < argc) {
+            setupCommands.push_back("/output/setJsonSummaryFile " + std::string(argv[++i]));
+        } else if (arg == "--compare-presets") {
+            comparePresets = true;
+        } else if (arg == "--compare-sampling") {
+            compareSampling = true;
+        } else if (arg == "--woodcock") {
+            setupCommands.emplace_back("/physics/setWoodcock true");
+        } else if (arg == "--compare-woodcock") {
+            compareWoodcock = true;
+        } else if (arg == "--importance") {
+            setupCommands.emplace_back("/importance/enable true");
+        } else if (arg == "--compare-importance") {
+            compareImportance = true;
+        } else if (arg == "--partition" && i + 2 < argc) {
+            setupCommands.push_back("/partition/select " + std::string(argv[i + 1]) + " " + argv[i + 2]);
+            i += 2;
+        } else if (arg == "--partial-prefix" && i + 1 < argc) {
+            setupCommands.push_back("/partition/setPartialPrefix " + std::string(argv[++i]));
+        } else if (arg == "--run-partitions" && i + 1 < argc) {
+            runPartitions = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--merge" && i + 2 < argc) {
+            mergeFiles.assign(argv + i + 1, argv + argc);
+            break;
+        } else if (arg == "--daemon" && i + 1 < argc) {
+            daemonSocket = argv[++i];
+        } else if (arg == "--daemon-queue" && i + 1 < argc) {
+            daemonQueue = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--fold" && i + 3 < argc) {
+            foldArguments.assign(argv + i + 1, argv + i + 4);
+            i += 3;
+        } else if (arg == "--convert-rays" && i + 2 < argc) {
+            rayFile = argv[++i];
+            rayOutput = argv[++i];
+        } else {
+            macroFile = arg;
+        }
+    }
+
+    // One-off conversion of a beamline ray file for /generator/setPhaseSpaceFile
+    if (!rayFile.empty()) {
+        return PhaseSpaceFile::ConvertRayFile(rayFile, rayOutput) ? 0 : 1;
+    }
+
+    // Final report of a split run from its partial results
+    if (!mergeFiles.empty()) {
+        return PartitionedRun::Merge({mergeFiles.begin() + 1, mergeFiles.end()}, mergeFiles.front());
+    }
+
+    // Dose of a spectrum from a response file, without initialising the simulation
+    if (!foldArguments.empty()) {
+        return ResponseMatrix::FoldFiles(foldArguments[0], foldArguments[1], std::atof(foldArguments[2].c_str()), "");
+    }
+
+    // Split run on this machine: one child process per partition, then merge
+    if (runPartitions > 0) {
+        if (macroFile.empty()) {
+            G4cerr << "--run-partitions needs a macro file" << G4endl;
+            return 1;
+        }
+        return PartitionedRun::RunPartitions(argv[0], macroFile, runPartitions);
+    }
+
+    // Speed/accuracy report of the physics presets: one child run per preset
+    if (comparePresets) {
+        if (macroFile.empty()) {
+            G4cerr << "--compare-presets needs a macro file" << G4endl;
+            return 1;
+        }
+        return RunPresetComparison(argv[0], macroFile, {"penelope", "livermore", "option4", "fast"});
+    }
+
+    // Figure of merit of quasi-random against pseudo-random source sampling: one child run per mode
+    if (compareSampling) {
+        if (macroFile.empty()) {
+            G4cerr << "--compare-sampling needs a macro file" << G4endl;
+            return 1;
+        }
+        return RunSamplingComparison(argv[0], macroFile, {"pseudo", "sobol"});
+    }
+
+    // Speed and dose agreement of Woodcock tracking against standard navigation
+    if (compareWoodcock) {
+        if (macroFile.empty()) {
+            G4cerr << "--compare-woodcock needs a macro file" << G4endl;
+            return 1;
+        }
+        return RunWoodcockComparison(argv[0], macroFile);
+    }
+
+    // Figure of merit of importance sampling toward the insect against analog transport
+    if (compareImportance) {
+        if (macroFile.empty()) {
+            G4cerr << "--compare-importance needs a macro file" << G4endl;
+            return 1;
+        }
+        return RunImportanceComparison(argv[0], macroFile);
+    }
+
     // Detect interactive mode
+#ifdef INSECT_DOSE_HEADLESS
+    // Batch-only build: no UI session and no vis drivers
+    if (macroFile.empty() && daemonSocket.empty()) {
+        G4cerr << "This batch-only build needs a macro file or --daemon" << G4endl;
+        return 1;
+    }
+    [[maybe_unused]] constexpr bool interactive = false;
+#else
     G4UIExecutive *ui = nullptr;
-    if (argc == 1) {
+    if (macroFile.empty() && daemonSocket.empty()) {
         ui = new G4UIExecutive(argc, argv);
     }
+    [[maybe_unused]] const bool interactive = ui != nullptr;
+#endif
 
     // Construct the run manager
 #ifdef G4MULTITHREADED
     auto *runManager = new G4MTRunManager;
-    if (ui) {
-        G4cout << "WARNING: Visualization is not supported in multi-threaded mode." << G4endl;
-        G4cout << "Running with 1 thread." << G4endl;
-        runManager->SetNumberOfThreads(1);
-    } else {
-        runManager->SetNumberOfThreads(10);
-    }
+    // Interactive sessions use all cores; the vis sub-thread draws from a bounded queue of (decimated) events
+    runManager->SetNumberOfThreads(interactive ? G4Threading::G4GetNumberOfCores() : 10);
 #else
     G4RunManager *runManager = new G4RunManager;
 #endif
 
     // Set mandatory initialization classes
-    runManager->SetUserInitialization(new DetectorConstruction());
+    auto *detector = new DetectorConstruction();
+    runManager->SetUserInitialization(detector);
     runManager->SetUserInitialization(new PhysicsList());
     runManager->SetUserInitialization(new ActionInitialization());
 
+    // Deterministic primary-dose engine (/raycast/ commands)
+    auto *rayCastEngine = new RayCastDoseEngine(detector);
+
+    // Correlated-sampling material sensitivity (/sensitivity/ commands)
+    auto *sensitivity = new SensitivityAnalysis();
+
+    // Phase-space recording upstream of the sample (/phasespace/ commands)
+    auto *phaseSpaceRecorder = new PhaseSpaceRecorder();
+
+    // Split runs: RNG stream and partial results of this partition (/partition/ commands)
+    auto *partitionedRun = new PartitionedRun();
+
+    // Checkpoints, resuming and extending runs (/run/checkpoint, /run/resume, /run/extend)
+    auto *checkpoint = new Checkpoint();
+
+    // Live progress snapshots (/telemetry/ commands)
+    auto *telemetry = new RunTelemetry();
+
+    // Step profile by particle, process and volume (/profile/ commands)
+    auto *stepProfiler = new StepProfiler();
+
+    // Insect/source sweeps inside this process (/sweep/ commands)
+    auto *sweepEngine = new SweepEngine();
+
+    // Energy-response matrix and spectrum folding (/response/ commands)
+    auto *responseMatrix = new ResponseMatrix();
+
+    // Photon splitting and Russian roulette toward the insect (/importance/ commands)
+    auto *importanceBiasing = new ImportanceBiasing(detector);
+
+#ifndef INSECT_DOSE_HEADLESS
     // Initialize visualization manager
     G4VisManager *visManager = new G4VisExecutive;
     visManager->Initialize();
+#endif
 
     // Get the pointer to the User Interface manager
     G4UImanager *ui_manager = G4UImanager::GetUIpointer();
+    for (const auto &command: setupCommands) {
+        ui_manager->ApplyCommand(command);
+    }
 
+#ifndef INSECT_DOSE_HEADLESS
     if (ui) {
         // Interactive mode
+#ifdef G4MULTITHREADED
+        // Workers wait (instead of dropping events) when the vis sub-thread falls 100 events behind
+        ui_manager->ApplyCommand("/vis/multithreading/maxEventQueueSize 100");
+        ui_manager->ApplyCommand("/vis/multithreading/actionOnEventQueueFull wait");
+#endif
         ui_manager->ApplyCommand("/control/execute macros/vis.mac");
         ui->SessionStart();
         delete ui;
-    } else {
-        // Batch mode
+    } else
+#endif
+    {
+        // Batch mode (in daemon mode the macro only sets up the simulation)
         const G4String command = "/control/execute ";
-        const G4String fileName = argv[1];
-        ui_manager->ApplyCommand(command + fileName);
+        if (!macroFile.empty()) ui_manager->ApplyCommand(command + macroFile);
+    }
+
+    // Daemon mode: initialised once, then jobs over a socket or stdin
+    int status = 0;
+    if (!daemonSocket.empty()) {
+        SimulationDaemon daemon(daemonQueue);
+        status = daemon.Serve(daemonSocket);
     }
 
     // Job termination
+    delete importanceBiasing;
+    delete responseMatrix;
+    delete sweepEngine;
+    delete stepProfiler;
+    delete telemetry;
+    delete checkpoint;
+    delete partitionedRun;
+    delete phaseSpaceRecorder;
+    delete sensitivity;
+    delete rayCastEngine;
+#ifndef INSECT_DOSE_HEADLESS
     delete visManager;
+#endif
     delete runManager;
 
-    return 0;
+    return status;
 }
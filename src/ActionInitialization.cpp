@@ -27,11 +27,15 @@ ActionInitialization::ActionInitialization()
     : G4VUserActionInitialization() {
 }
 
-ActionInitialization::~ActionInitialization()
-= default;
+ActionInitialization::~ActionInitialization() {
+    delete masterGenerator;
+}
 
 void ActionInitialization::BuildForMaster() const {
     SetUserAction(new RunAction());
+
+    // Not registered as user action (the master does not generate events); it only tracks the /generator/ settings
+    if (!masterGenerator) masterGenerator = new PrimaryGeneratorAction();
 }
 
 void ActionInitialization::Build() const {
@@ -0,0 +1,315 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "Checkpoint.h"
+#include "CheckpointMessenger.h"
+#include "DetectorConstruction.h"
+#include "PrimaryGeneratorAction.h"
+#include "G4AutoLock.hh"
+#include "G4RunManager.hh"
+#include "G4Run.hh"
+#include "G4Threading.hh"
+#include "G4UImanager.hh"
+#include "Randomize.hh"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+    constexpr char kMagic[8] = {'I', 'D', 'S', 'C', 'K', 'P', 'T', '1'};
+    constexpr std::uint32_t kVersion = 1;
+
+    // Latest snapshot of one thread
+    struct Snapshot {
+        G4long events{0};
+        std::map<std::string, SteppingAction::Tally> tallies;
+        std::string engine;
+    };
+
+    std::map<G4int, Snapshot> snapshots;
+    G4Mutex checkpointMutex = G4MUTEX_INITIALIZER;
+
+    thread_local G4long threadEvents = 0;
+    thread_local std::chrono::steady_clock::time_point lastSnapshot;
+
+    std::string EngineState() {
+        std::ostringstream os;
+        G4Random::getTheEngine()->put(os);
+        return os.str();
+    }
+
+    template<typename T>
+    void Put(std::ostream &out, const T &value) { out.write(reinterpret_cast<const char *>(&value), sizeof(T)); }
+
+    void PutString(std::ostream &out, const std::string &value) {
+        Put(out, static_cast<std::uint64_t>(value.size()));
+        out.write(value.data(), static_cast<std::streamsize>(value.size()));
+    }
+
+    void PutVector(std::ostream &out, const std::vector<G4double> &values) {
+        Put(out, static_cast<std::uint64_t>(values.size()));
+        out.write(reinterpret_cast<const char *>(values.data()),
+                  static_cast<std::streamsize>(values.size() * sizeof(G4double)));
+    }
+
+    template<typename T>
+    bool Get(std::istream &in, T &value) {
+        return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+    }
+
+    bool GetString(std::istream &in, std::string &value) {
+        std::uint64_t size = 0;
+        if (!Get(in, size) || size > (1u << 30)) return false;
+        value.resize(size);
+        return static_cast<bool>(in.read(value.data(), static_cast<std::streamsize>(size)));
+    }
+
+    bool GetVector(std::istream &in, std::vector<G4double> &values) {
+        std::uint64_t size = 0;
+        if (!Get(in, size) || size > (1u << 24)) return false;
+        values.resize(size);
+        return static_cast<bool>(in.read(reinterpret_cast<char *>(values.data()),
+                                         static_cast<std::streamsize>(size * sizeof(G4double))));
+    }
+}
+
+std::string Checkpoint::filename;
+G4double Checkpoint::interval = 600.0;
+Checkpoint::State Checkpoint::base;
+Checkpoint::State Checkpoint::current;
+
+Checkpoint::Checkpoint() {
+    messenger = new CheckpointMessenger();
+}
+
+Checkpoint::~Checkpoint() {
+    delete messenger;
+}
+
+void Checkpoint::Enable(const std::string &file, const G4double seconds) {
+    filename = file;
+    if (seconds > 0.0) interval = seconds;
+    if (IsEnabled()) G4cout << "Checkpoint: writing '" << filename << "' every " << interval << " s" << G4endl;
+}
+
+G4bool Checkpoint::Load(const std::string &file) {
+    State state;
+    if (!Read(file, state)) return false;
+    base = state;
+    // Keep checkpointing the continued run to the same file unless another one is set
+    if (!IsEnabled()) filename = file;
+    G4cout << "Checkpoint: loaded '" << file << "' (" << base.events << " of " << base.targetEvents
+            << " events, " << base.segment << " segment" << (base.segment == 1 ? "" : "s") << ")" << G4endl;
+    return true;
+}
+
+G4long Checkpoint::GetRemainingEvents() {
+    return std::max<G4long>(0, base.targetEvents - base.events);
+}
+
+void Checkpoint::Continue(const std::string &file, const G4long events) {
+    if (!Load(file)) return;
+    const G4long remaining = events > 0 ? events : GetRemainingEvents();
+    if (remaining <= 0) {
+        G4cout << "Checkpoint: the run of '" << file << "' is complete, add events with /run/extend" << G4endl;
+        base = State{};
+        return;
+    }
+    G4UImanager *uiManager = G4UImanager::GetUIpointer();
+    const auto *detector = dynamic_cast<const DetectorConstruction *>(
+        G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+    if (detector && !base.insect.empty() && detector->GetSelectedInsect() != base.insect) {
+        uiManager->ApplyCommand("/detector/selectInsect " + base.insect);
+    }
+    uiManager->ApplyCommand("/run/beamOn " + std::to_string(remaining));
+}
+
+void Checkpoint::BeginOfRun(const G4Run *run, const G4bool master) {
+    threadEvents = 0;
+    lastSnapshot = std::chrono::steady_clock::now();
+    if (!master) return;
+
+    G4AutoLock lock(&checkpointMutex);
+    snapshots.clear();
+
+    const auto *detector = dynamic_cast<const DetectorConstruction *>(
+        G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+    current = State{};
+    current.insect = detector ? std::string(detector->GetSelectedInsect()) : std::string();
+    current.sourcePhotonsPerEvent = PrimaryGeneratorAction::GetSourcePhotonsPerEvent();
+    current.targetEvents = base.events + run->GetNumberOfEventToBeProcessed();
+    current.segment = base.segment + 1;
+
+    if (base.segment > 0) {
+        if (base.insect != current.insect) {
+            G4cerr << "Checkpoint: the checkpoint holds insect '" << base.insect << "', this run simulates '"
+                    << current.insect << "'" << G4endl;
+        }
+        if (std::abs(base.sourcePhotonsPerEvent - current.sourcePhotonsPerEvent) >
+            1e-9 * base.sourcePhotonsPerEvent) {
+            G4cerr << "Checkpoint: source photons per event differ from the checkpoint (" << base.sourcePhotonsPerEvent
+                    << " vs " << current.sourcePhotonsPerEvent << "), the source is not the same" << G4endl;
+        }
+        SteppingAction::AddTallies(base.tallies);
+
+        // A stream of its own for every segment, reproducible from the checkpoint alone
+        CLHEP::HepRandomEngine *engine = G4Random::getTheEngine();
+        if (!base.masterEngine.empty()) {
+            std::istringstream is(base.masterEngine);
+            engine->get(is);
+        }
+        const long seeds[4] = {
+            static_cast<long>(engine->flat() * 2147483647.0), static_cast<long>(engine->flat() * 2147483647.0),
+            static_cast<long>(base.segment), 0
+        };
+        engine->setSeeds(seeds, 4);
+        G4cout << "Checkpoint: continuing with segment " << current.segment << " (" << base.events << " events in "
+                << "the checkpoint)" << G4endl;
+    }
+    current.masterEngine = EngineState();
+}
+
+void Checkpoint::EndOfEvent() {
+    ++threadEvents;
+    if (!IsEnabled()) return;
+    const auto now = std::chrono::steady_clock::now();
+    if (std::chrono::duration<G4double>(now - lastSnapshot).count() < interval) return;
+    lastSnapshot = now;
+
+    Snapshot snapshot{threadEvents, SteppingAction::GetThreadTallies(), EngineState()};
+    G4AutoLock lock(&checkpointMutex);
+    snapshots[G4Threading::G4GetThreadId()] = std::move(snapshot);
+    WriteSnapshots();
+}
+
+void Checkpoint::WriteSnapshots() {
+    State state = current;
+    state.events = base.events;
+    state.tallies = base.tallies;
+    for (const auto &[thread, snapshot]: snapshots) {
+        state.events += snapshot.events;
+        for (const auto &[name, tally]: snapshot.tallies) state.tallies[name].Add(tally);
+        state.threadEngines[thread] = snapshot.engine;
+    }
+    Write(filename, state);
+}
+
+void Checkpoint::EndOfRun(const G4long events) {
+    G4AutoLock lock(&checkpointMutex);
+    if (IsEnabled()) {
+        State state = current;
+        state.events = events;
+        state.tallies = SteppingAction::GetMergedTallies();
+        for (const auto &[thread, snapshot]: snapshots) state.threadEngines[thread] = snapshot.engine;
+        if (Write(filename, state)) G4cout << "Checkpoint: final state written to '" << filename << "'" << G4endl;
+    }
+    snapshots.clear();
+    base = State{};
+}
+
+G4bool Checkpoint::Write(const std::string &file, const State &state) {
+    std::ostringstream out;
+    out.write(kMagic, sizeof(kMagic));
+    Put(out, kVersion);
+    PutString(out, state.insect);
+    Put(out, static_cast<std::int64_t>(state.targetEvents));
+    Put(out, static_cast<std::int64_t>(state.events));
+    Put(out, static_cast<std::int32_t>(state.segment));
+    Put(out, state.sourcePhotonsPerEvent);
+    Put(out, static_cast<std::uint64_t>(state.tallies.size()));
+    for (const auto &[name, tally]: state.tallies) {
+        PutString(out, name);
+        Put(out, tally.sum);
+        Put(out, tally.sum2);
+        PutVector(out, tally.replicaSum);
+        PutVector(out, tally.sectorSum);
+    }
+    PutString(out, state.masterEngine);
+    Put(out, static_cast<std::uint64_t>(state.threadEngines.size()));
+    for (const auto &[thread, engine]: state.threadEngines) {
+        Put(out, static_cast<std::int32_t>(thread));
+        PutString(out, engine);
+    }
+    const std::string data = out.str();
+
+    // Write and sync a temporary file, then rename it over the old checkpoint: a crash leaves one or the other
+    const std::string temporary = file + ".tmp";
+    const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd >= 0;
+    for (std::size_t written = 0; ok && written < data.size();) {
+        const ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+        ok = n > 0;
+        if (ok) written += static_cast<std::size_t>(n);
+    }
+    if (fd >= 0) {
+        ok = ::fsync(fd) == 0 && ok;
+        ok = ::close(fd) == 0 && ok;
+    }
+    if (ok) ok = std::rename(temporary.c_str(), file.c_str()) == 0;
+    if (!ok) {
+        G4cerr << "Checkpoint: cannot write '" << file << "': " << std::strerror(errno) << G4endl;
+        std::remove(temporary.c_str());
+    }
+    return ok;
+}
+
+G4bool Checkpoint::Read(const std::string &file, State &state) {
+    std::ifstream in(file, std::ios::binary);
+    char magic[sizeof(kMagic)] = {};
+    std::uint32_t version = 0;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 || !Get(in, version) ||
+        version != kVersion) {
+        G4cerr << "Checkpoint: '" << file << "' is not a checkpoint of this version" << G4endl;
+        return false;
+    }
+    state = State{};
+    std::int64_t targetEvents = 0, events = 0;
+    std::int32_t segment = 0;
+    std::uint64_t nTallies = 0, nEngines = 0;
+    bool ok = GetString(in, state.insect) && Get(in, targetEvents) && Get(in, events) && Get(in, segment) &&
+              Get(in, state.sourcePhotonsPerEvent) && Get(in, nTallies);
+    for (std::uint64_t i = 0; ok && i < nTallies; ++i) {
+        std::string name;
+        SteppingAction::Tally tally;
+        ok = GetString(in, name) && Get(in, tally.sum) && Get(in, tally.sum2) && GetVector(in, tally.replicaSum) &&
+             GetVector(in, tally.sectorSum);
+        if (ok) state.tallies[name] = tally;
+    }
+    ok = ok && GetString(in, state.masterEngine) && Get(in, nEngines);
+    for (std::uint64_t i = 0; ok && i < nEngines; ++i) {
+        std::int32_t thread = 0;
+        ok = Get(in, thread) && GetString(in, state.threadEngines[thread]);
+    }
+    if (!ok) {
+        G4cerr << "Checkpoint: '" << file << "' is truncated" << G4endl;
+        return false;
+    }
+    state.targetEvents = targetEvents;
+    state.events = events;
+    state.segment = segment;
+    return true;
+}
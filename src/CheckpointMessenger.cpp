@@ -0,0 +1,86 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "CheckpointMessenger.h"
+#include "Checkpoint.h"
+#include "G4UIcommand.hh"
+#include "G4UIparameter.hh"
+#include "G4UIcmdWithAString.hh"
+#include <sstream>
+
+CheckpointMessenger::CheckpointMessenger() {
+    // Checkpoints are handled by the master: do not broadcast these commands to the workers
+    checkpointCmd = new G4UIcommand("/run/checkpoint", this);
+    checkpointCmd->SetGuidance("Write periodic crash-safe checkpoints of the run to <file> ('none': off)");
+    checkpointCmd->SetGuidance("Every thread updates its snapshot in the file after <interval> seconds.");
+    checkpointCmd->SetParameter(new G4UIparameter("file", 's', false));
+    auto *intervalParam = new G4UIparameter("interval", 'd', true);
+    intervalParam->SetDefaultValue(600.0);
+    intervalParam->SetParameterRange("interval>0");
+    checkpointCmd->SetParameter(intervalParam);
+    checkpointCmd->SetToBeBroadcasted(false);
+    checkpointCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    resumeCmd = new G4UIcmdWithAString("/run/resume", this);
+    resumeCmd->SetGuidance("Continue the run of a checkpoint with its missing events");
+    resumeCmd->SetParameterName("file", false);
+    resumeCmd->SetToBeBroadcasted(false);
+    resumeCmd->AvailableForStates(G4State_Idle);
+
+    extendCmd = new G4UIcommand("/run/extend", this);
+    extendCmd->SetGuidance("Add <events> events to the (finished) run of a checkpoint");
+    extendCmd->SetGuidance("Without a file the checkpoint set with /run/checkpoint is extended.");
+    auto *eventsParam = new G4UIparameter("events", 'i', false);
+    eventsParam->SetParameterRange("events>0");
+    extendCmd->SetParameter(eventsParam);
+    auto *fileParam = new G4UIparameter("file", 's', true);
+    fileParam->SetDefaultValue("");
+    extendCmd->SetParameter(fileParam);
+    extendCmd->SetToBeBroadcasted(false);
+    extendCmd->AvailableForStates(G4State_Idle);
+}
+
+CheckpointMessenger::~CheckpointMessenger() {
+    delete checkpointCmd;
+    delete resumeCmd;
+    delete extendCmd;
+}
+
+void CheckpointMessenger::SetNewValue(G4UIcommand *command, G4String newValue) {
+    if (command == checkpointCmd) {
+        std::istringstream is(newValue);
+        std::string file;
+        G4double interval = 600.0;
+        is >> file >> interval;
+        Checkpoint::Enable(file == "none" ? "" : file, interval);
+    } else if (command == resumeCmd) {
+        Checkpoint::Continue(newValue);
+    } else if (command == extendCmd) {
+        std::istringstream is(newValue);
+        G4long events = 0;
+        std::string file;
+        is >> events >> file;
+        if (file.empty()) file = Checkpoint::GetFilename();
+        if (file.empty()) {
+            G4cerr << "/run/extend: no checkpoint file given or set with /run/checkpoint" << G4endl;
+            return;
+        }
+        Checkpoint::Continue(file, events);
+    }
+}
@@ -30,11 +30,17 @@
 #include "G4TessellatedSolid.hh"
 #include "G4TriangularFacet.hh"
 #include "SteppingAction.h"
+#include "MemoryReport.h"
+#include "PhysicsList.h"
 #include "G4RunManager.hh"
+#include "G4Region.hh"
+#include "G4RegionStore.hh"
 #include <fstream>
 #include <iostream>
 #include <map>
 #include <cfloat>
+#include <algorithm>
+#include <cmath>
 
 DetectorConstruction::DetectorConstruction()
     : G4VUserDetectorConstruction(),
@@ -51,6 +57,8 @@ DetectorConstruction::~DetectorConstruction() {
 }
 
 G4VPhysicalVolume *DetectorConstruction::Construct() {
+    MemoryReport::Record(MemoryReport::kGeometryBegin);
+
     // Get NIST material manager
     G4NistManager *nist = G4NistManager::Instance();
 
@@ -77,6 +85,7 @@ G4VPhysicalVolume *DetectorConstruction::Construct() {
     // Construct meshes
     ConstructMeshes();
 
+    MemoryReport::Record(MemoryReport::kGeometryEnd);
     return worldPhys;
 }
 
@@ -174,6 +183,7 @@ G4String DetectorConstruction::GetSelectedInsect() const { return selectedInsect
 
 void DetectorConstruction::ConstructMeshes() {
     G4NistManager *nist = G4NistManager::Instance();
+    meshes.clear();
 
     // Calculate the reference offset from 100_EtOH.stl
     // All meshes will be shifted relative to this reference
@@ -188,17 +198,35 @@ void DetectorConstruction::ConstructMeshes() {
     G4Material *ethanolMat = nist->FindOrBuildMaterial("G4_ETHYL_ALCOHOL");
     G4Material *pmmaMat = nist->FindOrBuildMaterial("G4_PLEXIGLASS");
 
-    constexpr G4double density = 0.95 * g / cm3;
-    const auto insectMat = new G4Material(R"(insectMat)", density, 6);
-    // 30% ethanol and 70% try mass
-    // ethanol = C2H5OH -> C: 2/9, H: 6/9, O: 1/9
-    // dry mass of insect = C: 0.5, H: 0.07, N: 0.09,  O: 0.33, S: 0.005, P: 0.005
-    insectMat->AddElement(nist->FindOrBuildElement("C"), 0.3 * 2. / 9. + 0.7 * 0.5); // Carbon
-    insectMat->AddElement(nist->FindOrBuildElement("N"), 0.3 * 6. / 9. + 0.7 * 0.09); // Nitrogen
-    insectMat->AddElement(nist->FindOrBuildElement("O"), 0.3 * 1. / 9. + 0.7 * 0.33); // Oxygen
-    insectMat->AddElement(nist->FindOrBuildElement("P"), 0.7 * 0.005); // Phosphorus
-    insectMat->AddElement(nist->FindOrBuildElement("S"), 0.7 * 0.005); // Sulfur
-    insectMat->AddElement(nist->FindOrBuildElement("H"), 0.7 * 0.07); // Hydrogen
+    // Reuse the material when the geometry is rebuilt (e.g. another insect), so the material table and the
+    // physics tables built for it stay the same
+    G4Material *insectMat = G4Material::GetMaterial("insectMat", false);
+    if (!insectMat) {
+        constexpr G4double density = 0.95 * g / cm3;
+        insectMat = new G4Material(R"(insectMat)", density, 6);
+        // 30% ethanol and 70% try mass
+        // ethanol = C2H5OH -> C: 2/9, H: 6/9, O: 1/9
+        // dry mass of insect = C: 0.5, H: 0.07, N: 0.09,  O: 0.33, S: 0.005, P: 0.005
+        insectMat->AddElement(nist->FindOrBuildElement("C"), 0.3 * 2. / 9. + 0.7 * 0.5); // Carbon
+        insectMat->AddElement(nist->FindOrBuildElement("N"), 0.3 * 6. / 9. + 0.7 * 0.09); // Nitrogen
+        insectMat->AddElement(nist->FindOrBuildElement("O"), 0.3 * 1. / 9. + 0.7 * 0.33); // Oxygen
+        insectMat->AddElement(nist->FindOrBuildElement("P"), 0.7 * 0.005); // Phosphorus
+        insectMat->AddElement(nist->FindOrBuildElement("S"), 0.7 * 0.005); // Sulfur
+        insectMat->AddElement(nist->FindOrBuildElement("H"), 0.7 * 0.07); // Hydrogen
+    }
+
+    // Woodcock tracking needs a region around the specimen: the meshes go into an air envelope that is sized
+    // once all of them are loaded
+    G4LogicalVolume *meshMother = worldLogical;
+    G4LogicalVolume *envelopeLogical = nullptr;
+    if (const PhysicsList *physicsList = PhysicsList::GetInstance(); physicsList && physicsList->IsWoodcock()) {
+        envelopeLogical = new G4LogicalVolume(new G4Box(kSpecimenRegion, 1 * mm, 1 * mm, 1 * mm),
+                                              nist->FindOrBuildMaterial("G4_AIR"), kSpecimenRegion);
+        envelopeLogical->SetVisAttributes(G4VisAttributes::GetInvisible());
+        new G4PVPlacement(nullptr, G4ThreeVector(0, 0, 0), envelopeLogical, kSpecimenRegion,
+                          worldLogical, false, 0, false);
+        meshMother = envelopeLogical;
+    }
 
     // SELECT INSECT HERE: use fSelectedInsect (can be changed via UI command)
 
@@ -224,7 +252,7 @@ void DetectorConstruction::ConstructMeshes() {
 
     // 1. Load the selected insect (with reference offset)
     const G4String insectFile = insectFiles[selectedInsect];
-    G4VSolid *insectSolid = LoadSTLSolid(insectFile, selectedInsect + "_solid", 10.0, referenceOffset);
+    G4TessellatedSolid *insectSolid = LoadSTLSolid(insectFile, selectedInsect + "_solid", 10.0, referenceOffset);
 
     if (!insectSolid) {
         G4cerr << "ERROR: Failed to load insect mesh!" << G4endl;
@@ -244,11 +272,12 @@ void DetectorConstruction::ConstructMeshes() {
 
     // Place insect
     new G4PVPlacement(nullptr, G4ThreeVector(0, 0, 0), insectLogical, selectedInsect,
-                      worldLogical, false, 0, false);
+                      meshMother, false, 0, false);
     meshLogicalVolumes[selectedInsect] = insectLogical;
+    meshes.push_back({selectedInsect, insectSolid, insectMat});
 
     // 2. Load ethanol and subtract insect from it (with reference offset)
-    if (G4VSolid *ethanolSolid = LoadSTLSolid("meshes/100_EtOH.stl", "Ethanol_solid", 10.0, referenceOffset)) {
+    if (G4TessellatedSolid *ethanolSolid = LoadSTLSolid("meshes/100_EtOH.stl", "Ethanol_solid", 10.0, referenceOffset)) {
         // Create subtraction: Ethanol - Insect
         auto *ethanolSubtracted = new G4SubtractionSolid(
             "Ethanol", ethanolSolid, insectSolid, nullptr, G4ThreeVector(0, 0, 0));
@@ -260,8 +289,9 @@ void DetectorConstruction::ConstructMeshes() {
         ethanolLogical->SetVisAttributes(ethanolVis);
 
         new G4PVPlacement(nullptr, G4ThreeVector(0, 0, 0), ethanolLogical, "Ethanol",
-                          worldLogical, false, 1, false);
+                          meshMother, false, 1, false);
         meshLogicalVolumes["Ethanol"] = ethanolLogical;
+        meshes.push_back({"Ethanol", ethanolSolid, ethanolMat});
 
         // Recompute and store the volume of the subtracted solid (Ethanol - Insect)
         const G4double ethanolSubVolume = ethanolSubtracted->GetCubicVolume();
@@ -270,15 +300,36 @@ void DetectorConstruction::ConstructMeshes() {
     }
 
     // 3. Load tube (with reference offset)
-    if (G4VSolid *tubeSolid = LoadSTLSolid("meshes/tube.stl", "Tube_solid", 10.0, referenceOffset)) {
+    if (G4TessellatedSolid *tubeSolid = LoadSTLSolid("meshes/tube.stl", "Tube_solid", 10.0, referenceOffset)) {
         auto *tubeLogical = new G4LogicalVolume(tubeSolid, pmmaMat, "Tube");
         const auto tubeVis = new G4VisAttributes(G4Colour(0.5, 0.5, 0.5, 0.2));
         tubeVis->SetVisibility(true);
         tubeLogical->SetVisAttributes(tubeVis);
 
         new G4PVPlacement(nullptr, G4ThreeVector(0, 0, 0), tubeLogical, "Tube",
-                          worldLogical, false, 2, false);
+                          meshMother, false, 2, false);
         meshLogicalVolumes["Tube"] = tubeLogical;
+        meshes.push_back({"Tube", tubeSolid, pmmaMat});
+    }
+
+    if (envelopeLogical) {
+        // Centred at the origin like the mesh placements, with a small margin so no facet touches the envelope
+        G4ThreeVector halfExtent;
+        for (const MeshInfo &mesh: meshes) {
+            G4ThreeVector pMin, pMax;
+            mesh.solid->BoundingLimits(pMin, pMax);
+            for (int axis = 0; axis < 3; ++axis) {
+                halfExtent[axis] = std::max({halfExtent[axis], std::abs(pMin[axis]), std::abs(pMax[axis])});
+            }
+        }
+        halfExtent += G4ThreeVector(0.05 * mm, 0.05 * mm, 0.05 * mm);
+        envelopeLogical->SetSolid(new G4Box(kSpecimenRegion, halfExtent.x(), halfExtent.y(), halfExtent.z()));
+
+        // The region survives a geometry rebuild, its previous envelope was removed with the old volumes
+        G4Region *region = G4RegionStore::GetInstance()->GetRegion(kSpecimenRegion, false);
+        if (!region) region = new G4Region(kSpecimenRegion);
+        region->AddRootLogicalVolume(envelopeLogical);
+        G4cout << "Woodcock region '" << kSpecimenRegion << "': half extent " << halfExtent / mm << " mm" << G4endl;
     }
 
     G4cout << "\n=== Geometry loaded ===" << G4endl;
@@ -286,7 +337,7 @@ void DetectorConstruction::ConstructMeshes() {
     G4cout << "Volumes: Tube, Ethanol (with insect subtracted), " << selectedInsect << G4endl;
 }
 
-G4VSolid *DetectorConstruction::LoadSTLSolid(const G4String &filename, const G4String &name,
+G4TessellatedSolid *DetectorConstruction::LoadSTLSolid(const G4String &filename, const G4String &name,
                                              G4double scaleFactor, const G4ThreeVector &offset) {
     std::ifstream file(filename.c_str(), std::ios::binary);
     if (!file.is_open()) {
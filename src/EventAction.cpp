@@ -18,6 +18,18 @@
  */
 
 #include "EventAction.h"
+#include "G4Event.hh"
+#include "G4EventManager.hh"
+#include "SteppingAction.h"
+#include "PrimaryGeneratorAction.h"
+#include "SensitivityAnalysis.h"
+#include "PhaseSpaceRecorder.h"
+#include "StepProfiler.h"
+#include "ImportanceBiasing.h"
+#include "Checkpoint.h"
+#include "RunTelemetry.h"
+
+G4int EventAction::keepEvery = 0;
 
 EventAction::EventAction()
 = default;
@@ -28,4 +40,21 @@ void EventAction::BeginOfEventAction(const G4Event *event) {
 }
 
 void EventAction::EndOfEventAction(const G4Event *event) {
+    // Events are the statistical unit of the uncertainty estimate. A continued checkpoint counts on from its
+    // events, so the replicas keep their share of the events over all segments
+    const G4int replicas = SteppingAction::GetReplicas();
+    const G4long eventIndex = Checkpoint::GetBaseEvents() + event->GetEventID();
+    SteppingAction::EndOfEvent(replicas > 0 ? static_cast<G4int>(eventIndex % replicas) : 0,
+                               PrimaryGeneratorAction::GetEventSector());
+    if (SensitivityAnalysis::IsActive()) SensitivityAnalysis::EndOfEvent();
+    if (PhaseSpaceRecorder::IsRecording()) PhaseSpaceRecorder::EndOfEvent();
+    if (StepProfiler::IsActive()) StepProfiler::EndOfEvent();
+    if (ImportanceBiasing::IsPiloting()) ImportanceBiasing::EndOfEvent();
+    Checkpoint::EndOfEvent();
+    RunTelemetry::EndOfEvent();
+
+    // Decimated trajectories for the viewer
+    if (keepEvery > 0 && event->GetEventID() % keepEvery == 0) {
+        G4EventManager::GetEventManager()->KeepTheCurrentEvent();
+    }
 }
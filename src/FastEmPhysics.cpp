@@ -0,0 +1,88 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "FastEmPhysics.h"
+#include "G4BuilderType.hh"
+#include "G4PhysicsListHelper.hh"
+#include "G4Gamma.hh"
+#include "G4Electron.hh"
+#include "G4Positron.hh"
+#include "G4PhotoElectricEffect.hh"
+#include "G4LivermorePhotoElectricModel.hh"
+#include "G4ComptonScattering.hh"
+#include "G4KleinNishinaCompton.hh"
+#include "G4RayleighScattering.hh"
+#include "G4GammaGeneralProcess.hh"
+#include "G4EmParameters.hh"
+#include "G4eMultipleScattering.hh"
+#include "G4UrbanMscModel.hh"
+#include "G4eIonisation.hh"
+#include "G4eBremsstrahlung.hh"
+#include "G4LossTableManager.hh"
+#include "G4UAtomicDeexcitation.hh"
+
+FastEmPhysics::FastEmPhysics()
+    : G4VPhysicsConstructor("FastEm", bElectromagnetic) {
+}
+
+FastEmPhysics::~FastEmPhysics()
+= default;
+
+void FastEmPhysics::ConstructParticle() {
+    G4Gamma::Gamma();
+    G4Electron::Electron();
+    G4Positron::Positron();
+}
+
+void FastEmPhysics::ConstructProcess() {
+    G4PhysicsListHelper *helper = G4PhysicsListHelper::GetPhysicsListHelper();
+
+    // Photons
+    G4ParticleDefinition *gamma = G4Gamma::Gamma();
+    auto *photoElectric = new G4PhotoElectricEffect();
+    photoElectric->SetEmModel(new G4LivermorePhotoElectricModel());
+    auto *compton = new G4ComptonScattering();
+    compton->SetEmModel(new G4KleinNishinaCompton());
+    auto *rayleigh = new G4RayleighScattering();
+
+    if (G4EmParameters::Instance()->GeneralProcessActive()) {
+        // One process for all photon interactions, required for Woodcock tracking (see PhysicsList::SetWoodcock)
+        auto *general = new G4GammaGeneralProcess();
+        general->AddEmProcess(photoElectric);
+        general->AddEmProcess(compton);
+        general->AddEmProcess(rayleigh);
+        G4LossTableManager::Instance()->SetGammaGeneralProcess(general);
+        helper->RegisterProcess(general, gamma);
+    } else {
+        helper->RegisterProcess(photoElectric, gamma);
+        helper->RegisterProcess(compton, gamma);
+        helper->RegisterProcess(rayleigh, gamma);
+    }
+
+    // Electrons
+    G4ParticleDefinition *electron = G4Electron::Electron();
+    auto *msc = new G4eMultipleScattering();
+    msc->SetEmModel(new G4UrbanMscModel());
+    helper->RegisterProcess(msc, electron);
+    helper->RegisterProcess(new G4eIonisation(), electron);
+    helper->RegisterProcess(new G4eBremsstrahlung(), electron);
+
+    // Fluorescence/Auger are switched through G4EmParameters (see PhysicsList)
+    G4LossTableManager::Instance()->SetAtomDeexcitation(new G4UAtomicDeexcitation());
+}
@@ -0,0 +1,369 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "ImportanceBiasing.h"
+#include "ImportanceMessenger.h"
+#include "ImportanceWorld.h"
+#include "DetectorConstruction.h"
+#include "PhysicsList.h"
+#include "ScopedRunSettings.h"
+#include "G4Box.hh"
+#include "G4LogicalVolume.hh"
+#include "G4PVPlacement.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4TessellatedSolid.hh"
+#include "G4GeometrySampler.hh"
+#include "G4ImportanceBiasing.hh"
+#include "G4ParallelWorldPhysics.hh"
+#include "G4IStore.hh"
+#include "G4Step.hh"
+#include "G4StepPoint.hh"
+#include "G4Track.hh"
+#include "G4Gamma.hh"
+#include "G4StateManager.hh"
+#include "G4AutoLock.hh"
+#include "G4SystemOfUnits.hh"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+
+G4bool ImportanceBiasing::enabled = false;
+G4bool ImportanceBiasing::piloting = false;
+
+namespace {
+    // Gap between a mesh and the box around it
+    constexpr G4double kMargin = 0.05 * mm;
+    // Largest importance ratio of neighbouring cells a pilot may set: larger steps split photons into many
+    // correlated copies
+    constexpr G4double kMaxStep = 4.0;
+
+    // Cell geometry and importances, written by the master between runs and read by all threads
+    G4int shells = 4;
+    G4double ratio = 2.0;
+    std::vector<G4double> importances; // per cell, [0] = 1 (outside)
+    G4int generation = 0; // incremented whenever the geometry or the importances change
+    G4ThreeVector centre;
+    std::vector<G4ThreeVector> halfExtents; // per box, from the outermost; cell k is box k - 1
+    std::vector<const G4VPhysicalVolume *> cellVolumes; // per cell, [0] = parallel world volume
+    std::string insectName;
+
+    thread_local G4int appliedGeneration = -1;
+
+    std::vector<G4double> GeometricImportances() {
+        std::vector<G4double> values(shells + 1, 1.0);
+        for (G4int k = 1; k <= shells; ++k) values[k] = values[k - 1] * ratio;
+        return values;
+    }
+
+    // A photon entering a cell (or a primary starting in one) with the insect dose of it and its progeny
+    struct Crossing {
+        G4int cell{0};
+        G4double weight{0.0};
+        G4double score{0.0};
+    };
+
+    struct PilotTable {
+        std::vector<Crossing> crossings; // of the current event
+        std::vector<std::size_t> chain; // crossings of the current track and its ancestors
+        std::unordered_map<const G4Track *, std::vector<std::size_t>> pending; // chains of untracked secondaries
+        std::vector<G4double> weight; // per cell, sum over the finished events of this thread
+        std::vector<G4double> score;
+
+        void Clear() {
+            crossings.clear();
+            chain.clear();
+            pending.clear();
+            weight.assign(cellVolumes.size(), 0.0);
+            score.assign(cellVolumes.size(), 0.0);
+        }
+    };
+
+    thread_local PilotTable pilotTable;
+
+    std::vector<G4double> mergedWeight;
+    std::vector<G4double> mergedScore;
+    G4Mutex mergeMutex = G4MUTEX_INITIALIZER;
+}
+
+ImportanceBiasing::ImportanceBiasing(DetectorConstruction *detector)
+    : detector(detector) {
+    importances = GeometricImportances();
+    messenger = new ImportanceMessenger(this);
+}
+
+ImportanceBiasing::~ImportanceBiasing() {
+    delete messenger;
+    delete sampler;
+}
+
+void ImportanceBiasing::Enable() {
+    if (enabled) return;
+    PhysicsList *physicsList = PhysicsList::GetInstance();
+    if (G4StateManager::GetStateManager()->GetCurrentState() != G4State_PreInit || !physicsList) {
+        G4cerr << "ImportanceBiasing: importance sampling can only be enabled before /run/initialize" << G4endl;
+        return;
+    }
+
+    // The sampler gets the parallel world volume once it is built (BuildCells)
+    sampler = new G4GeometrySampler(nullptr, "gamma");
+    sampler->SetParallel(true);
+    detector->RegisterParallelWorld(new ImportanceWorld(this));
+    physicsList->RegisterPhysics(new G4ImportanceBiasing(sampler, kWorldName));
+    physicsList->RegisterPhysics(new G4ParallelWorldPhysics(kWorldName));
+    enabled = true;
+    G4cout << "ImportanceBiasing: photon splitting and Russian roulette toward the insect enabled" << G4endl;
+}
+
+void ImportanceBiasing::SetShells(const G4int n) {
+    if (enabled && G4StateManager::GetStateManager()->GetCurrentState() != G4State_PreInit) {
+        G4cerr << "ImportanceBiasing: the number of boxes can only be changed before /run/initialize" << G4endl;
+        return;
+    }
+    shells = n;
+    importances = GeometricImportances();
+    ++generation;
+}
+
+void ImportanceBiasing::SetRatio(const G4double value) {
+    ratio = value;
+    importances = GeometricImportances();
+    ++generation;
+    if (!cellVolumes.empty()) PrintImportances("ratio " + std::to_string(ratio));
+}
+
+void ImportanceBiasing::SetImportances(const std::vector<G4double> &values) {
+    if (static_cast<G4int>(values.size()) != shells) {
+        G4cerr << "ImportanceBiasing: " << values.size() << " importances given for " << shells << " boxes" << G4endl;
+        return;
+    }
+    if (std::any_of(values.begin(), values.end(), [](const G4double value) { return !(value > 0.0); })) {
+        G4cerr << "ImportanceBiasing: importances must be positive" << G4endl;
+        return;
+    }
+    importances.assign(1, 1.0);
+    importances.insert(importances.end(), values.begin(), values.end());
+    ++generation;
+    if (!cellVolumes.empty()) PrintImportances("explicit values");
+}
+
+void ImportanceBiasing::BuildCells(G4VPhysicalVolume *ghostWorld) {
+    halfExtents.clear();
+    cellVolumes.assign(1, ghostWorld);
+    sampler->SetWorld(ghostWorld);
+    ++generation;
+
+    const std::vector<DetectorConstruction::MeshInfo> &meshes = detector->GetMeshes();
+    if (meshes.empty()) {
+        G4cerr << "ImportanceBiasing: no meshes, no importance cells" << G4endl;
+        return;
+    }
+    insectName = meshes.front().name;
+
+    // The innermost box encloses the insect, the outermost all meshes, both centred on the insect
+    G4ThreeVector insectMin, insectMax;
+    meshes.front().solid->BoundingLimits(insectMin, insectMax);
+    centre = 0.5 * (insectMin + insectMax);
+    const G4ThreeVector inner = 0.5 * (insectMax - insectMin) + G4ThreeVector(kMargin, kMargin, kMargin);
+    G4ThreeVector outer = inner;
+    for (const DetectorConstruction::MeshInfo &mesh: meshes) {
+        G4ThreeVector pMin, pMax;
+        mesh.solid->BoundingLimits(pMin, pMax);
+        for (int axis = 0; axis < 3; ++axis) {
+            outer[axis] = std::max({outer[axis], std::abs(pMin[axis] - centre[axis]) + kMargin,
+                                    std::abs(pMax[axis] - centre[axis]) + kMargin});
+        }
+    }
+
+    G4LogicalVolume *mother = ghostWorld->GetLogicalVolume();
+    for (G4int k = 1; k <= shells; ++k) {
+        const G4double fraction = shells > 1 ? static_cast<G4double>(k - 1) / (shells - 1) : 1.0;
+        const G4ThreeVector halfExtent = outer + fraction * (inner - outer);
+        const std::string name = "ImportanceCell_" + std::to_string(k);
+
+        // Geometry only: a parallel world needs no materials
+        auto *logical = new G4LogicalVolume(new G4Box(name, halfExtent.x(), halfExtent.y(), halfExtent.z()),
+                                            nullptr, name);
+        cellVolumes.push_back(new G4PVPlacement(nullptr, k == 1 ? centre : G4ThreeVector(), logical, name,
+                                                mother, false, 0, false));
+        halfExtents.push_back(halfExtent);
+        mother = logical;
+    }
+    PrintImportances("geometry");
+}
+
+void ImportanceBiasing::ApplyToThreadStore() {
+    if (cellVolumes.empty()) return;
+    // Thread-local store: every thread fills its own
+    G4IStore *store = G4IStore::GetInstance(kWorldName);
+    store->Clear();
+    store->SetParallelWorldVolume(kWorldName);
+    for (std::size_t k = 0; k < cellVolumes.size(); ++k) {
+        store->AddImportanceGeometryCell(importances[k], *cellVolumes[k], 0);
+    }
+    appliedGeneration = generation;
+}
+
+void ImportanceBiasing::BeginOfRun() {
+    if (enabled && appliedGeneration != generation) ApplyToThreadStore();
+    if (piloting) pilotTable.Clear();
+}
+
+G4int ImportanceBiasing::CellOf(const G4ThreeVector &position) {
+    const G4ThreeVector local = position - centre;
+    // Nested boxes: count from the outside until the first box that does not contain the point
+    G4int cell = 0;
+    for (const G4ThreeVector &halfExtent: halfExtents) {
+        if (std::abs(local.x()) > halfExtent.x() || std::abs(local.y()) > halfExtent.y() ||
+            std::abs(local.z()) > halfExtent.z()) {
+            break;
+        }
+        ++cell;
+    }
+    return cell;
+}
+
+void ImportanceBiasing::ProcessStep(const G4Step *step) {
+    PilotTable &table = pilotTable;
+    const G4Track *track = step->GetTrack();
+    const G4StepPoint *preStep = step->GetPreStepPoint();
+    const G4StepPoint *postStep = step->GetPostStepPoint();
+
+    // First step of a track: its chain was left by its parent, primaries start one in the cell of their vertex
+    if (track->GetCurrentStepNumber() == 1) {
+        table.chain.clear();
+        if (const auto it = table.pending.find(track); it != table.pending.end()) {
+            table.chain = std::move(it->second);
+            table.pending.erase(it);
+        } else if (track->GetParentID() == 0) {
+            table.chain.push_back(table.crossings.size());
+            table.crossings.push_back({CellOf(preStep->GetPosition()), preStep->GetWeight(), 0.0});
+        }
+    }
+
+    // The insect dose of this step counts for every crossing of the track and its ancestors
+    if (const G4double energyDep = step->GetTotalEnergyDeposit(); energyDep > 0.0) {
+        const G4VPhysicalVolume *volume = preStep->GetPhysicalVolume();
+        if (volume && volume->GetName() == insectName) {
+            for (const std::size_t index: table.chain) table.crossings[index].score += energyDep * preStep->GetWeight();
+        }
+    }
+
+    // A photon changing cells, with its weight before splitting or roulette: points on a boundary belong to the
+    // cell the photon moves into
+    if (track->GetDefinition() == G4Gamma::Gamma()) {
+        constexpr G4double nudge = 1 * nm;
+        const G4int from = CellOf(preStep->GetPosition() + nudge * preStep->GetMomentumDirection());
+        const G4int to = CellOf(postStep->GetPosition() + nudge * postStep->GetMomentumDirection());
+        if (to != from) {
+            table.chain.push_back(table.crossings.size());
+            table.crossings.push_back({to, preStep->GetWeight(), 0.0});
+        }
+    }
+
+    // Secondaries, including the copies of a split photon, inherit the chain
+    if (const auto *secondaries = step->GetSecondaryInCurrentStep()) {
+        for (const G4Track *secondary: *secondaries) table.pending[secondary] = table.chain;
+    }
+}
+
+void ImportanceBiasing::EndOfEvent() {
+    PilotTable &table = pilotTable;
+    if (table.weight.size() != cellVolumes.size()) table.Clear();
+    for (const Crossing &crossing: table.crossings) {
+        table.weight[crossing.cell] += crossing.weight;
+        table.score[crossing.cell] += crossing.score;
+    }
+    table.crossings.clear();
+    table.chain.clear();
+    table.pending.clear();
+}
+
+void ImportanceBiasing::MergeThreadTally() {
+    if (!piloting) return;
+    PilotTable &table = pilotTable;
+    G4AutoLock lock(&mergeMutex);
+    for (std::size_t k = 0; k < table.weight.size() && k < mergedWeight.size(); ++k) {
+        mergedWeight[k] += table.weight[k];
+        mergedScore[k] += table.score[k];
+    }
+    lock.unlock();
+    table.Clear();
+}
+
+void ImportanceBiasing::RunPilot(const G4int events) {
+    if (!enabled || cellVolumes.size() < 2) {
+        G4cerr << "ImportanceBiasing: enable importance sampling (/importance/enable) before the pilot"
+                << G4endl;
+        return;
+    }
+    mergedWeight.assign(cellVolumes.size(), 0.0);
+    mergedScore.assign(cellVolumes.size(), 0.0);
+
+    // The pilot writes its own output files and leaves the configured suffix as it was
+    G4cout << "ImportanceBiasing: pilot run of " << events << " events" << G4endl;
+    piloting = true;
+    const G4bool ran = ScopedRunSettings().BeamOn(events, "_pilot");
+    piloting = false;
+    if (!ran) {
+        G4cerr << "ImportanceBiasing: the pilot run failed, importances unchanged" << G4endl;
+        return;
+    }
+
+    // Importance = mean insect dose per unit weight entering the cell, relative to the source photons (cell 0).
+    // The pilot may itself be biased: weights and scores are both weighted, so the ratio stays unbiased.
+    const G4double reference = mergedWeight[0] > 0.0 ? mergedScore[0] / mergedWeight[0] : 0.0;
+    if (reference <= 0.0) {
+        G4cerr << "ImportanceBiasing: no insect dose in the pilot run, importances unchanged" << G4endl;
+        return;
+    }
+    std::vector<G4double> estimated(cellVolumes.size(), 1.0);
+    for (std::size_t k = 1; k < estimated.size(); ++k) {
+        const G4double previous = estimated[k - 1];
+        // No dose from this cell in the pilot: the default step
+        G4double value = previous * ratio;
+        if (mergedWeight[k] > 0.0 && mergedScore[k] > 0.0) value = mergedScore[k] / mergedWeight[k] / reference;
+        // Importance only grows toward the insect, and by a bounded step
+        estimated[k] = std::clamp(value, previous, previous * kMaxStep);
+    }
+    importances = estimated;
+    ++generation;
+    PrintImportances("pilot run of " + std::to_string(events) + " events");
+}
+
+void ImportanceBiasing::PrintImportances(const std::string &origin) {
+    G4cout << "\nImportance cells around '" << insectName << "' (" << origin << ")" << G4endl;
+    G4cout << std::setw(8) << "Cell" << std::setw(36) << "Half extent (mm)" << std::setw(14) << "Importance"
+            << G4endl;
+    std::ostringstream command;
+    command << "/importance/setImportances";
+    for (std::size_t k = 0; k < cellVolumes.size() && k < importances.size(); ++k) {
+        std::ostringstream extent;
+        if (k == 0) {
+            extent << "outside";
+        } else {
+            const G4ThreeVector &halfExtent = halfExtents[k - 1];
+            extent << halfExtent.x() / mm << " x " << halfExtent.y() / mm << " x " << halfExtent.z() / mm;
+            command << " " << importances[k];
+        }
+        G4cout << std::setw(8) << k << std::setw(36) << extent.str() << std::setw(14) << importances[k] << G4endl;
+    }
+    G4cout << "To reuse: " << command.str() << G4endl;
+}
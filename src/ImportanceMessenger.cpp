@@ -0,0 +1,99 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "ImportanceMessenger.h"
+#include "ImportanceBiasing.h"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithADouble.hh"
+#include "G4UIcmdWithAString.hh"
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+ImportanceMessenger::ImportanceMessenger(ImportanceBiasing *biasing)
+    : biasing(biasing) {
+    // Physics, geometry and importances are set up by the master: do not broadcast
+    importanceDir = new G4UIdirectory("/importance/", false);
+    importanceDir->SetGuidance("Geometry-importance splitting and Russian roulette of photons toward the insect");
+
+    enableCmd = new G4UIcmdWithABool("/importance/enable", this);
+    enableCmd->SetGuidance("Split photons entering boxes around the insect, roulette those leaving them");
+    enableCmd->SetGuidance("Before /run/initialize; cannot be switched off afterwards.");
+    enableCmd->SetParameterName("on", true);
+    enableCmd->SetDefaultValue(true);
+    enableCmd->AvailableForStates(G4State_PreInit);
+
+    shellsCmd = new G4UIcmdWithAnInteger("/importance/setShells", this);
+    shellsCmd->SetGuidance("Number of nested boxes between the insect and the outside of all meshes (default 4)");
+    shellsCmd->SetParameterName("n", false);
+    shellsCmd->SetRange("n>=1");
+    shellsCmd->AvailableForStates(G4State_PreInit);
+
+    ratioCmd = new G4UIcmdWithADouble("/importance/setRatio", this);
+    ratioCmd->SetGuidance("Importance ratio of neighbouring boxes, importances ratio^k (default 2)");
+    ratioCmd->SetParameterName("ratio", false);
+    ratioCmd->SetRange("ratio>=1");
+    ratioCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    importancesCmd = new G4UIcmdWithAString("/importance/setImportances", this);
+    importancesCmd->SetGuidance("Importances of the boxes from the outermost to the innermost (outside: 1)");
+    importancesCmd->SetParameterName("values", false);
+    importancesCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    pilotCmd = new G4UIcmdWithAnInteger("/importance/pilot", this);
+    pilotCmd->SetGuidance("Estimate the importances from a pilot run of n events");
+    pilotCmd->SetGuidance("Importance of a box: insect dose per unit photon weight entering it.");
+    pilotCmd->SetParameterName("n", false);
+    pilotCmd->SetRange("n>0");
+    pilotCmd->AvailableForStates(G4State_Idle);
+}
+
+ImportanceMessenger::~ImportanceMessenger() {
+    delete enableCmd;
+    delete shellsCmd;
+    delete ratioCmd;
+    delete importancesCmd;
+    delete pilotCmd;
+    delete importanceDir;
+}
+
+void ImportanceMessenger::SetNewValue(G4UIcommand *command, G4String newValue) {
+    if (command == enableCmd) {
+        if (G4UIcmdWithABool::GetNewBoolValue(newValue)) biasing->Enable();
+    } else if (command == shellsCmd) {
+        biasing->SetShells(G4UIcmdWithAnInteger::GetNewIntValue(newValue));
+    } else if (command == ratioCmd) {
+        biasing->SetRatio(G4UIcmdWithADouble::GetNewDoubleValue(newValue));
+    } else if (command == importancesCmd) {
+        std::istringstream is(newValue);
+        std::vector<G4double> values;
+        try {
+            for (std::string word; is >> word;) values.push_back(std::stod(word));
+        } catch (const std::exception &) {
+            G4cerr << "ImportanceMessenger: cannot read the importances '" << newValue << "'" << G4endl;
+            return;
+        }
+        biasing->SetImportances(values);
+    } else if (command == pilotCmd) {
+        biasing->RunPilot(G4UIcmdWithAnInteger::GetNewIntValue(newValue));
+    }
+}
@@ -0,0 +1,203 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "MemoryReport.h"
+#include "RunTelemetry.h"
+#include "G4Threading.hh"
+#include "G4RunManager.hh"
+#include "G4AutoLock.hh"
+#include "G4SolidStore.hh"
+#include "G4LogicalVolumeStore.hh"
+#include "G4PhysicalVolumeStore.hh"
+#include "G4TessellatedSolid.hh"
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+G4bool MemoryReport::active = false;
+
+namespace {
+    MemoryReport::Usage marks[MemoryReport::kMarks];
+    G4bool marked[MemoryReport::kMarks] = {};
+
+    // Physics tables are built once per initialisation, during /run/initialize
+    G4bool tablesPending = false;
+    G4double tablesBytes = -1.0;
+
+    MemoryReport::Usage runStart;
+
+    struct ThreadRecord {
+        G4int thread;
+        std::size_t userActionBytes;
+        std::size_t scoringBytes;
+    };
+
+    std::vector<ThreadRecord> threadRecords; // of the current run
+    G4Mutex recordMutex = G4MUTEX_INITIALIZER;
+
+    // Memory of one worker, measured from the tables mark (workers not started) to the start of the first run
+    G4bool workersPending = false;
+    G4int workersMeasured = 0;
+    MemoryReport::Usage perThread;
+
+    G4double MB(const G4double bytes) { return bytes / (1024.0 * 1024.0); }
+
+    // Heap growth if the heap is known, else growth of the resident memory
+    G4double Growth(const MemoryReport::Usage &from, const MemoryReport::Usage &to) {
+        return from.heap >= 0.0 && to.heap >= 0.0 ? to.heap - from.heap : to.resident - from.resident;
+    }
+
+    std::string Row(const std::string &label, const G4double first, const G4double second = -1.0) {
+        std::ostringstream row;
+        row << "  " << std::left << std::setw(58) << label << std::right << std::fixed << std::setprecision(1)
+                << std::setw(12) << MB(first);
+        if (second >= 0.0) row << std::setw(12) << MB(second);
+        return row.str();
+    }
+}
+
+MemoryReport::Usage MemoryReport::Current() {
+    Usage usage;
+    usage.resident = static_cast<G4double>(RunTelemetry::ResidentMemory());
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    // In use in all arenas plus mmap-ed blocks
+    const struct mallinfo2 info = mallinfo2();
+    usage.heap = static_cast<G4double>(info.uordblks + info.hblkhd);
+#endif
+    return usage;
+}
+
+void MemoryReport::Record(const Mark mark) {
+    if (!G4Threading::IsMasterThread()) return;
+    marks[mark] = Current();
+    marked[mark] = true;
+    if (mark == kProcessesEnd) tablesPending = true;
+    if (mark == kTablesEnd) {
+        if (tablesPending) tablesBytes = Growth(marks[kProcessesEnd], marks[kTablesEnd]);
+        tablesPending = false;
+        // Only the first initialisation starts workers; later table rebuilds reuse them
+        workersPending = workersMeasured == 0 && G4Threading::IsMultithreadedApplication();
+    }
+}
+
+void MemoryReport::BeginOfRun() {
+    runStart = Current();
+    {
+        G4AutoLock lock(&recordMutex);
+        threadRecords.clear();
+    }
+    if (workersPending) {
+        const G4int threads = G4RunManager::GetRunManager()->GetNumberOfThreads();
+        if (threads > 0) {
+            const Usage &tablesEnd = marks[kTablesEnd];
+            workersMeasured = threads;
+            perThread.heap = tablesEnd.heap >= 0.0 && runStart.heap >= 0.0
+                                 ? (runStart.heap - tablesEnd.heap) / threads
+                                 : -1.0;
+            perThread.resident = (runStart.resident - tablesEnd.resident) / threads;
+        }
+        workersPending = false;
+    }
+    if (!active) return;
+
+    std::size_t solids = 0, facets = 0;
+    for (const G4VSolid *solid: *G4SolidStore::GetInstance()) {
+        ++solids;
+        if (const auto *mesh = dynamic_cast<const G4TessellatedSolid *>(solid)) facets += mesh->GetNumberOfFacets();
+    }
+    std::ostringstream geometry;
+    geometry << "geometry and solids (" << solids << " solids, " << G4LogicalVolumeStore::GetInstance()->size()
+            << " logical volumes, " << facets << " facets)";
+
+    G4cout << "\n========================================" << G4endl;
+    G4cout << "Memory at the start of the run (MB)" << std::setw(37) << (runStart.heap >= 0.0 ? "heap" : "")
+            << std::setw(12) << "resident" << G4endl;
+    G4cout << Row("total", std::max(runStart.heap, 0.0), runStart.resident) << G4endl;
+    if (marked[kGeometryBegin] && marked[kGeometryEnd]) {
+        G4cout << Row(geometry.str(), Growth(marks[kGeometryBegin], marks[kGeometryEnd])) << G4endl;
+    }
+    if (marked[kGeometryEnd] && marked[kProcessesEnd]) {
+        G4cout << Row("physics list and processes", Growth(marks[kGeometryEnd], marks[kProcessesEnd])) << G4endl;
+    }
+    if (tablesBytes >= 0.0) G4cout << Row("physics tables (built or read from the cache)", tablesBytes) << G4endl;
+    if (workersMeasured > 0) {
+        G4cout << Row("worker threads (" + std::to_string(workersMeasured) + ", started by /run/initialize)",
+                      std::max(perThread.heap, 0.0) * workersMeasured, perThread.resident * workersMeasured)
+                << G4endl;
+    }
+    G4cout << "========================================\n" << G4endl;
+}
+
+void MemoryReport::RecordThread(const std::size_t userActionBytes, const std::size_t scoringBytes) {
+    G4AutoLock lock(&recordMutex);
+    threadRecords.push_back(ThreadRecord{G4Threading::G4GetThreadId(), userActionBytes, scoringBytes});
+}
+
+void MemoryReport::EndOfRun(const std::size_t sharedScoringBytes) {
+    const Usage runEnd = Current();
+    std::vector<ThreadRecord> records;
+    {
+        G4AutoLock lock(&recordMutex);
+        records = threadRecords;
+    }
+    std::sort(records.begin(), records.end(),
+              [](const ThreadRecord &a, const ThreadRecord &b) { return a.thread < b.thread; });
+
+    if (!active) return;
+
+    G4cout << "\n========================================" << G4endl;
+    G4cout << "Memory at the end of the run (MB)" << std::setw(39) << "user actions" << std::setw(12) << "scoring"
+            << G4endl;
+    std::size_t userActionTotal = 0, scoringTotal = 0;
+    for (const ThreadRecord &record: records) {
+        const std::string label = record.thread < 0 ? "thread (sequential)" : "thread " + std::to_string(record.thread);
+        G4cout << Row(label, static_cast<G4double>(record.userActionBytes), static_cast<G4double>(record.scoringBytes))
+                << G4endl;
+        userActionTotal += record.userActionBytes;
+        scoringTotal += record.scoringBytes;
+    }
+    if (records.size() > 1) {
+        G4cout << Row("all threads", static_cast<G4double>(userActionTotal), static_cast<G4double>(scoringTotal))
+                << G4endl;
+    }
+    G4cout << Row("shared dose maps", static_cast<G4double>(sharedScoringBytes)) << G4endl;
+    G4cout << Row("total heap / resident", std::max(runEnd.heap, 0.0), runEnd.resident) << G4endl;
+    if (workersMeasured > 0 && !records.empty()) {
+        // A worker at initialisation (physics, user actions, navigator, stack) plus its growth while processing
+        // events; the start-of-run memory already holds the initialised workers, so they are taken out of it
+        const G4double counted = static_cast<G4double>(userActionTotal + scoringTotal) / records.size();
+        const G4double eventGrowth = (runEnd.resident - runStart.resident) / workersMeasured;
+        const G4double shared = runStart.resident - workersMeasured * perThread.resident;
+        G4cout << "  One more thread: " << std::fixed << std::setprecision(1);
+        if (perThread.heap >= 0.0) G4cout << MB(perThread.heap) << " MB heap, ";
+        G4cout << MB(perThread.resident) << " MB resident when started by /run/initialize (measured over "
+                << workersMeasured << " workers)" << G4endl
+                << "  plus " << MB(eventGrowth) << " MB resident grown during this run; its user actions and scoring"
+                << " hold " << MB(counted) << " MB" << G4endl
+                << "  Memory for N threads: " << MB(shared) << " MB + N x " << MB(perThread.resident + eventGrowth)
+                << " MB resident" << std::defaultfloat << G4endl;
+    } else if (!G4Threading::IsMultithreadedApplication()) {
+        G4cout << "  Sequential run: no worker threads" << G4endl;
+    }
+    G4cout << "========================================\n" << G4endl;
+}
@@ -0,0 +1,63 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "PartitionMessenger.h"
+#include "PartitionedRun.h"
+#include "G4UIdirectory.hh"
+#include "G4UIcommand.hh"
+#include "G4UIparameter.hh"
+#include "G4UIcmdWithAString.hh"
+#include <sstream>
+
+PartitionMessenger::PartitionMessenger() {
+    // Seeding and partial results are handled by the master: do not broadcast these commands to the workers
+    partitionDir = new G4UIdirectory("/partition/", false);
+    partitionDir->SetGuidance("One logical run split over several processes");
+
+    selectCmd = new G4UIcommand("/partition/select", this);
+    selectCmd->SetGuidance("Make this process partition <index> of <count> (independent RNG stream, partial results)");
+    auto *indexParam = new G4UIparameter("index", 'i', false);
+    indexParam->SetParameterRange("index>=0");
+    selectCmd->SetParameter(indexParam);
+    auto *countParam = new G4UIparameter("count", 'i', false);
+    countParam->SetParameterRange("count>0");
+    selectCmd->SetParameter(countParam);
+    selectCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    partialPrefixCmd = new G4UIcmdWithAString("/partition/setPartialPrefix", this);
+    partialPrefixCmd->SetGuidance("Prefix (e.g. a directory) of the partial-result files (default: output prefix)");
+    partialPrefixCmd->SetParameterName("prefix", false);
+}
+
+PartitionMessenger::~PartitionMessenger() {
+    delete selectCmd;
+    delete partialPrefixCmd;
+    delete partitionDir;
+}
+
+void PartitionMessenger::SetNewValue(G4UIcommand *command, G4String newValue) {
+    if (command == selectCmd) {
+        std::istringstream is(newValue);
+        G4int index = 0, count = 1;
+        is >> index >> count;
+        PartitionedRun::Select(index, count);
+    } else if (command == partialPrefixCmd) {
+        PartitionedRun::SetPartialPrefix(newValue);
+    }
+}
@@ -0,0 +1,419 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "PartitionedRun.h"
+#include "PartitionMessenger.h"
+#include "RunAction.h"
+#include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+    constexpr char kMagic[8] = {'I', 'D', 'S', 'P', 'A', 'R', 'T', '1'};
+    constexpr std::uint32_t kVersion = 2;
+
+    struct FileHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::int32_t index;
+        std::int32_t count;
+        std::uint32_t nVolumes;
+        std::int64_t events;
+        double sourcePhotonsPerEvent;
+        double photonFlux;
+        double beamArea;
+        double cpuTime;
+        double wallTime;
+        char insect[32];
+        char preset[32];
+        char sampling[32];
+        double sectorStart;
+        double sectorRange;
+        std::uint32_t sectors;
+        std::uint32_t reserved;
+    };
+
+    // Followed by *replicas* replica sums and *sectors* (file header) sector sums
+    struct VolumeRecord {
+        char name[64];
+        double volume;
+        double density;
+        double sum;
+        double sumSquares;
+        std::uint32_t replicas;
+        std::uint32_t reserved;
+    };
+
+    template<std::size_t N>
+    void CopyName(char (&target)[N], const std::string &name) {
+        std::memset(target, 0, N);
+        std::memcpy(target, name.data(), std::min(name.size(), N - 1));
+    }
+}
+
+G4int PartitionedRun::index = 0;
+G4int PartitionedRun::count = 1;
+std::string PartitionedRun::partialPrefix;
+
+PartitionedRun::PartitionedRun() {
+    messenger = new PartitionMessenger();
+}
+
+PartitionedRun::~PartitionedRun() {
+    delete messenger;
+}
+
+void PartitionedRun::Select(const G4int partitionIndex, const G4int partitionCount) {
+    if (partitionCount < 1 || partitionIndex < 0 || partitionIndex >= partitionCount) {
+        G4cerr << "PartitionedRun: partition " << partitionIndex << " of " << partitionCount << " is invalid"
+                << G4endl;
+        return;
+    }
+    index = partitionIndex;
+    count = partitionCount;
+}
+
+void PartitionedRun::BeginOfRun() {
+    if (!IsActive()) return;
+    CLHEP::HepRandomEngine *engine = G4Random::getTheEngine();
+    // The same draws in every partition (same macro seeds), then a stream of its own per partition
+    const long seeds[4] = {
+        static_cast<long>(engine->flat() * 2147483647.0), static_cast<long>(engine->flat() * 2147483647.0),
+        static_cast<long>(index), static_cast<long>(count)
+    };
+    engine->setSeeds(seeds, 4);
+    G4cout << "PartitionedRun: partition " << index << " of " << count << G4endl;
+}
+
+G4bool PartitionedRun::WritePartial(const std::string &filename, const Partial &partial) {
+    if (const auto directory = std::filesystem::path(filename).parent_path(); !directory.empty()) {
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+    }
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        G4cerr << "PartitionedRun: cannot write '" << filename << "'" << G4endl;
+        return false;
+    }
+    FileHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.index = partial.index;
+    header.count = partial.count;
+    header.nVolumes = static_cast<std::uint32_t>(partial.volumes.size());
+    header.events = partial.events;
+    header.sourcePhotonsPerEvent = partial.sourcePhotonsPerEvent;
+    header.photonFlux = partial.photonFlux;
+    header.beamArea = partial.beamArea;
+    header.cpuTime = partial.cpuTime;
+    header.wallTime = partial.wallTime;
+    CopyName(header.insect, partial.insect);
+    CopyName(header.preset, partial.preset);
+    CopyName(header.sampling, partial.sampling);
+    header.sectorStart = partial.sectorStart;
+    header.sectorRange = partial.sectorRange;
+    header.sectors = static_cast<std::uint32_t>(partial.sectors);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    for (const VolumeAccumulator &volume: partial.volumes) {
+        VolumeRecord record{};
+        CopyName(record.name, volume.name);
+        record.volume = volume.volume;
+        record.density = volume.density;
+        record.sum = volume.sum;
+        record.sumSquares = volume.sumSquares;
+        record.replicas = static_cast<std::uint32_t>(volume.replicaSums.size());
+        out.write(reinterpret_cast<const char *>(&record), sizeof(record));
+        out.write(reinterpret_cast<const char *>(volume.replicaSums.data()),
+                  static_cast<std::streamsize>(volume.replicaSums.size() * sizeof(double)));
+        std::vector<double> sectorSums(volume.sectorSums);
+        sectorSums.resize(header.sectors, 0.0);
+        out.write(reinterpret_cast<const char *>(sectorSums.data()),
+                  static_cast<std::streamsize>(sectorSums.size() * sizeof(double)));
+    }
+    if (!out) {
+        G4cerr << "PartitionedRun: cannot write '" << filename << "'" << G4endl;
+        return false;
+    }
+    G4cout << "PartitionedRun: partial result written to '" << filename << "'" << G4endl;
+    return true;
+}
+
+G4bool PartitionedRun::ReadPartial(const std::string &filename, Partial &partial) {
+    std::ifstream in(filename, std::ios::binary);
+    FileHeader header{};
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) {
+        G4cerr << "PartitionedRun: '" << filename << "' is not a partial-result file of this version" << G4endl;
+        return false;
+    }
+    partial = Partial{};
+    partial.insect = std::string(header.insect, strnlen(header.insect, sizeof(header.insect)));
+    partial.index = header.index;
+    partial.count = header.count;
+    partial.events = header.events;
+    partial.sourcePhotonsPerEvent = header.sourcePhotonsPerEvent;
+    partial.photonFlux = header.photonFlux;
+    partial.beamArea = header.beamArea;
+    partial.cpuTime = header.cpuTime;
+    partial.wallTime = header.wallTime;
+    partial.preset = std::string(header.preset, strnlen(header.preset, sizeof(header.preset)));
+    partial.sampling = std::string(header.sampling, strnlen(header.sampling, sizeof(header.sampling)));
+    partial.sectors = static_cast<G4int>(header.sectors);
+    partial.sectorStart = header.sectorStart;
+    partial.sectorRange = header.sectorRange;
+    for (std::uint32_t v = 0; v < header.nVolumes; ++v) {
+        VolumeRecord record{};
+        if (!in.read(reinterpret_cast<char *>(&record), sizeof(record))) break;
+        VolumeAccumulator volume;
+        volume.name = std::string(record.name, strnlen(record.name, sizeof(record.name)));
+        volume.volume = record.volume;
+        volume.density = record.density;
+        volume.sum = record.sum;
+        volume.sumSquares = record.sumSquares;
+        volume.replicaSums.resize(record.replicas);
+        in.read(reinterpret_cast<char *>(volume.replicaSums.data()),
+                static_cast<std::streamsize>(record.replicas * sizeof(double)));
+        volume.sectorSums.resize(header.sectors);
+        in.read(reinterpret_cast<char *>(volume.sectorSums.data()),
+                static_cast<std::streamsize>(header.sectors * sizeof(double)));
+        partial.volumes.push_back(volume);
+    }
+    if (!in) {
+        G4cerr << "PartitionedRun: '" << filename << "' is truncated" << G4endl;
+        return false;
+    }
+    return true;
+}
+
+int PartitionedRun::Merge(const std::vector<std::string> &files, const std::string &output) {
+    std::vector<Partial> partials;
+    std::set<G4int> indices;
+    for (const std::string &file: files) {
+        Partial partial;
+        if (!ReadPartial(file, partial)) return 1;
+        if (!partials.empty() && (partial.insect != partials.front().insect ||
+                                  partial.count != partials.front().count)) {
+            G4cerr << "PartitionedRun: '" << file << "' belongs to a different run" << G4endl;
+            return 1;
+        }
+        // The partitions of one logical run share the macro, so their settings are bit-identical
+        if (!partials.empty()) {
+            const Partial &first = partials.front();
+            if (partial.sourcePhotonsPerEvent != first.sourcePhotonsPerEvent ||
+                partial.photonFlux != first.photonFlux || partial.beamArea != first.beamArea ||
+                partial.preset != first.preset || partial.sampling != first.sampling ||
+                partial.sectors != first.sectors || partial.sectorStart != first.sectorStart ||
+                partial.sectorRange != first.sectorRange) {
+                G4cerr << "PartitionedRun: '" << file << "' was run with other source, physics or scan settings"
+                        << G4endl;
+                return 1;
+            }
+        }
+        if (!indices.insert(partial.index).second) {
+            G4cerr << "PartitionedRun: partition " << partial.index << " is given twice" << G4endl;
+            return 1;
+        }
+        partials.push_back(partial);
+    }
+    if (partials.empty()) {
+        G4cerr << "PartitionedRun: no partial results to merge" << G4endl;
+        return 1;
+    }
+    if (static_cast<G4int>(partials.size()) != partials.front().count) {
+        G4cout << "PartitionedRun: merging " << partials.size() << " of " << partials.front().count
+                << " partitions" << G4endl;
+    }
+
+    // Accumulators add exactly; quasi-random replicas of different partitions are independent replicas
+    G4long events = 0;
+    G4double sourcePhotons = 0.0, cpuTime = 0.0, wallTime = 0.0;
+    std::map<std::string, VolumeAccumulator> volumes;
+    std::map<std::string, std::vector<G4double> > replicaMeans;
+    for (const Partial &partial: partials) {
+        events += partial.events;
+        sourcePhotons += static_cast<G4double>(partial.events) * partial.sourcePhotonsPerEvent;
+        cpuTime += partial.cpuTime;
+        wallTime = std::max(wallTime, partial.wallTime);
+        for (const VolumeAccumulator &volume: partial.volumes) {
+            VolumeAccumulator &merged = volumes[volume.name];
+            merged.name = volume.name;
+            merged.volume = volume.volume;
+            merged.density = volume.density;
+            merged.sum += volume.sum;
+            merged.sumSquares += volume.sumSquares;
+            merged.sectorSums.resize(volume.sectorSums.size(), 0.0);
+            for (std::size_t i = 0; i < volume.sectorSums.size(); ++i) merged.sectorSums[i] += volume.sectorSums[i];
+            if (volume.replicaSums.size() > 1) {
+                const std::vector<G4double> means = RunAction::ReplicaMeans(volume.replicaSums, partial.events);
+                replicaMeans[volume.name].insert(replicaMeans[volume.name].end(), means.begin(), means.end());
+            }
+        }
+    }
+    if (events == 0) {
+        G4cerr << "PartitionedRun: the partial results hold no events" << G4endl;
+        return 1;
+    }
+
+    std::ofstream out(output);
+    if (!out) {
+        G4cerr << "PartitionedRun: cannot write '" << output << "'" << G4endl;
+        return 1;
+    }
+    const Partial &first = partials.front();
+    out << "Merged partitions: " << partials.size() << " of " << first.count << "\n";
+    out << "Number of events: " << events << "\n";
+    if (sourcePhotons != static_cast<G4double>(events)) out << "Source photons: " << sourcePhotons << "\n";
+    out << "Photon flux: " << first.photonFlux << " photons/s/mm2\n";
+    out << "Physics preset: " << first.preset << "\n";
+    out << "Source sampling: " << first.sampling << "\n";
+    out << "CPU time: " << cpuTime << " s\n";
+    out << "Wall time (longest partition): " << wallTime << " s\n";
+    out << "========================================\n";
+    out << std::setw(20) << "Volume Name"
+            << std::setw(15) << "Volume (mm3)"
+            << std::setw(15) << "Density (g/cm3)"
+            << std::setw(20) << "Energy Dep (MeV)"
+            << std::setw(20) << "Dose (Gy)"
+            << std::setw(20) << "Dose per photon (Gy)"
+            << std::setw(20) << "Dose rate (Gy/s) with 100mA"
+            << std::setw(15) << "Rel. error"
+            << "\n";
+    out << "========================================\n";
+    const G4double photonsPerSecond = first.photonFlux * first.beamArea;
+    for (const auto &[name, volume]: volumes) {
+        const G4double mass = volume.volume * volume.density;
+        const G4double dose = mass > 0.0 ? volume.sum * 1.602e-10 / mass : 0.0; // MeV/g -> Gy
+        const G4double dosePerEvent = dose / sourcePhotons;
+        const G4double relError = RunAction::RelativeError(volume.sum, volume.sumSquares, events, replicaMeans[name]);
+        out << std::setw(20) << name
+                << std::setw(15) << volume.volume
+                << std::setw(15) << volume.density * 1e3
+                << std::setw(20) << volume.sum
+                << std::setw(20) << dose
+                << std::setw(20) << dosePerEvent
+                << std::setw(20) << dosePerEvent * photonsPerSecond
+                << std::setw(15) << relError
+                << "\n";
+    }
+    out << "========================================\n";
+
+    // Tomographic scan: contribution of each angular sector to the dose per source photon, as in RunAction
+    if (first.sectors > 0) {
+        out << "Dose per source photon (Gy) by angular sector of the scan\n";
+        out << std::setw(20) << "Volume Name";
+        for (G4int i = 0; i < first.sectors; ++i) {
+            std::ostringstream sector;
+            sector << (first.sectorStart + first.sectorRange * i / first.sectors) / deg << "-"
+                    << (first.sectorStart + first.sectorRange * (i + 1) / first.sectors) / deg << " deg";
+            out << std::setw(20) << sector.str();
+        }
+        out << "\n";
+        for (const auto &[name, volume]: volumes) {
+            const G4double mass = volume.volume * volume.density;
+            out << std::setw(20) << name;
+            for (const G4double deposit: volume.sectorSums) {
+                out << std::setw(20) << (mass > 0.0 ? deposit * 1.602e-10 / mass / sourcePhotons : 0.0);
+            }
+            out << "\n";
+        }
+        out << "========================================\n";
+    }
+    G4cout << "PartitionedRun: merged " << partials.size() << " partial results (" << events << " events) into '"
+            << output << "'" << G4endl;
+    return 0;
+}
+
+int PartitionedRun::RunPartitions(const std::string &executable, const std::string &macro, const G4int n) {
+    const std::filesystem::path directory = "partitions";
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    for (const auto &entry: std::filesystem::directory_iterator(directory, error)) {
+        if (entry.path().string().find(".part") != std::string::npos) std::filesystem::remove(entry.path(), error);
+    }
+
+    // Share the cores out between the partitions
+    const unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    const std::string threads = std::to_string(std::max(1u, cores / static_cast<unsigned>(n)));
+
+    std::fflush(nullptr); // the children must not repeat buffered output
+    std::vector<pid_t> children;
+    for (G4int i = 0; i < n; ++i) {
+        const std::string partition = std::to_string(i), partitions = std::to_string(n);
+        const std::string suffix = "_part" + partition, prefix = directory.string() + "/";
+        const std::string log = "partition_" + partition + ".log";
+        const pid_t pid = fork();
+        if (pid == 0) {
+            setenv("G4FORCENUMBEROFTHREADS", threads.c_str(), 1);
+            if (!std::freopen(log.c_str(), "w", stdout) || !std::freopen(log.c_str(), "a", stderr)) _exit(127);
+            execl(executable.c_str(), executable.c_str(), "--partition", partition.c_str(), partitions.c_str(),
+                  "--partial-prefix", prefix.c_str(), "--suffix", suffix.c_str(), macro.c_str(),
+                  static_cast<char *>(nullptr));
+            _exit(127);
+        }
+        if (pid < 0) {
+            G4cerr << "Cannot start partition " << i << G4endl;
+            break;
+        }
+        children.push_back(pid);
+    }
+
+    G4bool ok = static_cast<G4int>(children.size()) == n;
+    for (std::size_t i = 0; i < children.size(); ++i) {
+        int status = 0;
+        waitpid(children[i], &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            G4cerr << "Partition " << i << " failed, see partition_" << i << ".log" << G4endl;
+            ok = false;
+        }
+    }
+    if (!ok) return 1;
+
+    // One logical run per partial name without its .part<i>of<n> ending
+    std::map<std::string, std::vector<std::string> > runs;
+    for (const auto &entry: std::filesystem::directory_iterator(directory, error)) {
+        const std::string name = entry.path().filename().string();
+        if (const auto part = name.rfind(".part"); part != std::string::npos) {
+            runs[name.substr(0, part)].push_back(entry.path().string());
+        }
+    }
+    if (runs.empty()) {
+        G4cerr << "No partial results written (does the macro call /run/beamOn?)" << G4endl;
+        return 1;
+    }
+    int result = 0;
+    for (auto &[run, files]: runs) {
+        std::sort(files.begin(), files.end());
+        result |= Merge(files, run + "_merged.txt");
+    }
+    return result;
+}
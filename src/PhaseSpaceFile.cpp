@@ -0,0 +1,214 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "PhaseSpaceFile.h"
+#include "G4AutoLock.hh"
+#include "G4SystemOfUnits.hh"
+#include "parameters.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    constexpr char kMagic[8] = {'I', 'D', 'S', 'P', 'H', 'S', 'P', '1'};
+    constexpr std::uint32_t kVersion = 1;
+
+    G4Mutex openMutex = G4MUTEX_INITIALIZER;
+    std::shared_ptr<const PhaseSpaceFile> lastOpened;
+}
+
+PhaseSpaceFile::~PhaseSpaceFile() {
+    if (mapping) munmap(mapping, mappingSize);
+}
+
+PhaseSpaceFile::Header PhaseSpaceFile::MakeHeader(const G4double planeZ) {
+    Header h{};
+    std::memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.recordSize = sizeof(Record);
+    h.planeZ = planeZ / mm;
+    return h;
+}
+
+std::shared_ptr<const PhaseSpaceFile> PhaseSpaceFile::Open(const std::string &filename) {
+    G4AutoLock lock(&openMutex);
+    if (lastOpened && lastOpened->filename == filename) return lastOpened;
+
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        G4cerr << "PhaseSpaceFile: cannot open '" << filename << "'" << G4endl;
+        return nullptr;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || static_cast<std::size_t>(st.st_size) < sizeof(Header)) {
+        G4cerr << "PhaseSpaceFile: '" << filename << "' is too short for a phase-space file" << G4endl;
+        close(fd);
+        return nullptr;
+    }
+
+    void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (mapping == MAP_FAILED) {
+        G4cerr << "PhaseSpaceFile: cannot map '" << filename << "'" << G4endl;
+        return nullptr;
+    }
+
+    std::shared_ptr<PhaseSpaceFile> file(new PhaseSpaceFile());
+    file->filename = filename;
+    file->mapping = mapping;
+    file->mappingSize = st.st_size;
+    file->header = static_cast<const Header *>(mapping);
+    file->records = reinterpret_cast<const Record *>(static_cast<const char *>(mapping) + sizeof(Header));
+
+    const Header &h = *file->header;
+    if (std::memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion || h.recordSize != sizeof(Record)) {
+        G4cerr << "PhaseSpaceFile: '" << filename << "' is not a phase-space file of this version" << G4endl;
+        return nullptr;
+    }
+    if (sizeof(Header) + h.nRecords * sizeof(Record) > file->mappingSize || h.nHistories == 0) {
+        G4cerr << "PhaseSpaceFile: '" << filename << "' is truncated or empty" << G4endl;
+        return nullptr;
+    }
+    // Records are read in order, histories are replayed once per event
+    madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+
+    G4cout << "PhaseSpaceFile: mapped '" << filename << "' (" << h.nRecords << " records, " << h.nHistories
+            << " histories from " << h.sourceEvents << " source events, plane at z = " << h.planeZ << " mm)"
+            << G4endl;
+    lastOpened = file;
+    return file;
+}
+
+const std::vector<std::uint64_t> &PhaseSpaceFile::GetHistoryStarts() const {
+    if (historyStartsBuilt.load(std::memory_order_acquire)) return historyStarts;
+
+    // One index per file, not per thread: with many threads a per-thread copy would outgrow the mapping itself
+    G4AutoLock lock(&openMutex);
+    if (!historyStartsBuilt.load(std::memory_order_relaxed)) {
+        if (header->nHistories != header->nRecords) {
+            historyStarts.reserve(header->nHistories);
+            for (std::uint64_t i = 0; i < header->nRecords; ++i) {
+                if (records[i].flags & kHistoryStart) historyStarts.push_back(i);
+            }
+            if (historyStarts.empty()) historyStarts.push_back(0);
+        }
+        historyStartsBuilt.store(true, std::memory_order_release);
+    }
+    return historyStarts;
+}
+
+bool PhaseSpaceFile::ConvertRayFile(const std::string &textFile, const std::string &outputFile) {
+    std::ifstream in(textFile);
+    if (!in) {
+        G4cerr << "PhaseSpaceFile: cannot open ray file '" << textFile << "'" << G4endl;
+        return false;
+    }
+    std::ofstream out(outputFile, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        G4cerr << "PhaseSpaceFile: cannot write '" << outputFile << "'" << G4endl;
+        return false;
+    }
+    Header h = MakeHeader(beamStartZ);
+    out.write(reinterpret_cast<const char *>(&h), sizeof(h)); // completed below
+
+    // Rays are streamed through a small buffer, the text file may be larger than the memory
+    std::vector<Record> buffer;
+    buffer.reserve(65536);
+    G4double weightSum = 0.0;
+    std::uint64_t skipped = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (const auto hash = line.find('#'); hash != std::string::npos) line.erase(hash);
+        std::istringstream fields(line);
+        G4double x, y, dx, dy, dz, energy, weight = 1.0;
+        if (!(fields >> x >> y >> dx >> dy >> dz >> energy)) {
+            if (line.find_first_not_of(" \t\r") != std::string::npos) ++skipped;
+            continue;
+        }
+        fields >> weight;
+        const G4double norm = std::sqrt(dx * dx + dy * dy + dz * dz);
+        if (dz <= 0.0 || energy <= 0.0 || weight <= 0.0) {
+            ++skipped;
+            continue;
+        }
+
+        // (x, y, z) -> (x, -y, -z)
+        Record record{};
+        record.x = static_cast<float>(x);
+        record.y = static_cast<float>(-y);
+        record.u = static_cast<float>(dx / norm);
+        record.v = static_cast<float>(-dy / norm);
+        record.energy = static_cast<float>(energy * eV / MeV);
+        record.weight = static_cast<float>(weight);
+        record.pdg = 22;
+        record.flags = kHistoryStart;
+        buffer.push_back(record);
+        weightSum += weight;
+        h.maxEnergy = std::max(h.maxEnergy, static_cast<double>(record.energy));
+
+        if (buffer.size() == buffer.capacity()) {
+            out.write(reinterpret_cast<const char *>(buffer.data()), buffer.size() * sizeof(Record));
+            h.nRecords += buffer.size();
+            buffer.clear();
+        }
+    }
+    out.write(reinterpret_cast<const char *>(buffer.data()), buffer.size() * sizeof(Record));
+    h.nRecords += buffer.size();
+    h.nHistories = h.nRecords;
+    h.sourceEvents = h.nRecords;
+    out.seekp(0);
+    out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    out.close();
+    if (skipped > 0) {
+        G4cout << "PhaseSpaceFile: skipped " << skipped << " unreadable rays or rays not travelling along +z"
+                << G4endl;
+    }
+    if (!out || h.nRecords == 0) {
+        G4cerr << "PhaseSpaceFile: no rays converted from '" << textFile << "'" << G4endl;
+        return false;
+    }
+
+    // Rescale the weights in place to a mean of 1
+    if (const G4double scale = static_cast<G4double>(h.nRecords) / weightSum; std::abs(scale - 1.0) > 1e-12) {
+        const int fd = open(outputFile.c_str(), O_RDWR);
+        const std::size_t size = sizeof(Header) + h.nRecords * sizeof(Record);
+        void *mapping = fd < 0 ? MAP_FAILED : mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (fd >= 0) close(fd);
+        if (mapping == MAP_FAILED) {
+            G4cerr << "PhaseSpaceFile: cannot rescale the weights in '" << outputFile << "'" << G4endl;
+            return false;
+        }
+        auto *records = reinterpret_cast<Record *>(static_cast<char *>(mapping) + sizeof(Header));
+        for (std::uint64_t i = 0; i < h.nRecords; ++i) {
+            records[i].weight = static_cast<float>(records[i].weight * scale);
+        }
+        munmap(mapping, size);
+    }
+
+    G4cout << "PhaseSpaceFile: converted " << h.nRecords << " rays (up to " << h.maxEnergy * MeV / keV
+            << " keV) from '" << textFile << "' to '" << outputFile << "'" << G4endl;
+    return true;
+}
@@ -0,0 +1,57 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "PhaseSpaceMessenger.h"
+#include "PhaseSpaceRecorder.h"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithADoubleAndUnit.hh"
+
+PhaseSpaceMessenger::PhaseSpaceMessenger() {
+    // The recorder state is shared by all threads and set up by the master: do not broadcast
+    phaseSpaceDir = new G4UIdirectory("/phasespace/", false);
+    phaseSpaceDir->SetGuidance("Phase-space recording upstream of the sample");
+
+    recordCmd = new G4UIcmdWithAString("/phasespace/record", this);
+    recordCmd->SetGuidance("Record the particles crossing the phase-space plane in the next runs to this file");
+    recordCmd->SetGuidance("Particles are stopped at the plane. Without a filename recording is switched off.");
+    recordCmd->SetParameterName("filename", true);
+    recordCmd->SetDefaultValue("");
+    recordCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    planeZCmd = new G4UIcmdWithADoubleAndUnit("/phasespace/setPlaneZ", this);
+    planeZCmd->SetGuidance("z of the phase-space plane (default: 10 um above the highest mesh)");
+    planeZCmd->SetParameterName("z", false);
+    planeZCmd->SetDefaultUnit("mm");
+    planeZCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+PhaseSpaceMessenger::~PhaseSpaceMessenger() {
+    delete recordCmd;
+    delete planeZCmd;
+    delete phaseSpaceDir;
+}
+
+void PhaseSpaceMessenger::SetNewValue(G4UIcommand *command, G4String newValue) {
+    if (command == recordCmd) {
+        PhaseSpaceRecorder::SetOutputFile(newValue);
+    } else if (command == planeZCmd) {
+        PhaseSpaceRecorder::SetPlaneZ(G4UIcmdWithADoubleAndUnit::GetNewDoubleValue(newValue));
+    }
+}
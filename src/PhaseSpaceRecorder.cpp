@@ -0,0 +1,171 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "PhaseSpaceRecorder.h"
+#include "PhaseSpaceFile.h"
+#include "PhaseSpaceMessenger.h"
+#include "PrimaryGeneratorAction.h"
+#include "DetectorConstruction.h"
+#include "parameters.h"
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4TessellatedSolid.hh"
+#include "G4RunManager.hh"
+#include "G4AutoLock.hh"
+#include "G4SystemOfUnits.hh"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <fstream>
+#include <vector>
+
+std::string PhaseSpaceRecorder::outputFile;
+G4double PhaseSpaceRecorder::planeZ = 0.0;
+G4bool PhaseSpaceRecorder::autoPlane = true;
+G4bool PhaseSpaceRecorder::recording = false;
+
+namespace {
+    // Flush threshold of the per-thread buffer (records)
+    constexpr std::size_t kBufferRecords = 32768;
+
+    thread_local std::vector<PhaseSpaceFile::Record> buffer;
+    thread_local G4bool eventHasRecord = false;
+    thread_local std::uint64_t threadHistories = 0;
+    thread_local G4double threadMaxEnergy = 0.0;
+
+    G4Mutex writeMutex = G4MUTEX_INITIALIZER;
+    std::ofstream file;
+    PhaseSpaceFile::Header header;
+
+    // Appends the buffer of the calling thread to the file
+    void Flush() {
+        G4AutoLock lock(&writeMutex);
+        if (file.is_open() && !buffer.empty()) {
+            file.write(reinterpret_cast<const char *>(buffer.data()),
+                       static_cast<std::streamsize>(buffer.size() * sizeof(PhaseSpaceFile::Record)));
+            header.nRecords += buffer.size();
+        }
+        header.nHistories += threadHistories;
+        header.maxEnergy = std::max(header.maxEnergy, threadMaxEnergy / MeV);
+        buffer.clear();
+        threadHistories = 0;
+    }
+}
+
+PhaseSpaceRecorder::PhaseSpaceRecorder() {
+    messenger = new PhaseSpaceMessenger();
+}
+
+PhaseSpaceRecorder::~PhaseSpaceRecorder() {
+    delete messenger;
+}
+
+void PhaseSpaceRecorder::BeginOfRun() {
+    recording = false;
+    if (outputFile.empty()) return;
+
+    if (autoPlane) {
+        // Just above the highest mesh (the tube), below the source
+        G4double top = -DBL_MAX;
+        if (const auto *detector = dynamic_cast<const DetectorConstruction *>(
+            G4RunManager::GetRunManager()->GetUserDetectorConstruction())) {
+            for (const auto &mesh: detector->GetMeshes()) {
+                G4ThreeVector pMin, pMax;
+                mesh.solid->BoundingLimits(pMin, pMax);
+                top = std::max(top, pMax.z());
+            }
+        }
+        if (top == -DBL_MAX) {
+            G4cerr << "PhaseSpaceRecorder: no meshes to place the plane above - not recording" << G4endl;
+            return;
+        }
+        planeZ = top + 10 * um;
+    }
+    if (planeZ >= beamStartZ) {
+        G4cerr << "PhaseSpaceRecorder: plane (z = " << planeZ / mm << " mm) is not below the source - not recording"
+                << G4endl;
+        return;
+    }
+
+    file.open(outputFile, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        G4cerr << "PhaseSpaceRecorder: cannot write '" << outputFile << "'" << G4endl;
+        return;
+    }
+    header = PhaseSpaceFile::MakeHeader(planeZ);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header)); // completed at the end of the run
+
+    recording = true;
+    G4cout << "PhaseSpaceRecorder: recording to '" << outputFile << "' at z = " << planeZ / mm << " mm" << G4endl;
+}
+
+void PhaseSpaceRecorder::ProcessStep(const G4Step *step) {
+    const G4StepPoint *preStep = step->GetPreStepPoint();
+    const G4StepPoint *postStep = step->GetPostStepPoint();
+    const G4double z0 = preStep->GetPosition().z();
+    const G4double z1 = postStep->GetPosition().z();
+    if (!(z0 > planeZ && z1 <= planeZ)) return;
+
+    // Crossing point on the straight step; energy and direction as the step started
+    const G4double f = (z0 - planeZ) / (z0 - z1);
+    const G4ThreeVector position = preStep->GetPosition() + f * (postStep->GetPosition() - preStep->GetPosition());
+    const G4ThreeVector &direction = preStep->GetMomentumDirection();
+    G4Track *track = step->GetTrack();
+
+    PhaseSpaceFile::Record record{};
+    record.x = static_cast<float>(position.x() / mm);
+    record.y = static_cast<float>(position.y() / mm);
+    record.u = static_cast<float>(direction.x());
+    record.v = static_cast<float>(direction.y());
+    record.energy = static_cast<float>(preStep->GetKineticEnergy() / MeV);
+    record.weight = static_cast<float>(preStep->GetWeight());
+    record.pdg = track->GetDefinition()->GetPDGEncoding();
+    record.flags = eventHasRecord ? 0 : PhaseSpaceFile::kHistoryStart;
+    buffer.push_back(record);
+
+    if (!eventHasRecord) ++threadHistories;
+    eventHasRecord = true;
+    threadMaxEnergy = std::max(threadMaxEnergy, preStep->GetKineticEnergy());
+
+    // The replay continues from here
+    track->SetTrackStatus(fStopAndKill);
+}
+
+void PhaseSpaceRecorder::EndOfEvent() {
+    eventHasRecord = false;
+    if (buffer.size() >= kBufferRecords) Flush();
+}
+
+void PhaseSpaceRecorder::EndOfRun(const G4bool master, const G4int nEvents) {
+    Flush();
+    if (!master) return;
+
+    G4AutoLock lock(&writeMutex);
+    if (!file.is_open()) return;
+    // Source photons, as one event may hold several (/generator/photonsPerEvent)
+    header.sourceEvents = static_cast<std::uint64_t>(
+        std::llround(nEvents * PrimaryGeneratorAction::GetSourcePhotonsPerEvent()));
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.close();
+    recording = false;
+
+    G4cout << "PhaseSpaceRecorder: wrote " << header.nRecords << " records of " << header.nHistories
+            << " histories (" << header.sourceEvents << " source photons) to '" << outputFile << "'" << G4endl;
+}
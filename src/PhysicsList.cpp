@@ -18,32 +18,138 @@
  */
 
 #include "PhysicsList.h"
+#include "PhysicsMessenger.h"
+#include "FastEmPhysics.h"
+#include "MemoryReport.h"
+#include "DetectorConstruction.h"
 #include "G4EmStandardPhysics_option4.hh"
+#include "G4EmLivermorePhysics.hh"
 #include "G4EmPenelopePhysics.hh"
-#include "G4DecayPhysics.hh"
 #include "G4SystemOfUnits.hh"
 #include "G4EmParameters.hh"
+#include "G4ProductionCutsTable.hh"
+#include "G4ProductionCuts.hh"
+#include "G4Region.hh"
+#include "G4RegionStore.hh"
+#include "G4Material.hh"
+#include "G4RunManager.hh"
+#include "G4StateManager.hh"
+#include "G4Version.hh"
+#include "G4UnitsTable.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+PhysicsList *PhysicsList::instance = nullptr;
 
 PhysicsList::PhysicsList() {
     SetVerboseLevel(1);
+    instance = this;
 
-    // Penelope physics for accurate low-energy photon interactions
+    // Penelope physics for accurate low-energy photon interactions (reference preset). No decay physics: nothing
+    // in a keV photon beam decays.
     RegisterPhysics(new G4EmPenelopePhysics());
+    ApplyEmParameters();
+
+    messenger = new PhysicsMessenger(this);
+}
+
+G4bool PhysicsList::SelectPreset(const std::string &name) {
+    if (G4StateManager::GetStateManager()->GetCurrentState() != G4State_PreInit) {
+        G4cerr << "PhysicsList: presets can only be selected before /run/initialize" << G4endl;
+        return false;
+    }
+
+    G4VPhysicsConstructor *em = nullptr;
+    if (name == "penelope") em = new G4EmPenelopePhysics();
+    else if (name == "livermore") em = new G4EmLivermorePhysics();
+    else if (name == "option4") em = new G4EmStandardPhysics_option4();
+    else if (name == "fast") em = new FastEmPhysics();
+    else {
+        G4cerr << "PhysicsList: unknown preset '" << name << "' - allowed: penelope, livermore, option4, fast" << G4endl;
+        return false;
+    }
 
-    // Decay physics
-    RegisterPhysics(new G4DecayPhysics());
+    // Replaces the registered electromagnetic constructor (same physics type)
+    ReplacePhysics(em);
+    preset = name;
+    ApplyEmParameters();
+    G4cout << "PhysicsList: selected preset '" << preset << "'" << G4endl;
+    return true;
+}
+
+void PhysicsList::SetFluorescence(const G4bool enable) {
+    fluorescence = enable ? 1 : 0;
+    ApplyEmParameters();
+    if (G4RunManager *runManager = G4RunManager::GetRunManager()) runManager->PhysicsHasBeenModified();
+    UpdateTableCache();
+}
+
+void PhysicsList::SetAuger(const G4bool enable) {
+    auger = enable ? 1 : 0;
+    ApplyEmParameters();
+    if (G4RunManager *runManager = G4RunManager::GetRunManager()) runManager->PhysicsHasBeenModified();
+    UpdateTableCache();
+}
+
+void PhysicsList::SetWoodcock(const G4bool enable) {
+    if (G4StateManager::GetStateManager()->GetCurrentState() != G4State_PreInit) {
+        G4cerr << "PhysicsList: Woodcock tracking can only be changed before /run/initialize" << G4endl;
+        return;
+    }
+#if G4VERSION_NUMBER < 1110
+    if (enable) {
+        G4cerr << "PhysicsList: Woodcock tracking requires Geant4 11.1 or later" << G4endl;
+        return;
+    }
+#endif
+    woodcock = enable;
+    ApplyEmParameters();
+    G4cout << "PhysicsList: Woodcock tracking of photons " << (woodcock ? "enabled" : "disabled") << G4endl;
+}
 
-    // Configure EM parameters for maximum precision
+void PhysicsList::ApplyEmParameters() const {
     G4EmParameters *emParams = G4EmParameters::Instance();
-    emParams->SetStepFunction(0.1, 0.01 * mm); // More restrictive step function
-    emParams->SetStepFunctionMuHad(0.05, 0.005 * mm); // Even finer for muons/hadrons
-    G4ProductionCutsTable::GetProductionCutsTable()->SetEnergyRange(250 * eV, 1 * GeV);
+    if (preset == "fast") {
+        // Electrons at these energies travel a few um: a coarser step function and a 1 keV tracking limit change
+        // the dose in the sub-mm meshes far less than their statistical uncertainty
+        emParams->SetStepFunction(0.2, 0.05 * mm);
+        emParams->SetLowestElectronEnergy(1 * keV);
+        emParams->SetFluo(true);
+        emParams->SetAuger(false);
+    } else {
+        // Configure EM parameters for maximum precision
+        emParams->SetStepFunction(0.1, 0.01 * mm); // More restrictive step function
+        emParams->SetStepFunctionMuHad(0.05, 0.005 * mm); // Even finer for muons/hadrons
+        // Back to the 100 eV tracking limit of the Penelope, Livermore and option4 constructors after the fast preset
+        emParams->SetLowestElectronEnergy(100 * eV);
+    }
+    if (fluorescence >= 0) emParams->SetFluo(fluorescence == 1);
+    if (auger >= 0) emParams->SetAuger(auger == 1);
+
+    // The Woodcock method lives in the general gamma process, which all presets build when it is active
+    emParams->SetGeneralProcessActive(woodcock);
+#if G4VERSION_NUMBER >= 1110
+    if (woodcock) emParams->SetWoodcockActiveRegion(DetectorConstruction::kSpecimenRegion);
+#endif
+
+    emParams->SetMaxEnergy(tableMaxEnergy);
+    G4ProductionCutsTable::GetProductionCutsTable()->SetEnergyRange(250 * eV, tableMaxEnergy);
 }
 
-PhysicsList::~PhysicsList()
-= default;
+PhysicsList::~PhysicsList() {
+    delete messenger;
+    if (instance == this) instance = nullptr;
+}
 
 void PhysicsList::SetCuts() {
+    // Processes are constructed, the tables follow during /run/initialize
+    MemoryReport::Record(MemoryReport::kProcessesEnd);
+
     // Set very small production cuts for high precision in small volumes
     // Smaller cuts = more accurate tracking at the cost of computation time
     SetCutValue(0.01 * mm, "gamma"); // 10 micrometers
@@ -54,4 +160,136 @@ void PhysicsList::SetCuts() {
     if (verboseLevel > 0) {
         DumpCutValuesTable();
     }
+
+    // Geometry (and therefore the material list) is known at this point
+    cutsSet = true;
+    UpdateTableCache();
+}
+
+void PhysicsList::BuildPhysicsTable() {
+    G4VModularPhysicsList::BuildPhysicsTable();
+    // Master: tables built, the workers of /run/initialize start after this
+    MemoryReport::Record(MemoryReport::kTablesEnd);
+}
+
+G4bool PhysicsList::Notify(const G4ApplicationState requestedState) {
+    if (requestedState == G4State_Init && cutsSet) UpdateTableCache();
+    return true;
+}
+
+void PhysicsList::SetBeamMaxEnergy(G4double energy) {
+    if (energy <= 0.0) return;
+    energy = std::max(energy, heldMaxEnergy);
+
+    // Round 2x the highest energy up to the next decade (e.g. 15-50 keV beams -> 100 keV), so switching between
+    // similar sources does not rebuild the tables
+    const G4double maxEnergy = std::pow(10.0, std::ceil(std::log10(2.0 * energy / keV))) * keV;
+    if (maxEnergy == tableMaxEnergy) return;
+    tableMaxEnergy = maxEnergy;
+
+    G4cout << "PhysicsList: physics tables limited to " << G4BestUnit(tableMaxEnergy, "Energy") << G4endl;
+    ApplyEmParameters();
+
+    // Tables built for the previous range are outdated
+    if (G4RunManager *runManager = G4RunManager::GetRunManager()) runManager->PhysicsHasBeenModified();
+    UpdateTableCache();
+}
+
+void PhysicsList::HoldBeamMaxEnergy(const G4double energy) {
+    heldMaxEnergy = energy;
+    SetBeamMaxEnergy(energy);
+}
+
+void PhysicsList::SetTableCacheEnabled(const G4bool enable) {
+    tableCacheEnabled = enable;
+    UpdateTableCache();
+}
+
+void PhysicsList::SetTableCacheDirectory(const std::string &directory) {
+    tableCacheDirectory = directory;
+    UpdateTableCache();
+}
+
+std::string PhysicsList::TableCacheKey() const {
+    // Everything the tables depend on: toolkit version, models, energy range, cuts and the material definitions
+    std::ostringstream key;
+    key << std::setprecision(17);
+    key << "geant4 " << G4VERSION_NUMBER << "\n";
+    key << "models " << preset << " fluo " << G4EmParameters::Instance()->Fluo()
+            << " auger " << G4EmParameters::Instance()->Auger() << " woodcock " << woodcock
+            << " lowest electron " << G4EmParameters::Instance()->LowestElectronEnergy() << "\n";
+    key << "energy " << 250 * eV << " " << tableMaxEnergy << " " << G4EmParameters::Instance()->MaxKinEnergy() << "\n";
+    // Production cuts in effect per region (gamma, e-, e+, proton), including those changed by macro commands
+    for (const G4Region *region: *G4RegionStore::GetInstance()) {
+        const G4ProductionCuts *cuts = region->GetProductionCuts();
+        if (!cuts) continue;
+        key << "cuts " << region->GetName();
+        for (G4int index = 0; index < 4; ++index) key << " " << cuts->GetProductionCut(index);
+        key << "\n";
+    }
+    for (const G4Material *material: *G4Material::GetMaterialTable()) {
+        key << "material " << material->GetName() << " " << material->GetDensity();
+        const G4ElementVector *elements = material->GetElementVector();
+        const G4double *fractions = material->GetFractionVector();
+        for (size_t i = 0; i < material->GetNumberOfElements(); ++i) {
+            key << " " << (*elements)[i]->GetSymbol() << " " << fractions[i];
+        }
+        key << "\n";
+    }
+    return key.str();
+}
+
+void PhysicsList::UpdateTableCache() {
+    pendingStoreDirectory.clear();
+    if (!tableCacheEnabled || G4Material::GetNumberOfMaterials() == 0) {
+        ResetPhysicsTableRetrieved();
+        return;
+    }
+
+    // FNV-1a: stable across runs and builds, unlike std::hash
+    const std::string key = TableCacheKey();
+    std::uint64_t hash = 14695981039346656037ull;
+    for (const unsigned char c: key) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << hash;
+    const std::filesystem::path entry = std::filesystem::path(tableCacheDirectory) / name.str();
+
+    if (std::filesystem::exists(entry / "complete")) {
+        G4cout << "PhysicsList: retrieving physics tables from " << entry.string() << G4endl;
+        SetPhysicsTableRetrieved(entry.string());
+    } else {
+        ResetPhysicsTableRetrieved();
+        pendingStoreDirectory = entry.string();
+    }
+}
+
+void PhysicsList::StoreTablesIfNeeded() {
+    if (pendingStoreDirectory.empty()) return;
+
+    // Write into a temporary directory and rename it, so a crash never leaves a half-written entry behind
+    namespace fs = std::filesystem;
+    const fs::path entry = pendingStoreDirectory;
+    const fs::path staging = entry.string() + ".tmp";
+    pendingStoreDirectory.clear();
+
+    std::error_code ec;
+    fs::remove_all(staging, ec);
+    fs::create_directories(staging, ec);
+    if (ec || !StorePhysicsTable(staging.string())) {
+        G4cerr << "PhysicsList: could not store physics tables in " << staging.string() << G4endl;
+        fs::remove_all(staging, ec);
+        return;
+    }
+    std::ofstream(staging / "key.txt") << TableCacheKey();
+    std::ofstream(staging / "complete") << "ok\n";
+
+    fs::rename(staging, entry, ec);
+    if (ec) {
+        fs::remove_all(staging, ec);
+        return;
+    }
+    G4cout << "PhysicsList: stored physics tables in " << entry.string() << G4endl;
 }
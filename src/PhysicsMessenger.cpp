@@ -0,0 +1,98 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "PhysicsMessenger.h"
+#include "PhysicsList.h"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithABool.hh"
+
+PhysicsMessenger::PhysicsMessenger(PhysicsList *physicsList)
+    : physicsList(physicsList) {
+    // The physics list is shared by all threads and configured on the master only
+    physicsDir = new G4UIdirectory("/physics/", false);
+    physicsDir->SetGuidance("Physics list configuration");
+
+    presetCmd = new G4UIcmdWithAString("/physics/selectPreset", this);
+    presetCmd->SetGuidance("Select the EM physics preset (before /run/initialize)");
+    presetCmd->SetGuidance("  penelope  - G4EmPenelopePhysics (reference, default)");
+    presetCmd->SetGuidance("  livermore - G4EmLivermorePhysics");
+    presetCmd->SetGuidance("  option4   - G4EmStandardPhysics_option4");
+    presetCmd->SetGuidance("  fast      - photons and electrons only, coarser steps, no Auger electrons");
+    presetCmd->SetParameterName("preset", false);
+    presetCmd->SetCandidates("penelope livermore option4 fast");
+    presetCmd->AvailableForStates(G4State_PreInit);
+
+    fluorescenceCmd = new G4UIcmdWithABool("/physics/setFluorescence", this);
+    fluorescenceCmd->SetGuidance("Enable/disable atomic fluorescence (overrides the preset)");
+    fluorescenceCmd->SetParameterName("enable", false);
+    fluorescenceCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    augerCmd = new G4UIcmdWithABool("/physics/setAuger", this);
+    augerCmd->SetGuidance("Enable/disable Auger electron emission (overrides the preset)");
+    augerCmd->SetParameterName("enable", false);
+    augerCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    woodcockCmd = new G4UIcmdWithABool("/physics/setWoodcock", this);
+    woodcockCmd->SetGuidance("Woodcock (delta) tracking of photons in the specimen region (Geant4 11.1 or later)");
+    woodcockCmd->SetGuidance("Photons cross the insect, ethanol and tube without stopping at their boundaries");
+    woodcockCmd->SetParameterName("enable", true);
+    woodcockCmd->SetDefaultValue(true);
+    woodcockCmd->AvailableForStates(G4State_PreInit);
+
+    cacheDir = new G4UIdirectory("/physics/cache/", false);
+    cacheDir->SetGuidance("Persistent physics table cache");
+
+    cacheEnableCmd = new G4UIcmdWithABool("/physics/cache/enable", this);
+    cacheEnableCmd->SetGuidance("Store built physics tables and retrieve them on later starts (default true)");
+    cacheEnableCmd->SetParameterName("enable", false);
+    cacheEnableCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    cacheDirectoryCmd = new G4UIcmdWithAString("/physics/cache/setDirectory", this);
+    cacheDirectoryCmd->SetGuidance("Directory of the physics table cache (default 'physics_cache')");
+    cacheDirectoryCmd->SetParameterName("directory", false);
+    cacheDirectoryCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+PhysicsMessenger::~PhysicsMessenger() {
+    delete presetCmd;
+    delete fluorescenceCmd;
+    delete augerCmd;
+    delete woodcockCmd;
+    delete cacheEnableCmd;
+    delete cacheDirectoryCmd;
+    delete cacheDir;
+    delete physicsDir;
+}
+
+void PhysicsMessenger::SetNewValue(G4UIcommand *command, G4String newValue) {
+    if (command == presetCmd) {
+        physicsList->SelectPreset(std::string(newValue));
+    } else if (command == fluorescenceCmd) {
+        physicsList->SetFluorescence(G4UIcmdWithABool::GetNewBoolValue(newValue));
+    } else if (command == augerCmd) {
+        physicsList->SetAuger(G4UIcmdWithABool::GetNewBoolValue(newValue));
+    } else if (command == woodcockCmd) {
+        physicsList->SetWoodcock(G4UIcmdWithABool::GetNewBoolValue(newValue));
+    } else if (command == cacheEnableCmd) {
+        physicsList->SetTableCacheEnabled(G4UIcmdWithABool::GetNewBoolValue(newValue));
+    } else if (command == cacheDirectoryCmd) {
+        physicsList->SetTableCacheDirectory(std::string(newValue));
+    }
+}
@@ -0,0 +1,303 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "PresetComparison.h"
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+    struct PresetResult {
+        std::string insect;
+        long long events{0};
+        double eventsPerSecond{0.0};
+        double wallTime{0.0};
+        std::map<std::string, double> dosePerEvent;
+        std::map<std::string, double> relError;
+    };
+
+    // Reads the last summary line written by RunAction (/output/setJsonSummaryFile)
+    bool ReadSummary(const std::string &filename, PresetResult &result) {
+        std::ifstream in(filename);
+        std::string line, last;
+        while (std::getline(in, line)) {
+            if (!line.empty()) last = line;
+        }
+        if (last.empty()) return false;
+
+        const std::string number = R"(([-+0-9.eE]+))";
+        std::smatch match;
+        if (std::regex_search(last, match, std::regex(R"#("insect": "([^"]+)")#"))) result.insect = match[1];
+        if (std::regex_search(last, match, std::regex(R"("events": )" + number))) result.events = std::stoll(match[1]);
+        if (std::regex_search(last, match, std::regex(R"("eventsPerSecond": )" + number)))
+            result.eventsPerSecond = std::stod(match[1]);
+        if (std::regex_search(last, match, std::regex(R"("wallTime": )" + number)))
+            result.wallTime = std::stod(match[1]);
+
+        const std::regex volume(R"#("([^"]+)": \{"energyDeposit": [^,]+, "dose": [^,]+, "dosePerEvent": )#" + number +
+                                R"#(, "doseRate": [^,]+, "relError": )#" + number);
+        for (auto it = std::sregex_iterator(last.begin(), last.end(), volume); it != std::sregex_iterator(); ++it) {
+            result.dosePerEvent[(*it)[1]] = std::stod((*it)[2]);
+            result.relError[(*it)[1]] = std::stod((*it)[3]);
+        }
+        return true;
+    }
+
+    // Runs the macro in a child process with the given options and reads its summary
+    bool RunChild(const std::string &executable, const std::string &macro, const std::string &options,
+                  const std::string &tag, PresetResult &result) {
+        const std::string summary = tag + ".json";
+        std::filesystem::remove(summary);
+
+        std::ostringstream command;
+        command << '"' << executable << "\" " << options << " --json " << summary << " \"" << macro << "\" > " << tag
+                << ".log 2>&1";
+        if (std::system(command.str().c_str()) != 0) {
+            std::cerr << "Run failed, see " << tag << ".log" << std::endl;
+            return false;
+        }
+        if (!ReadSummary(summary, result)) {
+            std::cerr << "No run summary in " << summary << " (does the macro call /run/beamOn?)" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    // Host name and number of CPUs, to record with a measured comparison
+    std::string Machine() {
+        char host[256] = {};
+        gethostname(host, sizeof(host) - 1);
+        return std::string(host) + " (" + std::to_string(std::thread::hardware_concurrency()) + " CPUs)";
+    }
+
+    // Relative dose difference to the reference in percent
+    std::string DoseDifference(const double referenceDose, const double dose) {
+        if (referenceDose <= 0.0) return "n/a";
+        std::ostringstream diff;
+        diff << std::showpos << std::fixed << std::setprecision(2) << 100.0 * (dose / referenceDose - 1.0) << " %";
+        return diff.str();
+    }
+
+    // Dose difference of a volume between two runs in units of their combined standard error
+    double Pull(const PresetResult &reference, const PresetResult &result, const std::string &volume) {
+        const double referenceDose = reference.dosePerEvent.at(volume);
+        const double dose = result.dosePerEvent.at(volume);
+        const double referenceError = referenceDose * reference.relError.at(volume);
+        const double error = dose * result.relError.at(volume);
+        const double sigma = std::sqrt(referenceError * referenceError + error * error);
+        return sigma > 0.0 ? (dose - referenceDose) / sigma : 0.0;
+    }
+
+    // Dose, relative error, wall time and figure of merit per run and volume, relative to the first run
+    std::string FomTable(const std::string &header, const std::vector<std::string> &labels,
+                         const std::vector<PresetResult> &results) {
+        // Figure of merit 1 / (relative error^2 * wall time): the inverse of the time to reach a relative error of 1
+        const auto fom = [](const PresetResult &result, const std::string &volume) {
+            const auto it = result.relError.find(volume);
+            if (it == result.relError.end() || it->second <= 0.0 || result.wallTime <= 0.0) return 0.0;
+            return 1.0 / (it->second * it->second * result.wallTime);
+        };
+
+        std::ostringstream table;
+        table << std::setw(12) << header << std::setw(20) << "Volume" << std::setw(18) << "Dose/event (Gy)"
+                << std::setw(12) << "Rel. error" << std::setw(12) << "Wall (s)" << std::setw(14) << "FOM (1/s)"
+                << std::setw(12) << "FOM ratio" << "\n";
+        const PresetResult &reference = results.front();
+        for (size_t i = 0; i < labels.size(); ++i) {
+            const PresetResult &result = results[i];
+            for (const auto &[volume, dose]: result.dosePerEvent) {
+                const double referenceFom = fom(reference, volume);
+                table << std::setw(12) << labels[i] << std::setw(20) << volume << std::setw(18) << dose
+                        << std::setw(12) << result.relError.at(volume) << std::setw(12) << result.wallTime
+                        << std::setw(14) << fom(result, volume)
+                        << std::setw(12) << (referenceFom > 0.0 ? fom(result, volume) / referenceFom : 0.0) << "\n";
+            }
+        }
+        return table.str();
+    }
+}
+
+int RunPresetComparison(const std::string &executable, const std::string &macro,
+                        const std::vector<std::string> &presets) {
+    std::vector<PresetResult> results;
+    for (const auto &preset: presets) {
+        std::cout << "Running preset '" << preset << "' ..." << std::endl;
+        PresetResult result;
+        if (!RunChild(executable, macro, "--physics " + preset + " --suffix _" + preset, "preset_comparison_" + preset,
+                      result)) {
+            return 1;
+        }
+        results.push_back(result);
+    }
+
+    std::ostringstream report;
+    report << "Physics preset comparison for " << macro << " (reference: " << presets.front() << ")\n";
+    report << std::setw(12) << "Preset" << std::setw(15) << "Events/s" << std::setw(10) << "Speedup" << "\n";
+    const PresetResult &reference = results.front();
+    for (size_t i = 0; i < presets.size(); ++i) {
+        const double speedup = reference.eventsPerSecond > 0.0 ? results[i].eventsPerSecond / reference.eventsPerSecond
+                                                                : 0.0;
+        report << std::setw(12) << presets[i] << std::setw(15) << results[i].eventsPerSecond << std::setw(10)
+                << speedup << "\n";
+    }
+
+    // The pull (difference over the combined standard error) tells physics differences from fluctuations
+    report << "\n" << std::setw(12) << "Preset" << std::setw(20) << "Volume" << std::setw(18) << "Dose/event (Gy)"
+            << std::setw(12) << "Rel. error" << std::setw(12) << "Diff" << std::setw(12) << "Diff/sigma" << "\n";
+    for (size_t i = 0; i < presets.size(); ++i) {
+        const PresetResult &result = results[i];
+        for (const auto &[volume, referenceDose]: reference.dosePerEvent) {
+            const auto it = result.dosePerEvent.find(volume);
+            if (it == result.dosePerEvent.end()) {
+                report << std::setw(12) << presets[i] << std::setw(20) << volume << std::setw(18) << "n/a" << "\n";
+                continue;
+            }
+            report << std::setw(12) << presets[i] << std::setw(20) << volume << std::setw(18) << it->second
+                    << std::setw(12) << result.relError.at(volume) << std::setw(12)
+                    << DoseDifference(referenceDose, it->second) << std::setw(12) << std::fixed
+                    << std::setprecision(2) << Pull(reference, result, volume) << std::defaultfloat
+                    << std::setprecision(6) << "\n";
+        }
+    }
+
+    std::cout << "\n" << report.str();
+    std::ofstream("preset_comparison.txt") << report.str();
+    std::cout << "Report saved to preset_comparison.txt" << std::endl;
+    return 0;
+}
+
+int RunSamplingComparison(const std::string &executable, const std::string &macro,
+                          const std::vector<std::string> &modes) {
+    std::vector<PresetResult> results;
+    for (const auto &mode: modes) {
+        std::cout << "Running sampling '" << mode << "' ..." << std::endl;
+        PresetResult result;
+        if (!RunChild(executable, macro, "--sampling " + mode + " --suffix _" + mode, "sampling_comparison_" + mode,
+                      result)) {
+            return 1;
+        }
+        results.push_back(result);
+    }
+
+    std::ostringstream report;
+    report << "Source sampling comparison for " << macro << " (reference: " << modes.front() << ")\n";
+    report << FomTable("Sampling", modes, results);
+
+    // One line per mode in the form of the README table, to record the measurement
+    const PresetResult &reference = results.front();
+    const auto insectFom = [](const PresetResult &result) {
+        const auto it = result.relError.find(result.insect);
+        if (it == result.relError.end() || it->second <= 0.0 || result.wallTime <= 0.0) return 0.0;
+        return 1.0 / (it->second * it->second * result.wallTime);
+    };
+    for (size_t i = 1; i < modes.size(); ++i) {
+        const double referenceFom = insectFom(reference);
+        report << "| `" << std::filesystem::path(macro).filename().string() << "` | " << results[i].events << " | "
+                << (referenceFom > 0.0 ? insectFom(results[i]) / referenceFom : 0.0) << " (" << modes[i] << " / "
+                << modes.front() << ") | " << Machine() << " |\n";
+    }
+
+    std::cout << "\n" << report.str();
+    std::ofstream("sampling_comparison.txt") << report.str();
+    std::cout << "Report saved to sampling_comparison.txt" << std::endl;
+    return 0;
+}
+
+int RunWoodcockComparison(const std::string &executable, const std::string &macro) {
+    PresetResult standard, woodcock;
+    std::cout << "Running standard navigation ..." << std::endl;
+    if (!RunChild(executable, macro, "--suffix _standard", "woodcock_comparison_standard", standard)) return 1;
+    std::cout << "Running Woodcock tracking ..." << std::endl;
+    if (!RunChild(executable, macro, "--woodcock --suffix _woodcock", "woodcock_comparison_woodcock", woodcock)) {
+        return 1;
+    }
+
+    const double speedup = standard.eventsPerSecond > 0.0 ? woodcock.eventsPerSecond / standard.eventsPerSecond
+                                                          : 0.0;
+    std::ostringstream report;
+    report << "Woodcock tracking comparison for " << macro << "\n";
+    report << "Events/s: standard " << standard.eventsPerSecond << ", Woodcock " << woodcock.eventsPerSecond
+            << " (speedup " << speedup << ")\n";
+    report << std::setw(20) << "Volume" << std::setw(20) << "Standard (Gy/evt)" << std::setw(20) << "Woodcock (Gy/evt)"
+            << std::setw(12) << "Diff" << std::setw(12) << "Diff/sigma" << "\n";
+
+    // Identical physics: the doses may only differ by statistical fluctuations
+    bool consistent = true;
+    double maxPull = 0.0;
+    std::string maxPullVolume = "n/a";
+    for (const auto &[volume, standardDose]: standard.dosePerEvent) {
+        const auto it = woodcock.dosePerEvent.find(volume);
+        if (it == woodcock.dosePerEvent.end()) {
+            report << std::setw(20) << volume << std::setw(20) << standardDose << std::setw(20) << "n/a" << "\n";
+            consistent = false;
+            continue;
+        }
+        const double pull = Pull(standard, woodcock, volume);
+        if (std::abs(pull) > 3.0) consistent = false;
+        if (std::abs(pull) >= maxPull) {
+            maxPull = std::abs(pull);
+            maxPullVolume = volume;
+        }
+
+        report << std::setw(20) << volume << std::setw(20) << standardDose << std::setw(20) << it->second
+                << std::setw(12) << DoseDifference(standardDose, it->second) << std::setw(12) << std::fixed
+                << std::setprecision(2) << pull << std::defaultfloat << std::setprecision(6) << "\n";
+    }
+    report << (consistent ? "All doses agree within three standard errors\n"
+                          : "Doses differ by more than three standard errors\n");
+
+    // The result in the form of the README table, to record the measurement
+    report << "| `" << std::filesystem::path(macro).filename().string() << "` | " << standard.events << " | "
+            << speedup << " | " << std::fixed << std::setprecision(2) << maxPull << std::defaultfloat
+            << std::setprecision(6) << " (" << maxPullVolume << ") | " << Machine() << " |\n";
+
+    std::cout << "\n" << report.str();
+    std::ofstream("woodcock_comparison.txt") << report.str();
+    std::cout << "Report saved to woodcock_comparison.txt" << std::endl;
+    return consistent ? 0 : 1;
+}
+
+int RunImportanceComparison(const std::string &executable, const std::string &macro) {
+    const std::vector<std::string> modes = {"analog", "importance"};
+    std::vector<PresetResult> results;
+    for (const auto &mode: modes) {
+        std::cout << "Running " << mode << " transport ..." << std::endl;
+        PresetResult result;
+        const std::string options = (mode == "importance" ? "--importance " : "") + std::string("--suffix _") + mode;
+        if (!RunChild(executable, macro, options, "importance_comparison_" + mode, result)) return 1;
+        results.push_back(result);
+    }
+
+    std::ostringstream report;
+    report << "Importance sampling comparison for " << macro << " (reference: analog)\n";
+    report << FomTable("Transport", modes, results);
+
+    std::cout << "\n" << report.str();
+    std::ofstream("importance_comparison.txt") << report.str();
+    std::cout << "Report saved to importance_comparison.txt" << std::endl;
+    return 0;
+}
@@ -20,30 +20,42 @@
 #include "PrimaryGeneratorAction.h"
 #include "PrimaryGeneratorMessenger.h"
 #include "G4ParticleGun.hh"
+#include "G4Gamma.hh"
+#include "G4Threading.hh"
+#include "PhysicsList.h"
+#include "PhaseSpaceFile.h"
+#include "Spectrum.h"
+#include "PartitionedRun.h"
+#include "Checkpoint.h"
+#include "RunAction.h"
+#include "SteppingAction.h"
+#include "DetectorConstruction.h"
+#include "G4TessellatedSolid.hh"
+#include "G4RunManager.hh"
+#include "G4Run.hh"
+#include "G4Event.hh"
+#include "G4PrimaryVertex.hh"
+#include "G4PrimaryParticle.hh"
 #include "G4ParticleTable.hh"
-#include "G4ParticleDefinition.hh"
+#include "G4SystemOfUnits.hh"
 #include "parameters.h"
 #include "Randomize.hh"
 #include <algorithm>
-#include <numeric>
-#include <fstream>
-#include <sstream>
-#include <filesystem>
+#include <cfloat>
+#include <cmath>
 
 G4double PrimaryGeneratorAction::photonFlux = 1e12; // photons/s/mm2 default
+PrimaryGeneratorAction *PrimaryGeneratorAction::masterInstance = nullptr;
+thread_local G4int PrimaryGeneratorAction::eventSector = 0;
 
 PrimaryGeneratorAction::PrimaryGeneratorAction()
-    : fParticleGun(nullptr), maxIntensity(0.), messenger(nullptr) {
+    : fParticleGun(nullptr), messenger(nullptr) {
     // Create particle gun
     constexpr G4int nParticles = 1;
     fParticleGun = new G4ParticleGun(nParticles);
 
-    // Get particle definition for gamma (photon)
-    G4ParticleTable *particleTable = G4ParticleTable::GetParticleTable();
-    G4ParticleDefinition *particle = particleTable->FindParticle("gamma");
-
-    // Set particle properties
-    fParticleGun->SetParticleDefinition(particle);
+    // Set particle properties (use the static definition: on the master this runs before the particle table is filled)
+    fParticleGun->SetParticleDefinition(G4Gamma::Definition());
 
     // Create messenger so macros can configure generator
     messenger = new PrimaryGeneratorMessenger(this);
@@ -59,9 +71,12 @@ PrimaryGeneratorAction::PrimaryGeneratorAction()
 
     // Position at the beginning (before the meshes at Z~400-900mm)
     fParticleGun->SetParticlePosition(G4ThreeVector(0., 0., 5. * CLHEP::mm));
+
+    if (G4Threading::IsMasterThread()) masterInstance = this;
 }
 
 PrimaryGeneratorAction::~PrimaryGeneratorAction() {
+    if (masterInstance == this) masterInstance = nullptr;
     delete messenger;
     delete fParticleGun;
 }
@@ -69,175 +84,329 @@ PrimaryGeneratorAction::~PrimaryGeneratorAction() {
 void PrimaryGeneratorAction::SetSpectrumFilename(const std::string &filename) {
     spectrumFilename = filename;
     // Reinitialize spectrum on change
-    spectrumEnergies.clear();
-    spectrumIntensities.clear();
-    cumulativeDistribution.clear();
     InitializeSpectrum();
 }
 
+void PrimaryGeneratorAction::SetPhaseSpaceFile(const std::string &filename) {
+    phaseSpace.reset();
+    phaseSpaceSliced = false;
+    if (!filename.empty()) {
+        phaseSpace = PhaseSpaceFile::Open(filename);
+        if (!phaseSpace) G4cerr << "PrimaryGeneratorAction: phase-space replay disabled, using the beam" << G4endl;
+    }
+    UpdatePhysicsEnergyRange();
+}
+
+G4double PrimaryGeneratorAction::GetSourcePhotonsPerEvent() {
+    if (!masterInstance) return 1.0;
+    const G4double perEvent = masterInstance->photonsPerEvent;
+    if (!masterInstance->phaseSpace) return perEvent;
+    const auto &header = masterInstance->phaseSpace->GetHeader();
+    return perEvent * static_cast<G4double>(header.sourceEvents) / static_cast<G4double>(header.nHistories);
+}
+
+void PrimaryGeneratorAction::SetPhotonsPerEvent(const G4int n) {
+    photonsPerEvent = std::max(1, n);
+}
+
 void PrimaryGeneratorAction::SetPhotonFlux(const G4double flux) {
     photonFlux = flux;
 }
 
 void PrimaryGeneratorAction::SetMonochromatic(const bool mono) {
+    if (monochromatic == mono) return;
     monochromatic = mono;
+    // Switch between the single-energy and the file spectrum
+    InitializeSpectrum();
 }
 
 void PrimaryGeneratorAction::SetMonoEnergy(const G4double e) {
     monoEnergy = e;
+    if (monochromatic) InitializeSpectrum();
 }
 
 void PrimaryGeneratorAction::InitializeSpectrum() {
-    // If monochromatic mode is set, build a single-energy spectrum
-    if (monochromatic) {
-        spectrumEnergies.clear();
-        spectrumIntensities.clear();
-        cumulativeDistribution.clear();
-
-        spectrumEnergies.push_back(monoEnergy);
-        spectrumIntensities.push_back(1.0);
-        cumulativeDistribution.push_back(0.0);
-        cumulativeDistribution.push_back(1.0);
-        maxIntensity = 1.0;
-
-        G4cout << "Initialized monochromatic spectrum at " << monoEnergy / CLHEP::keV << " keV" << G4endl;
-        return;
+    // Workers share the spectrum the master generator has loaded for the same settings
+    if (!G4Threading::IsMasterThread()) {
+        RefreshSpectrum();
+        if (spectrum) return;
     }
 
-    // Try to read a spectrum file from the provided filename or the `spectra/` directory.
-    namespace fs = std::filesystem;
-    std::vector<std::pair<G4double, G4double> > parsed; // pair<energy_eV, intensity>
+    // If monochromatic mode is set, build a single-energy spectrum
+    spectrum = monochromatic ? Spectrum::Monochromatic(monoEnergy) : Spectrum::FromFile(spectrumFilename);
+    Spectrum::Publish(spectrum);
+    spectrumGeneration = Spectrum::GetGeneration();
+    batchNext = batchEnergy.size(); // drop primaries sampled from the previous spectrum
+    UpdatePhysicsEnergyRange();
+}
 
-    fs::path fileToOpen;
-    if (!spectrumFilename.empty()) {
-        if (fs::path p(spectrumFilename); p.is_absolute()) {
-            if (fs::exists(p)) fileToOpen = p;
-        } else {
-            // check in project spectra dir first
-            if (fs::path candidate = fs::path("spectra") / p; fs::exists(candidate)) fileToOpen = candidate;
-            else if (fs::exists(p)) fileToOpen = p; // relative to cwd
-        }
-    } else {
-        // auto-detect first supported file
-        std::vector<fs::path> candidates = {"spectra", "./spectra", "../spectra"};
-        for (const auto &d: candidates) {
-            fs::path dir = d;
-            if (!fs::exists(dir) || !fs::is_directory(dir)) continue;
-            for (auto &entry: fs::directory_iterator(dir)) {
-                if (!entry.is_regular_file()) continue;
-                auto ext = entry.path().extension().string();
-                std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-                if (ext == ".txt" || ext == ".dat" || ext == ".spc") {
-                    fileToOpen = entry.path();
-                    break;
-                }
-            }
-            if (!fileToOpen.empty()) break;
-        }
-    }
+const std::vector<G4double> &PrimaryGeneratorAction::GetSpectrumEnergies() const {
+    static const std::vector<G4double> none;
+    return spectrum ? spectrum->GetEnergies() : none;
+}
 
-    bool fileLoaded = false;
-    if (!fileToOpen.empty()) {
-        if (std::ifstream ifs(fileToOpen); ifs) {
-            G4cout << "Reading spectrum file: " << fileToOpen.string() << G4endl;
-            std::string line;
-            while (std::getline(ifs, line)) {
-                // remove comments after '#'
-                if (auto commentPos = line.find('#'); commentPos != std::string::npos) line.resize(commentPos);
-                // trim
-                std::istringstream iss(line);
-                double e_eV = 0.0, inten = 0.0;
-                if (!(iss >> e_eV)) continue; // skip empty/invalid lines
-                // some files may have only energy + counts per bin; if intensity missing, treat as 1
-                if (!(iss >> inten)) inten = 1.0;
-                parsed.emplace_back(e_eV, inten);
-            }
-            if (!parsed.empty()) fileLoaded = true;
-        }
-    }
-    if (!fileLoaded) {
-        G4cerr << "ERROR: Could not load spectrum file '" << spectrumFilename << G4endl;
-        throw std::runtime_error("Failed to load spectrum file");
+const std::vector<G4double> &PrimaryGeneratorAction::GetSpectrumProbabilities() const {
+    static const std::vector<G4double> none;
+    return spectrum ? spectrum->GetProbabilities() : none;
+}
+
+std::size_t PrimaryGeneratorAction::GetThreadFootprint() const {
+    std::size_t bytes = sizeof(*this) + sizeof(G4ParticleGun);
+    for (const std::vector<G4double> *buffer: {&batchUniforms, &batchX, &batchY, &batchEnergy}) {
+        bytes += buffer->capacity() * sizeof(G4double);
     }
+    bytes += sobolShifts.capacity() * sizeof(SobolSequence::Shift);
+    return bytes;
+}
 
-    // Convert parsed pairs into the member vectors. Ensure energies are sorted ascending.
-    std::sort(parsed.begin(), parsed.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
-    spectrumEnergies.clear();
-    spectrumIntensities.clear();
-    for (auto &[energy, intensity]: parsed) {
-        spectrumEnergies.push_back(energy * CLHEP::eV);
-        spectrumIntensities.push_back(intensity);
+void PrimaryGeneratorAction::RefreshSpectrum() {
+    spectrumGeneration = Spectrum::GetGeneration();
+    if (auto published = Spectrum::GetCurrent(); published != spectrum) {
+        spectrum = std::move(published);
+        batchNext = batchEnergy.size(); // drop primaries sampled from the previous spectrum
     }
+}
 
+void PrimaryGeneratorAction::UpdatePhysicsEnergyRange() const {
+    // The physics tables are built by the master, so only its generator tailors them to the source
+    if (!G4Threading::IsMasterThread()) return;
+    PhysicsList *physicsList = PhysicsList::GetInstance();
+    if (!physicsList) return;
+    if (phaseSpace) physicsList->SetBeamMaxEnergy(phaseSpace->GetHeader().maxEnergy * MeV);
+    else if (spectrum) physicsList->SetBeamMaxEnergy(spectrum->GetEnergies().back());
+}
 
-    // Build cumulative distribution and normalize
-    if (spectrumIntensities.empty()) {
-        spectrumEnergies = {15.2 * CLHEP::keV};
-        spectrumIntensities = {1.0};
-    }
+void PrimaryGeneratorAction::SetBatchSize(const std::size_t n) {
+    batchSize = std::max<std::size_t>(1, n);
+    batchNext = batchEnergy.size();
+}
 
-    G4double sum = std::accumulate(spectrumIntensities.begin(), spectrumIntensities.end(), 0.0);
-    if (sum <= 0.0) {
-        // avoid division by zero
-        std::fill(spectrumIntensities.begin(), spectrumIntensities.end(), 1.0);
-        sum = static_cast<G4double>(spectrumIntensities.size());
+bool PrimaryGeneratorAction::SetSampling(const std::string &mode) {
+    if (mode == "pseudo") quasiRandom = false;
+    else if (mode == "sobol") quasiRandom = true;
+    else {
+        G4cerr << "PrimaryGeneratorAction: unknown sampling '" << mode << "' - allowed: pseudo, sobol" << G4endl;
+        return false;
     }
+    // Scoring is shared: the master configures it
+    if (G4Threading::IsMasterThread()) SteppingAction::SetReplicas(quasiRandom ? quasiRandomReplicas : 0);
+    return true;
+}
 
-    maxIntensity = *std::max_element(spectrumIntensities.begin(), spectrumIntensities.end());
+void PrimaryGeneratorAction::SetQuasiRandomReplicas(const G4int n) {
+    quasiRandomReplicas = std::max(2, n);
+    sobolRun = -1;
+    if (G4Threading::IsMasterThread() && quasiRandom) SteppingAction::SetReplicas(quasiRandomReplicas);
+}
 
-    // Normalize and create cumulative distribution
-    cumulativeDistribution.clear();
-    G4double cumulative = 0.0;
-    cumulativeDistribution.push_back(0.0);
+void PrimaryGeneratorAction::RefillBatch() {
+    const std::size_t n = batchSize;
+    batchUniforms.resize(4 * n);
+    batchX.resize(n);
+    batchY.resize(n);
+    batchEnergy.resize(n);
+    G4Random::getTheEngine()->flatArray(static_cast<G4int>(4 * n), batchUniforms.data());
+
+    const G4double *u = batchUniforms.data();
+    for (std::size_t k = 0; k < n; ++k) {
+        batchX[k] = (u[k] - 0.5) * beamSize;
+        batchY[k] = (u[n + k] - 0.5) * beamSize;
+    }
+    spectrum->GetSampler().SampleBatch(u + 2 * n, u + 3 * n, batchEnergy.data(), n);
+    batchNext = 0;
+}
 
-    for (double &spectrumIntensity: spectrumIntensities) {
-        spectrumIntensity /= sum;
-        cumulative += spectrumIntensity;
-        cumulativeDistribution.push_back(cumulative);
+void PrimaryGeneratorAction::GeneratePrimaries(G4Event *event) {
+    eventSector = 0;
+    const G4bool reproducible = RunAction::IsReproducible();
+    if (reproducible) RunAction::SeedEvent(event->GetEventID());
+    if (phaseSpace) {
+        for (G4int i = 0; i < photonsPerEvent; ++i) {
+            // Reproducible: the histories follow from the event ID instead of the slice of the thread
+            const auto history = static_cast<std::uint64_t>(event->GetEventID()) * photonsPerEvent + i;
+            GeneratePhaseSpacePrimaries(event, reproducible ? static_cast<std::int64_t>(history) : -1);
+        }
+        return;
     }
 
-    G4cout << "Initialized polychromatic spectrum with " << spectrumEnergies.size() << " energy bins" << G4endl;
-    if (!spectrumEnergies.empty())
-        G4cout << "Energy range: " << spectrumEnergies.front() / CLHEP::keV << " - " << spectrumEnergies.back() /
-                CLHEP::keV << " keV" << G4endl;
-}
+    // A spectrum published by the master between runs replaces ours
+    if (spectrumGeneration != Spectrum::GetGeneration()) RefreshSpectrum();
+
+    if (quasiRandom) {
+        // The points depend on the event ID only, not on the thread the event runs on
+        if (const G4int runID = G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID(); runID != sobolRun) {
+            sobolShifts.clear();
+            for (G4int r = 0; r < quasiRandomReplicas; ++r) {
+                // Partitions of a split run and segments of a continued checkpoint use shifts of their own, so
+                // their replicas are independent
+                const G4int stream = Checkpoint::GetSegment() * PartitionedRun::GetCount() + PartitionedRun::GetIndex();
+                const G4int replica = stream * quasiRandomReplicas + r;
+                sobolShifts.push_back(SobolSequence::MakeShift(quasiRandomSeed, runID, replica));
+            }
+            sobolRun = runID;
+        }
+    }
 
-G4double PrimaryGeneratorAction::SampleEnergyFromSpectrum() {
-    // Inverse transform sampling
-    const G4double random = G4UniformRand();
+    // Parallel beam: photonsPerEvent independent primaries, each in its own vertex
+    fParticleGun->SetParticleMomentumDirection(G4ThreeVector(0., 0., -1.));
+    for (G4int i = 0; i < photonsPerEvent; ++i) {
+        G4double x, y, energy;
+        if (quasiRandom) {
+            // All photons of event e use consecutive points of the sequence of replica e % replicas
+            const G4int eventID = event->GetEventID();
+            const auto index = static_cast<std::uint64_t>(eventID / quasiRandomReplicas) * photonsPerEvent + i;
+            G4double u[SobolSequence::kDimensions];
+            sobol.Point(static_cast<std::uint32_t>(index), sobolShifts[eventID % quasiRandomReplicas], u);
+            x = (u[0] - 0.5) * beamSize;
+            y = (u[1] - 0.5) * beamSize;
+            energy = spectrum->GetSampler().Sample(u[2], u[3]);
+        } else if (reproducible) {
+            // No blocks: the primaries of an event must come from its own seed
+            x = (G4UniformRand() - 0.5) * beamSize;
+            y = (G4UniformRand() - 0.5) * beamSize;
+            const G4double u2 = G4UniformRand();
+            energy = spectrum->GetSampler().Sample(u2, G4UniformRand());
+        } else {
+            if (batchNext >= batchEnergy.size()) RefillBatch();
+            x = batchX[batchNext];
+            y = batchY[batchNext];
+            energy = batchEnergy[batchNext];
+            ++batchNext;
+        }
+        const G4double z = beamStartZ; // Start position (before scaled meshes at Z ~0.4-0.9mm)
 
-    // binary search in cumulative distribution
-    const auto it = std::lower_bound(cumulativeDistribution.begin(),
-                                     cumulativeDistribution.end(),
-                                     random);
+        fParticleGun->SetParticlePosition(G4ThreeVector(x, y, z));
 
-    size_t index = std::distance(cumulativeDistribution.begin(), it);
-    if (index > 0) index--;
-    if (index >= spectrumEnergies.size()) index = spectrumEnergies.size() - 1;
+        // Energy sampled from the polychromatic spectrum
+        fParticleGun->SetParticleEnergy(energy);
 
-    // Linear interpolation between bins
-    if (index < spectrumEnergies.size() - 1) {
-        const G4double f = (random - cumulativeDistribution[index]) /
-                           (cumulativeDistribution[index + 1] - cumulativeDistribution[index]);
-        return spectrumEnergies[index] + f * (spectrumEnergies[index + 1] - spectrumEnergies[index]);
+        fParticleGun->GeneratePrimaryVertex(event);
     }
 
-    return spectrumEnergies[index];
+    // Rotating the beam by -angle about the scan axis is rotating the specimen by +angle
+    if (tomography.IsActive()) {
+        if (G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID() != tomographyRun) ResolveTomographyAxis();
+        const G4double angle = tomography.Sample(G4UniformRand());
+        eventSector = tomography.Sector(angle);
+        tomography.RotateEvent(event, angle, tomographyAxisPoint);
+    }
 }
 
-void PrimaryGeneratorAction::GeneratePrimaries(G4Event *event) {
-    // Generate parallel beam
+void PrimaryGeneratorAction::UpdateTomography() {
+    tomographyRun = -1;
+    if (tomography.IsActive() && phaseSpace && G4Threading::IsMasterThread()) {
+        G4cout << "PrimaryGeneratorAction: the tomographic scan only rotates the beam, phase-space replays are not "
+                "rotated" << G4endl;
+    }
+    // Scoring is shared: the master configures it
+    if (G4Threading::IsMasterThread()) SteppingAction::SetSectors(tomography.GetSectors());
+}
 
-    const G4double x = (G4UniformRand() - 0.5) * beamSize;
-    const G4double y = (G4UniformRand() - 0.5) * beamSize;
-    constexpr G4double z = 5 * CLHEP::mm; // Start position (before scaled meshes at Z ~0.4-0.9mm)
+void PrimaryGeneratorAction::ResolveTomographyAxis() {
+    tomographyRun = G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID();
+
+    // Bounding box of all meshes
+    G4ThreeVector low(DBL_MAX, DBL_MAX, DBL_MAX), high(-DBL_MAX, -DBL_MAX, -DBL_MAX);
+    if (const auto *detector = dynamic_cast<const DetectorConstruction *>(
+        G4RunManager::GetRunManager()->GetUserDetectorConstruction())) {
+        for (const auto &mesh: detector->GetMeshes()) {
+            G4ThreeVector pMin, pMax;
+            mesh.solid->BoundingLimits(pMin, pMax);
+            low = G4ThreeVector(std::min(low.x(), pMin.x()), std::min(low.y(), pMin.y()), std::min(low.z(), pMin.z()));
+            high = G4ThreeVector(std::max(high.x(), pMax.x()), std::max(high.y(), pMax.y()),
+                                 std::max(high.z(), pMax.z()));
+        }
+    }
+    const G4bool haveMeshes = low.x() <= high.x();
+    tomographyAxisPoint = tomography.HasAxisPoint() || !haveMeshes ? tomography.GetAxisPoint() : 0.5 * (low + high);
+    if (!haveMeshes || G4Threading::G4GetThreadId() > 0) return;
+
+    // The source plane turns on a circle about the axis: it must stay outside the meshes at every angle
+    const G4double sourceDistance = beamStartZ - tomographyAxisPoint.z();
+    G4double meshRadius = 0.0;
+    for (G4int corner = 0; corner < 8; ++corner) {
+        const G4ThreeVector point(corner & 1 ? high.x() : low.x(), corner & 2 ? high.y() : low.y(),
+                                  corner & 4 ? high.z() : low.z());
+        meshRadius = std::max(meshRadius, (point - tomographyAxisPoint).perp(tomography.GetAxis()));
+    }
+    G4cout << "PrimaryGeneratorAction: scan axis through " << tomographyAxisPoint / mm << " mm" << G4endl;
+    if (meshRadius > sourceDistance) {
+        G4cout << "PrimaryGeneratorAction: WARNING - the meshes reach " << meshRadius / mm
+                << " mm from the scan axis, but the source plane is only " << sourceDistance / mm
+                << " mm away; at some angles the beam starts inside the meshes" << G4endl;
+    }
+}
 
-    fParticleGun->SetParticlePosition(G4ThreeVector(x, y, z));
-    fParticleGun->SetParticleMomentumDirection(G4ThreeVector(0., 0., -1.));
+void PrimaryGeneratorAction::GeneratePhaseSpacePrimaries(G4Event *event, const std::int64_t history) {
+    const PhaseSpaceFile::Record *records = phaseSpace->GetRecords();
+    const std::uint64_t nRecords = phaseSpace->GetHeader().nRecords;
+
+    if (history >= 0) {
+        // Index of the history starts, shared by all threads (none if every record starts a history)
+        const std::vector<std::uint64_t> &starts = phaseSpace->GetHistoryStarts();
+        const std::uint64_t nHistories = starts.empty() ? nRecords : static_cast<std::uint64_t>(starts.size());
+        const std::uint64_t index = static_cast<std::uint64_t>(history) % nHistories;
+        phaseSpaceCursor = starts.empty() ? index : starts[index];
+        phaseSpaceEnd = nRecords;
+        phaseSpacePass = static_cast<std::uint64_t>(history) / nHistories;
+        phaseSpaceSliced = false; // a later run without reproducible mode slices again
+    } else {
+        if (!phaseSpaceSliced) {
+            // Contiguous slice per worker; a history belongs to the slice it starts in
+            const G4int nThreads = std::max(1, G4Threading::GetNumberOfRunningWorkerThreads());
+            const G4int thread = std::max(0, G4Threading::G4GetThreadId());
+            const auto findStart = [&](std::uint64_t i) {
+                while (i < nRecords && !(records[i].flags & PhaseSpaceFile::kHistoryStart)) ++i;
+                return i;
+            };
+            phaseSpaceBegin = findStart(nRecords * thread / nThreads);
+            phaseSpaceEnd = findStart(nRecords * (thread + 1) / nThreads);
+            if (phaseSpaceBegin == phaseSpaceEnd) {
+                // More threads than histories: share the whole file
+                phaseSpaceBegin = 0;
+                phaseSpaceEnd = nRecords;
+            }
+            phaseSpaceCursor = phaseSpaceBegin;
+            phaseSpacePass = 0;
+            phaseSpaceSliced = true;
+        }
+
+        if (phaseSpaceCursor >= phaseSpaceEnd) {
+            if (phaseSpacePass == 0) {
+                G4cout << "PrimaryGeneratorAction: phase-space slice exhausted, reusing it cyclically"
+                        << (phaseSpaceJitter > 0.0 ? " with position jitter" : "") << " (events are no longer "
+                        "independent)" << G4endl;
+            }
+            phaseSpaceCursor = phaseSpaceBegin;
+            ++phaseSpacePass;
+        }
+    }
 
-    // Sample energy from polychromatic spectrum
-    const G4double energy = SampleEnergyFromSpectrum();
-    fParticleGun->SetParticleEnergy(energy);
+    // Reused histories are shifted as a whole, the first pass is replayed as recorded
+    G4double dx = 0.0, dy = 0.0;
+    if (phaseSpacePass > 0 && phaseSpaceJitter > 0.0) {
+        dx = (G4UniformRand() - 0.5) * phaseSpaceJitter;
+        dy = (G4UniformRand() - 0.5) * phaseSpaceJitter;
+    }
 
-    fParticleGun->GeneratePrimaryVertex(event);
+    const G4double planeZ = phaseSpace->GetHeader().planeZ * mm;
+    G4ParticleTable *particleTable = G4ParticleTable::GetParticleTable();
+    do {
+        const PhaseSpaceFile::Record &record = records[phaseSpaceCursor++];
+        G4ParticleDefinition *definition = record.pdg == 22
+                                               ? G4Gamma::Definition()
+                                               : particleTable->FindParticle(record.pdg);
+        if (!definition) continue;
+
+        const G4double w2 = std::max(0.0, 1.0 - static_cast<G4double>(record.u) * record.u -
+                                          static_cast<G4double>(record.v) * record.v);
+        auto *particle = new G4PrimaryParticle(definition);
+        particle->SetKineticEnergy(record.energy * MeV);
+        particle->SetMomentumDirection(G4ThreeVector(record.u, record.v, -std::sqrt(w2)));
+        particle->SetWeight(record.weight);
+
+        auto *vertex = new G4PrimaryVertex(G4ThreeVector(record.x * mm + dx, record.y * mm + dy, planeZ), 0.);
+        vertex->SetPrimary(particle);
+        event->AddPrimaryVertex(vertex);
+    } while (phaseSpaceCursor < phaseSpaceEnd && !(records[phaseSpaceCursor].flags & PhaseSpaceFile::kHistoryStart));
 }
@@ -24,6 +24,13 @@
 #include "G4UIcmdWithADoubleAndUnit.hh"
 #include "G4UIcmdWithABool.hh"
 #include "G4UIcmdWithADouble.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWith3Vector.hh"
+#include "G4UIcmdWith3VectorAndUnit.hh"
+#include "G4UIcmdWithoutParameter.hh"
+#include "G4UIparameter.hh"
+#include "G4SystemOfUnits.hh"
+#include <sstream>
 
 PrimaryGeneratorMessenger::PrimaryGeneratorMessenger(PrimaryGeneratorAction *gen)
     : generator(gen) {
@@ -47,13 +54,101 @@ PrimaryGeneratorMessenger::PrimaryGeneratorMessenger(PrimaryGeneratorAction *gen
     monoEnergyCmd->SetGuidance("Set monochromatic energy (e.g. 15.2 keV)");
     monoEnergyCmd->SetParameterName("energy", false);
     monoEnergyCmd->SetDefaultUnit("keV");
+
+    phaseSpaceFileCmd = new G4UIcmdWithAString("/generator/setPhaseSpaceFile", this);
+    phaseSpaceFileCmd->SetGuidance("Replay a phase-space file recorded with /phasespace/record instead of the beam");
+    phaseSpaceFileCmd->SetGuidance("Without a filename the beam is used again");
+    phaseSpaceFileCmd->SetParameterName("filename", true);
+    phaseSpaceFileCmd->SetDefaultValue("");
+
+    phaseSpaceJitterCmd = new G4UIcmdWithADoubleAndUnit("/generator/setPhaseSpaceJitter", this);
+    phaseSpaceJitterCmd->SetGuidance("Full width of the uniform x/y offset applied to reused phase-space histories");
+    phaseSpaceJitterCmd->SetParameterName("jitter", false);
+    phaseSpaceJitterCmd->SetRange("jitter>=0");
+    phaseSpaceJitterCmd->SetDefaultUnit("mm");
+
+    batchSizeCmd = new G4UIcmdWithAnInteger("/generator/setBatchSize", this);
+    batchSizeCmd->SetGuidance("Number of primaries each thread samples in one block (default 1024, 1 = per event)");
+    batchSizeCmd->SetParameterName("n", false);
+    batchSizeCmd->SetRange("n>0");
+
+    photonsPerEventCmd = new G4UIcmdWithAnInteger("/generator/photonsPerEvent", this);
+    photonsPerEventCmd->SetGuidance("Independent source photons per event (default 1); doses stay per source photon");
+    photonsPerEventCmd->SetParameterName("n", false);
+    photonsPerEventCmd->SetRange("n>0");
+
+    samplingCmd = new G4UIcmdWithAString("/generator/setSampling", this);
+    samplingCmd->SetGuidance("Sampling of beam position and energy: pseudo (default) or sobol (randomised quasi-random)");
+    samplingCmd->SetParameterName("mode", false);
+    samplingCmd->SetCandidates("pseudo sobol");
+
+    replicasCmd = new G4UIcmdWithAnInteger("/generator/setQuasiRandomReplicas", this);
+    replicasCmd->SetGuidance("Independently shifted replicas of the quasi-random sequence (default 16)");
+    replicasCmd->SetGuidance("The dose uncertainty is estimated from their spread");
+    replicasCmd->SetParameterName("n", false);
+    replicasCmd->SetRange("n>1");
+
+    quasiRandomSeedCmd = new G4UIcmdWithAnInteger("/generator/setQuasiRandomSeed", this);
+    quasiRandomSeedCmd->SetGuidance("Seed of the random shifts of the quasi-random sequence");
+    quasiRandomSeedCmd->SetParameterName("seed", false);
+
+    tomographyDir = new G4UIdirectory("/generator/tomography/");
+    tomographyDir->SetGuidance("Rotation-averaged dose of a tomographic scan (the beam is rotated about the scan axis)");
+
+    scanCmd = new G4UIcommand("/generator/tomography/setScan", this);
+    scanCmd->SetGuidance("Regular scan: first angle and range in deg, number of projections (0: continuous rotation)");
+    auto *startParam = new G4UIparameter("start", 'd', false);
+    scanCmd->SetParameter(startParam);
+    auto *rangeParam = new G4UIparameter("range", 'd', false);
+    rangeParam->SetParameterRange("range>0");
+    scanCmd->SetParameter(rangeParam);
+    auto *projectionsParam = new G4UIparameter("projections", 'i', true);
+    projectionsParam->SetDefaultValue(0);
+    projectionsParam->SetParameterRange("projections>=0");
+    scanCmd->SetParameter(projectionsParam);
+
+    scheduleFileCmd = new G4UIcmdWithAString("/generator/tomography/setScheduleFile", this);
+    scheduleFileCmd->SetGuidance("Read the scan schedule: one 'angle [exposure]' per line (deg, exposure default 1)");
+    scheduleFileCmd->SetParameterName("filename", false);
+
+    axisCmd = new G4UIcmdWith3Vector("/generator/tomography/setAxis", this);
+    axisCmd->SetGuidance("Direction of the rotation axis (default 0 1 0)");
+    axisCmd->SetParameterName("x", "y", "z", false);
+
+    axisPointCmd = new G4UIcmdWith3VectorAndUnit("/generator/tomography/setAxisPoint", this);
+    axisPointCmd->SetGuidance("A point on the rotation axis (default: centre of the meshes)");
+    axisPointCmd->SetParameterName("x", "y", "z", false);
+    axisPointCmd->SetDefaultUnit("mm");
+
+    sectorsCmd = new G4UIcmdWithAnInteger("/generator/tomography/setSectors", this);
+    sectorsCmd->SetGuidance("Split the dose into n equal angular sectors of the scan (0: no split)");
+    sectorsCmd->SetParameterName("n", false);
+    sectorsCmd->SetRange("n>=0");
+
+    tomographyOffCmd = new G4UIcmdWithoutParameter("/generator/tomography/off", this);
+    tomographyOffCmd->SetGuidance("Back to a fixed specimen");
 }
 
+
 PrimaryGeneratorMessenger::~PrimaryGeneratorMessenger() {
     delete spectrumFileCmd;
     delete photonFluxCmd;
     delete monoCmd;
     delete monoEnergyCmd;
+    delete phaseSpaceFileCmd;
+    delete phaseSpaceJitterCmd;
+    delete batchSizeCmd;
+    delete photonsPerEventCmd;
+    delete samplingCmd;
+    delete replicasCmd;
+    delete quasiRandomSeedCmd;
+    delete scanCmd;
+    delete scheduleFileCmd;
+    delete axisCmd;
+    delete axisPointCmd;
+    delete sectorsCmd;
+    delete tomographyOffCmd;
+    delete tomographyDir;
     delete genDir;
 }
 
@@ -69,5 +164,40 @@ void PrimaryGeneratorMessenger::SetNewValue(G4UIcommand *command, G4String newVa
     } else if (command == monoEnergyCmd) {
         const G4double e = G4UIcmdWithADoubleAndUnit::GetNewDoubleValue(newValue);
         generator->SetMonoEnergy(e);
+    } else if (command == phaseSpaceFileCmd) {
+        generator->SetPhaseSpaceFile(std::string(newValue));
+    } else if (command == phaseSpaceJitterCmd) {
+        generator->SetPhaseSpaceJitter(G4UIcmdWithADoubleAndUnit::GetNewDoubleValue(newValue));
+    } else if (command == batchSizeCmd) {
+        generator->SetBatchSize(G4UIcmdWithAnInteger::GetNewIntValue(newValue));
+    } else if (command == photonsPerEventCmd) {
+        generator->SetPhotonsPerEvent(G4UIcmdWithAnInteger::GetNewIntValue(newValue));
+    } else if (command == samplingCmd) {
+        generator->SetSampling(std::string(newValue));
+    } else if (command == replicasCmd) {
+        generator->SetQuasiRandomReplicas(G4UIcmdWithAnInteger::GetNewIntValue(newValue));
+    } else if (command == quasiRandomSeedCmd) {
+        generator->SetQuasiRandomSeed(G4UIcmdWithAnInteger::GetNewIntValue(newValue));
+    } else if (command == scanCmd) {
+        std::istringstream is(newValue);
+        G4double start = 0.0, range = 0.0;
+        G4int projections = 0;
+        is >> start >> range >> projections;
+        generator->GetTomography().SetRegular(start * deg, range * deg, projections);
+        generator->UpdateTomography();
+    } else if (command == scheduleFileCmd) {
+        if (generator->GetTomography().LoadSchedule(newValue)) generator->UpdateTomography();
+    } else if (command == axisCmd) {
+        generator->GetTomography().SetAxis(G4UIcmdWith3Vector::GetNew3VectorValue(newValue));
+        generator->UpdateTomography();
+    } else if (command == axisPointCmd) {
+        generator->GetTomography().SetAxisPoint(G4UIcmdWith3VectorAndUnit::GetNew3VectorValue(newValue));
+        generator->UpdateTomography();
+    } else if (command == sectorsCmd) {
+        generator->GetTomography().SetSectors(G4UIcmdWithAnInteger::GetNewIntValue(newValue));
+        generator->UpdateTomography();
+    } else if (command == tomographyOffCmd) {
+        generator->GetTomography().Disable();
+        generator->UpdateTomography();
     }
 }
@@ -0,0 +1,66 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "ProfilerMessenger.h"
+#include "StepProfiler.h"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithABool.hh"
+#include "G4UIcmdWithAnInteger.hh"
+
+ProfilerMessenger::ProfilerMessenger() {
+    // The profiler settings are shared by all threads: do not broadcast
+    profileDir = new G4UIdirectory("/profile/", false);
+    profileDir->SetGuidance("Where the tracking time goes, by particle, process and volume");
+
+    stepsCmd = new G4UIcmdWithABool("/profile/steps", this);
+    stepsCmd->SetGuidance("Profile the steps of the next runs and print a hot-spot table at the end of each");
+    stepsCmd->SetParameterName("on", true);
+    stepsCmd->SetDefaultValue(true);
+    stepsCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    sampleIntervalCmd = new G4UIcmdWithAnInteger("/profile/setSampleInterval", this);
+    sampleIntervalCmd->SetGuidance("Number of steps between two timed steps (default 100)");
+    sampleIntervalCmd->SetGuidance("Smaller values give more precise times at a higher overhead.");
+    sampleIntervalCmd->SetParameterName("n", false);
+    sampleIntervalCmd->SetRange("n>=1");
+    sampleIntervalCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    topCmd = new G4UIcmdWithAnInteger("/profile/setTop", this);
+    topCmd->SetGuidance("Number of rows of the hot-spot table (default 25, 0: all)");
+    topCmd->SetParameterName("rows", false);
+    topCmd->SetRange("rows>=0");
+    topCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+ProfilerMessenger::~ProfilerMessenger() {
+    delete stepsCmd;
+    delete sampleIntervalCmd;
+    delete topCmd;
+    delete profileDir;
+}
+
+void ProfilerMessenger::SetNewValue(G4UIcommand *command, G4String newValue) {
+    if (command == stepsCmd) {
+        StepProfiler::SetActive(G4UIcmdWithABool::GetNewBoolValue(newValue));
+    } else if (command == sampleIntervalCmd) {
+        StepProfiler::SetSampleInterval(G4UIcmdWithAnInteger::GetNewIntValue(newValue));
+    } else if (command == topCmd) {
+        StepProfiler::SetTopRows(G4UIcmdWithAnInteger::GetNewIntValue(newValue));
+    }
+}
@@ -0,0 +1,358 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "RayCastDoseEngine.h"
+#include "RayCastMessenger.h"
+#include "DetectorConstruction.h"
+#include "PrimaryGeneratorAction.h"
+#include "SteppingAction.h"
+#include "RunAction.h"
+#include "parameters.h"
+#include "G4RunManager.hh"
+#include "G4EmCalculator.hh"
+#include "G4Gamma.hh"
+#include "G4Material.hh"
+#include "G4NistManager.hh"
+#include "G4TessellatedSolid.hh"
+#include "G4VFacet.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4PhysicalConstants.hh"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <thread>
+
+RayCastDoseEngine::Result RayCastDoseEngine::lastResult;
+
+RayCastDoseEngine::RayCastDoseEngine(const DetectorConstruction *det)
+    : detector(det) {
+    messenger = new RayCastMessenger(this);
+}
+
+RayCastDoseEngine::~RayCastDoseEngine() {
+    delete messenger;
+}
+
+G4double RayCastDoseEngine::ComptonEnergyTransferFraction(const G4double energy) {
+    // Integrate the Klein-Nishina cross section and the electron energy over cos(theta) (Simpson's rule)
+    const G4double k = energy / electron_mass_c2;
+    constexpr int n = 512;
+    G4double sigma = 0.0, sigmaTransfer = 0.0;
+    for (int i = 0; i <= n; ++i) {
+        const G4double cosTheta = -1.0 + 2.0 * i / n;
+        const G4double p = 1.0 / (1.0 + k * (1.0 - cosTheta)); // E'/E
+        const G4double dSigma = p * p * (p + 1.0 / p - 1.0 + cosTheta * cosTheta);
+        const G4double w = i == 0 || i == n ? 1.0 : i % 2 ? 4.0 : 2.0;
+        sigma += w * dSigma;
+        sigmaTransfer += w * dSigma * (1.0 - p);
+    }
+    return sigma > 0.0 ? sigmaTransfer / sigma : 0.0;
+}
+
+RayCastDoseEngine::MeshGrid RayCastDoseEngine::BuildGrid(const G4String &name, const G4TessellatedSolid *solid,
+                                                         G4Material *material) {
+    MeshGrid grid;
+    grid.name = name;
+    grid.material = material;
+
+    const G4int nFacets = solid->GetNumberOfFacets();
+    G4double minX = DBL_MAX, minY = DBL_MAX, maxX = -DBL_MAX, maxY = -DBL_MAX;
+    for (G4int i = 0; i < nFacets; ++i) {
+        const G4VFacet *facet = solid->GetFacet(i);
+        for (G4int j = 0; j < 3; ++j) {
+            const G4ThreeVector v = facet->GetVertex(j);
+            minX = std::min(minX, v.x());
+            maxX = std::max(maxX, v.x());
+            minY = std::min(minY, v.y());
+            maxY = std::max(maxY, v.y());
+        }
+    }
+
+    // Roughly sqrt(nFacets) cells per axis keeps a handful of triangles per cell
+    const G4int nCells = std::max(1, static_cast<G4int>(std::sqrt(static_cast<G4double>(nFacets))));
+    grid.minX = minX;
+    grid.minY = minY;
+    grid.nCellsX = nCells;
+    grid.nCellsY = nCells;
+    grid.cellSizeX = std::max((maxX - minX) / nCells, 1e-9 * mm);
+    grid.cellSizeY = std::max((maxY - minY) / nCells, 1e-9 * mm);
+    grid.cells.resize(static_cast<size_t>(nCells) * nCells);
+
+    for (G4int i = 0; i < nFacets; ++i) {
+        const G4VFacet *facet = solid->GetFacet(i);
+        const G4ThreeVector a = facet->GetVertex(0);
+        const G4ThreeVector b = facet->GetVertex(1);
+        const G4ThreeVector c = facet->GetVertex(2);
+
+        // Projection onto the xy plane; facets parallel to the beam cannot be hit
+        const G4double e1x = b.x() - a.x(), e1y = b.y() - a.y();
+        const G4double e2x = c.x() - a.x(), e2y = c.y() - a.y();
+        const G4double det = e1x * e2y - e1y * e2x;
+        if (std::abs(det) < 1e-18 * mm2) continue;
+
+        const auto cellIndex = [&](const G4double v, const G4double min, const G4double size) {
+            return std::clamp(static_cast<G4int>((v - min) / size), 0, nCells - 1);
+        };
+        const G4int cx0 = cellIndex(std::min({a.x(), b.x(), c.x()}), minX, grid.cellSizeX);
+        const G4int cx1 = cellIndex(std::max({a.x(), b.x(), c.x()}), minX, grid.cellSizeX);
+        const G4int cy0 = cellIndex(std::min({a.y(), b.y(), c.y()}), minY, grid.cellSizeY);
+        const G4int cy1 = cellIndex(std::max({a.y(), b.y(), c.y()}), minY, grid.cellSizeY);
+
+        for (G4int cy = cy0; cy <= cy1; ++cy) {
+            for (G4int cx = cx0; cx <= cx1; ++cx) {
+                CellTriangles &cell = grid.cells[static_cast<size_t>(cy) * nCells + cx];
+                cell.x0.push_back(static_cast<float>(a.x()));
+                cell.y0.push_back(static_cast<float>(a.y()));
+                cell.e1x.push_back(static_cast<float>(e1x));
+                cell.e1y.push_back(static_cast<float>(e1y));
+                cell.e2x.push_back(static_cast<float>(e2x));
+                cell.e2y.push_back(static_cast<float>(e2y));
+                cell.z0.push_back(static_cast<float>(a.z()));
+                cell.dz1.push_back(static_cast<float>(b.z() - a.z()));
+                cell.dz2.push_back(static_cast<float>(c.z() - a.z()));
+                cell.invDet.push_back(static_cast<float>(1.0 / det));
+            }
+        }
+    }
+    return grid;
+}
+
+void RayCastDoseEngine::IntersectRay(const MeshGrid &grid, const G4double x, const G4double y,
+                                     std::vector<G4double> &hitsZ, std::vector<float> &scratch) {
+    hitsZ.clear();
+    const auto cx = static_cast<G4int>(std::floor((x - grid.minX) / grid.cellSizeX));
+    const auto cy = static_cast<G4int>(std::floor((y - grid.minY) / grid.cellSizeY));
+    if (cx < 0 || cy < 0 || cx >= grid.nCellsX || cy >= grid.nCellsY) return;
+
+    const CellTriangles &cell = grid.cells[static_cast<size_t>(cy) * grid.nCellsX + cx];
+    const size_t n = cell.x0.size();
+    scratch.resize(n);
+
+    // Branch-free barycentric test of the ray (x, y, -z) against all triangles of the cell; misses are NaN
+    const auto px = static_cast<float>(x), py = static_cast<float>(y);
+    const float *x0 = cell.x0.data(), *y0 = cell.y0.data();
+    const float *e1x = cell.e1x.data(), *e1y = cell.e1y.data(), *e2x = cell.e2x.data(), *e2y = cell.e2y.data();
+    const float *z0 = cell.z0.data(), *dz1 = cell.dz1.data(), *dz2 = cell.dz2.data(), *invDet = cell.invDet.data();
+    float *out = scratch.data();
+    for (size_t i = 0; i < n; ++i) {
+        const float dx = px - x0[i];
+        const float dy = py - y0[i];
+        const float u = (dx * e2y[i] - dy * e2x[i]) * invDet[i];
+        const float v = (e1x[i] * dy - e1y[i] * dx) * invDet[i];
+        const bool hit = u >= 0.0f && v >= 0.0f && u + v <= 1.0f;
+        out[i] = hit ? z0[i] + u * dz1[i] + v * dz2[i] : std::numeric_limits<float>::quiet_NaN();
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        if (!std::isnan(out[i])) hitsZ.push_back(out[i]);
+    }
+    // Beam travels along -z: order crossings from top to bottom
+    std::sort(hitsZ.begin(), hitsZ.end(), std::greater<>());
+    // Closed meshes give entry/exit pairs; an odd count comes from a ray grazing an edge, drop the last crossing
+    if (hitsZ.size() % 2) hitsZ.pop_back();
+}
+
+void RayCastDoseEngine::Run() {
+    const auto startTime = std::chrono::steady_clock::now();
+
+    const std::vector<DetectorConstruction::MeshInfo> &meshes = detector->GetMeshes();
+    const PrimaryGeneratorAction *generator = PrimaryGeneratorAction::GetMasterInstance();
+    if (meshes.empty() || !generator) {
+        G4cerr << "RayCastDoseEngine: geometry or source not available - run /run/initialize first" << G4endl;
+        return;
+    }
+
+    // Attenuation coefficients need the physics tables: a zero-event run builds them without running events
+    G4RunManager::GetRunManager()->BeamOn(0);
+
+    // Collapse the source spectrum into energy groups. The generator samples uniformly between bin i and i+1 with
+    // the probability of bin i, so each bin is represented by its mid energy (the last bin by its edge).
+    const std::vector<G4double> &binEnergies = generator->GetSpectrumEnergies();
+    const std::vector<G4double> &binProbabilities = generator->GetSpectrumProbabilities();
+    const size_t nBins = binEnergies.size();
+    const size_t nGroups = std::min(nBins, static_cast<size_t>(std::max(1, maxEnergyGroups)));
+    std::vector<G4double> groupEnergies(nGroups, 0.0), groupProbabilities(nGroups, 0.0);
+    for (size_t i = 0; i < nBins; ++i) {
+        const G4double e = i + 1 < nBins ? 0.5 * (binEnergies[i] + binEnergies[i + 1]) : binEnergies[i];
+        const size_t g = i * nGroups / nBins;
+        groupEnergies[g] += binProbabilities[i] * e;
+        groupProbabilities[g] += binProbabilities[i];
+    }
+    for (size_t g = 0; g < nGroups; ++g) {
+        if (groupProbabilities[g] > 0.0) groupEnergies[g] /= groupProbabilities[g];
+    }
+
+    // Material 0 is the world air, the others follow the mesh order
+    std::vector<G4Material *> materials = {G4NistManager::Instance()->FindOrBuildMaterial("G4_AIR")};
+    std::vector<MeshGrid> grids;
+    for (const auto &mesh: meshes) {
+        grids.push_back(BuildGrid(mesh.name, mesh.solid, mesh.material));
+        materials.push_back(mesh.material);
+    }
+    const size_t nMaterials = materials.size();
+
+    // Total attenuation and first-collision energy absorption coefficients per material and group
+    G4EmCalculator calculator;
+    const G4ParticleDefinition *gamma = G4Gamma::Gamma();
+    std::vector<G4double> muTotal(nMaterials * nGroups), muAbsorption(nMaterials * nGroups);
+    for (size_t m = 0; m < nMaterials; ++m) {
+        for (size_t g = 0; g < nGroups; ++g) {
+            const G4double e = groupEnergies[g];
+            if (e <= 0.0) continue;
+            const G4double phot = calculator.ComputeCrossSectionPerVolume(e, gamma, "phot", materials[m]);
+            const G4double compt = calculator.ComputeCrossSectionPerVolume(e, gamma, "compt", materials[m]);
+            const G4double rayl = calculator.ComputeCrossSectionPerVolume(e, gamma, "Rayl", materials[m]);
+            const G4double conv = e > 2 * electron_mass_c2
+                                      ? calculator.ComputeCrossSectionPerVolume(e, gamma, "conv", materials[m])
+                                      : 0.0;
+            muTotal[m * nGroups + g] = phot + compt + rayl + conv;
+            muAbsorption[m * nGroups + g] = phot + compt * ComptonEnergyTransferFraction(e);
+        }
+    }
+
+    // Ray grid over the xy bounding box of all meshes, clipped to the beam
+    G4double minX = DBL_MAX, minY = DBL_MAX, maxX = -DBL_MAX, maxY = -DBL_MAX;
+    for (const auto &grid: grids) {
+        minX = std::min(minX, grid.minX);
+        minY = std::min(minY, grid.minY);
+        maxX = std::max(maxX, grid.minX + grid.nCellsX * grid.cellSizeX);
+        maxY = std::max(maxY, grid.minY + grid.nCellsY * grid.cellSizeY);
+    }
+    minX = std::max(minX, -0.5 * beamSize);
+    minY = std::max(minY, -0.5 * beamSize);
+    maxX = std::min(maxX, 0.5 * beamSize);
+    maxY = std::min(maxY, 0.5 * beamSize);
+    const G4int n = std::max(1, raysPerAxis);
+    const G4double stepX = (maxX - minX) / n;
+    const G4double stepY = (maxY - minY) / n;
+    // Each ray stands for the photons hitting its cell: fraction of the uniformly illuminated beam area
+    const G4double rayWeight = stepX * stepY / beamArea;
+
+    const G4int threads = nThreads > 0 ? nThreads : std::max(1u, std::thread::hardware_concurrency());
+    const size_t nVolumes = grids.size();
+    std::vector<std::vector<G4double> > threadEnergy(threads, std::vector<G4double>(nVolumes, 0.0));
+
+    auto worker = [&](const G4int threadIndex) {
+        std::vector<G4double> &energy = threadEnergy[threadIndex];
+        std::vector<std::vector<G4double> > hits(nVolumes);
+        std::vector<float> scratch;
+        std::vector<G4double> boundaries;
+        struct Segment {
+            size_t material;
+            G4double length;
+        };
+        std::vector<Segment> segments;
+
+        for (G4int iy = threadIndex; iy < n; iy += threads) {
+            const G4double y = minY + (iy + 0.5) * stepY;
+            for (G4int ix = 0; ix < n; ++ix) {
+                const G4double x = minX + (ix + 0.5) * stepX;
+
+                boundaries.clear();
+                for (size_t v = 0; v < nVolumes; ++v) {
+                    IntersectRay(grids[v], x, y, hits[v], scratch);
+                    boundaries.insert(boundaries.end(), hits[v].begin(), hits[v].end());
+                }
+                if (boundaries.empty()) continue;
+                boundaries.push_back(beamStartZ);
+                std::sort(boundaries.begin(), boundaries.end(), std::greater<>());
+
+                // Split the ray at every mesh boundary; the first mesh containing a segment owns it
+                segments.clear();
+                for (size_t b = 0; b + 1 < boundaries.size(); ++b) {
+                    const G4double top = boundaries[b], bottom = boundaries[b + 1];
+                    if (top > beamStartZ || top - bottom <= 0.0) continue;
+                    const G4double mid = 0.5 * (top + bottom);
+                    size_t material = 0;
+                    for (size_t v = 0; v < nVolumes && material == 0; ++v) {
+                        const std::vector<G4double> &z = hits[v];
+                        for (size_t h = 0; h + 1 < z.size(); h += 2) {
+                            if (mid <= z[h] && mid >= z[h + 1]) {
+                                material = v + 1;
+                                break;
+                            }
+                        }
+                    }
+                    segments.push_back({material, top - bottom});
+                }
+
+                for (size_t g = 0; g < nGroups; ++g) {
+                    const G4double photonEnergy = rayWeight * groupProbabilities[g] * groupEnergies[g];
+                    G4double opticalDepth = 0.0;
+                    for (const auto &[material, length]: segments) {
+                        const G4double mu = muTotal[material * nGroups + g];
+                        if (mu <= 0.0) continue;
+                        if (material > 0) {
+                            const G4double interacting = std::exp(-opticalDepth) * -std::expm1(-mu * length);
+                            energy[material - 1] += photonEnergy * muAbsorption[material * nGroups + g] / mu *
+                                    interacting;
+                        }
+                        opticalDepth += mu * length;
+                    }
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (G4int t = 0; t < threads; ++t) pool.emplace_back(worker, t);
+    for (auto &thread: pool) thread.join();
+
+    // Dose per incident photon
+    const auto &volumeMap = SteppingAction::getVolumeMap();
+    lastResult = Result();
+    lastResult.insect = detector->GetSelectedInsect();
+    lastResult.source = generator->IsMonochromatic()
+                            ? "mono " + std::to_string(generator->GetMonoEnergy() / keV) + " keV"
+                            : "spectrum '" + generator->GetSpectrumFilename() + "'";
+
+    std::ofstream outFile("raycast_" + lastResult.insect + ".txt");
+    outFile << "Primary (first-collision) dose, " << lastResult.source << ", " << n << "x" << n << " rays, "
+            << nGroups << " energy groups\n";
+    outFile << std::setw(20) << "Volume Name" << std::setw(20) << "Energy/photon (MeV)"
+            << std::setw(20) << "Dose/photon (Gy)" << "\n";
+
+    G4cout << "\n========================================" << G4endl;
+    G4cout << "Ray-cast primary dose (" << lastResult.source << ")" << G4endl;
+    G4cout << "========================================" << G4endl;
+    for (size_t v = 0; v < nVolumes; ++v) {
+        G4double energy = 0.0;
+        for (const auto &e: threadEnergy) energy += e[v];
+
+        // Same mass convention as the Monte Carlo dose summary in RunAction
+        G4double dose = 0.0;
+        if (const auto it = volumeMap.find(grids[v].name); it != volumeMap.end()) {
+            const G4double mass = it->second / mm3 * RunAction::VolumeDensity(grids[v].name); // g
+            if (mass > 0.0) dose = energy / MeV * 1.602e-10 / mass;
+        }
+        lastResult.dosePerPhoton[grids[v].name] = dose;
+
+        G4cout << std::setw(20) << grids[v].name << std::setw(20) << energy / MeV << std::setw(20) << dose << G4endl;
+        outFile << std::setw(20) << grids[v].name << std::setw(20) << energy / MeV << std::setw(20) << dose << "\n";
+    }
+
+    const G4double seconds = std::chrono::duration<G4double>(std::chrono::steady_clock::now() - startTime).count();
+    G4cout << "Ray casting with " << threads << " threads took " << seconds << " s" << G4endl;
+    G4cout << "========================================\n" << G4endl;
+}
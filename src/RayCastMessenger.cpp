@@ -0,0 +1,70 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "RayCastMessenger.h"
+#include "RayCastDoseEngine.h"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithoutParameter.hh"
+#include "G4UIcmdWithAnInteger.hh"
+
+RayCastMessenger::RayCastMessenger(RayCastDoseEngine *engine)
+    : engine(engine) {
+    // The engine lives on the master only: do not broadcast these commands to the workers
+    rayCastDir = new G4UIdirectory("/raycast/", false);
+    rayCastDir->SetGuidance("Deterministic primary-photon dose engine");
+
+    runCmd = new G4UIcmdWithoutParameter("/raycast/run", this);
+    runCmd->SetGuidance("Compute the primary (first-collision) dose for the current geometry and source");
+    runCmd->AvailableForStates(G4State_Idle);
+
+    raysPerAxisCmd = new G4UIcmdWithAnInteger("/raycast/setRaysPerAxis", this);
+    raysPerAxisCmd->SetGuidance("Number of rays along x and y over the mesh bounding box (default 512)");
+    raysPerAxisCmd->SetParameterName("n", false);
+    raysPerAxisCmd->SetRange("n>0");
+
+    threadsCmd = new G4UIcmdWithAnInteger("/raycast/setThreads", this);
+    threadsCmd->SetGuidance("Number of threads for ray casting (0 = all hardware threads)");
+    threadsCmd->SetParameterName("n", false);
+    threadsCmd->SetRange("n>=0");
+
+    energyGroupsCmd = new G4UIcmdWithAnInteger("/raycast/setEnergyGroups", this);
+    energyGroupsCmd->SetGuidance("Maximum number of energy groups the source spectrum is collapsed to (default 128)");
+    energyGroupsCmd->SetParameterName("n", false);
+    energyGroupsCmd->SetRange("n>0");
+}
+
+RayCastMessenger::~RayCastMessenger() {
+    delete runCmd;
+    delete raysPerAxisCmd;
+    delete threadsCmd;
+    delete energyGroupsCmd;
+    delete rayCastDir;
+}
+
+void RayCastMessenger::SetNewValue(G4UIcommand *command, G4String newValue) {
+    if (command == runCmd) {
+        engine->Run();
+    } else if (command == raysPerAxisCmd) {
+        engine->SetRaysPerAxis(G4UIcmdWithAnInteger::GetNewIntValue(newValue));
+    } else if (command == threadsCmd) {
+        engine->SetNumberOfThreads(G4UIcmdWithAnInteger::GetNewIntValue(newValue));
+    } else if (command == energyGroupsCmd) {
+        engine->SetMaxEnergyGroups(G4UIcmdWithAnInteger::GetNewIntValue(newValue));
+    }
+}
@@ -0,0 +1,291 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "ResponseMatrix.h"
+#include "ResponseMessenger.h"
+#include "RunAction.h"
+#include "ScopedRunSettings.h"
+#include "PrimaryGeneratorAction.h"
+#include "DetectorConstruction.h"
+#include "Spectrum.h"
+#include "parameters.h"
+#include "G4UImanager.hh"
+#include "G4RunManager.hh"
+#include "G4SystemOfUnits.hh"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    constexpr char kMagic[8] = {'I', 'D', 'S', 'R', 'E', 'S', 'P', '1'};
+    constexpr std::uint32_t kVersion = 1;
+
+    template<typename T>
+    void Put(std::ostream &out, const T &value) { out.write(reinterpret_cast<const char *>(&value), sizeof(T)); }
+
+    void PutString(std::ostream &out, const std::string &value) {
+        Put(out, static_cast<std::uint64_t>(value.size()));
+        out.write(value.data(), static_cast<std::streamsize>(value.size()));
+    }
+
+    void PutVector(std::ostream &out, const std::vector<G4double> &values) {
+        Put(out, static_cast<std::uint64_t>(values.size()));
+        out.write(reinterpret_cast<const char *>(values.data()),
+                  static_cast<std::streamsize>(values.size() * sizeof(G4double)));
+    }
+
+    template<typename T>
+    bool Get(std::istream &in, T &value) {
+        return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(T)));
+    }
+
+    bool GetString(std::istream &in, std::string &value) {
+        std::uint64_t size = 0;
+        if (!Get(in, size) || size > (1u << 20)) return false;
+        value.resize(size);
+        return static_cast<bool>(in.read(value.data(), static_cast<std::streamsize>(size)));
+    }
+
+    bool GetVector(std::istream &in, std::vector<G4double> &values) {
+        std::uint64_t size = 0;
+        if (!Get(in, size) || size > (1u << 24)) return false;
+        values.resize(size);
+        return static_cast<bool>(in.read(reinterpret_cast<char *>(values.data()),
+                                         static_cast<std::streamsize>(size * sizeof(G4double))));
+    }
+}
+
+ResponseMatrix::ResponseMatrix() {
+    messenger = new ResponseMessenger(this);
+}
+
+ResponseMatrix::~ResponseMatrix() {
+    delete messenger;
+}
+
+void ResponseMatrix::SetEnergies(const G4double min, const G4double max, const G4int n) {
+    minEnergy = min;
+    maxEnergy = max;
+    nEnergies = n;
+}
+
+void ResponseMatrix::Build(const std::string &filename) {
+    const PrimaryGeneratorAction *generator = PrimaryGeneratorAction::GetMasterInstance();
+    const auto *detector = dynamic_cast<const DetectorConstruction *>(
+        G4RunManager::GetRunManager()->GetUserDetectorConstruction());
+    if (!generator || !detector) {
+        G4cerr << "ResponseMatrix: initialise the run manager first" << G4endl;
+        return;
+    }
+
+    // Default range: the current spectrum file
+    G4double low = minEnergy, high = maxEnergy;
+    if (high <= 0.0) {
+        try {
+            const auto spectrum = Spectrum::FromFile(generator->GetSpectrumFilename());
+            low = spectrum->GetEnergies().front();
+            high = spectrum->GetEnergies().back();
+        } catch (const std::runtime_error &) {
+            G4cerr << "ResponseMatrix: set the energies with /response/setEnergies (no spectrum file)" << G4endl;
+            return;
+        }
+    }
+    if (nEnergies < 2 || high <= low || low <= 0.0) {
+        G4cerr << "ResponseMatrix: need at least two energies in a positive range" << G4endl;
+        return;
+    }
+
+    Table table;
+    table.insect = detector->GetSelectedInsect();
+    table.eventsPerEnergy = events;
+    for (G4int i = 0; i < nEnergies; ++i) table.energies.push_back(low + (high - low) * i / (nEnergies - 1));
+    const std::string file = filename.empty() ? "response_" + table.insect + ".bin" : filename;
+
+    // Restored at the end; tables for the whole grid at once
+    const G4bool wasMonochromatic = generator->IsMonochromatic();
+    const G4double monoEnergy = generator->GetMonoEnergy();
+    const ScopedRunSettings runSettings(high);
+
+    G4UImanager *uiManager = G4UImanager::GetUIpointer();
+
+    G4cout << "ResponseMatrix: " << nEnergies << " runs of " << events << " events from " << low / keV << " to "
+            << high / keV << " keV for " << table.insect << G4endl;
+    uiManager->ApplyCommand("/generator/setMonochromatic true");
+    G4bool ok = true;
+    for (std::size_t i = 0; ok && i < table.energies.size(); ++i) {
+        std::ostringstream setEnergy, label;
+        setEnergy << std::setprecision(10) << "/generator/setMonoEnergy " << table.energies[i] / keV << " keV";
+        label << "_response_" << table.energies[i] / keV << "keV";
+        if (uiManager->ApplyCommand(setEnergy.str()) != 0 || !runSettings.BeamOn(events, label.str()) ||
+            RunAction::GetLastSummary().insect != table.insect) {
+            G4cerr << "ResponseMatrix: the run at " << table.energies[i] / keV << " keV gave no result" << G4endl;
+            ok = false;
+            break;
+        }
+        const RunAction::Summary &summary = RunAction::GetLastSummary();
+        if (i == 0) {
+            for (const auto &[volume, result]: summary.volumes) table.volumes.push_back(volume);
+            table.dose.assign(table.volumes.size(), std::vector<G4double>(table.energies.size(), 0.0));
+            table.error = table.dose;
+        }
+        for (std::size_t v = 0; v < table.volumes.size(); ++v) {
+            const auto it = summary.volumes.find(table.volumes[v]);
+            if (it == summary.volumes.end()) continue;
+            table.dose[v][i] = it->second.dosePerEvent;
+            table.error[v][i] = it->second.relError * it->second.dosePerEvent;
+        }
+    }
+
+    std::ostringstream restoreEnergy;
+    restoreEnergy << std::setprecision(10) << "/generator/setMonoEnergy " << monoEnergy / keV << " keV";
+    uiManager->ApplyCommand(restoreEnergy.str());
+    if (!wasMonochromatic) uiManager->ApplyCommand("/generator/setMonochromatic false");
+
+    if (ok && Write(file, table)) G4cout << "ResponseMatrix: response written to '" << file << "'" << G4endl;
+}
+
+G4bool ResponseMatrix::Write(const std::string &filename, const Table &table) {
+    std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+    out.write(kMagic, sizeof(kMagic));
+    Put(out, kVersion);
+    PutString(out, table.insect);
+    Put(out, static_cast<std::int32_t>(table.eventsPerEnergy));
+    PutVector(out, table.energies);
+    Put(out, static_cast<std::uint64_t>(table.volumes.size()));
+    for (std::size_t v = 0; v < table.volumes.size(); ++v) {
+        PutString(out, table.volumes[v]);
+        PutVector(out, table.dose[v]);
+        PutVector(out, table.error[v]);
+    }
+    if (!out) G4cerr << "ResponseMatrix: cannot write '" << filename << "'" << G4endl;
+    return static_cast<bool>(out);
+}
+
+G4bool ResponseMatrix::Read(const std::string &filename, Table &table) {
+    std::ifstream in(filename, std::ios::binary);
+    char magic[sizeof(kMagic)] = {};
+    std::uint32_t version = 0;
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 || !Get(in, version) ||
+        version != kVersion) {
+        G4cerr << "ResponseMatrix: '" << filename << "' is not a response file of this version" << G4endl;
+        return false;
+    }
+    table = Table{};
+    std::int32_t eventsPerEnergy = 0;
+    std::uint64_t nVolumes = 0;
+    bool ok = GetString(in, table.insect) && Get(in, eventsPerEnergy) && GetVector(in, table.energies) &&
+              !table.energies.empty() && Get(in, nVolumes) && nVolumes < (1u << 16);
+    for (std::uint64_t v = 0; ok && v < nVolumes; ++v) {
+        std::string volume;
+        std::vector<G4double> dose, error;
+        ok = GetString(in, volume) && GetVector(in, dose) && GetVector(in, error) &&
+             dose.size() == table.energies.size() && error.size() == dose.size();
+        table.volumes.push_back(volume);
+        table.dose.push_back(dose);
+        table.error.push_back(error);
+    }
+    if (!ok) {
+        G4cerr << "ResponseMatrix: '" << filename << "' is truncated" << G4endl;
+        return false;
+    }
+    table.eventsPerEnergy = eventsPerEnergy;
+    return true;
+}
+
+std::vector<ResponseMatrix::Folded> ResponseMatrix::Fold(const Table &table, const std::vector<G4double> &energies,
+                                                         const std::vector<G4double> &probabilities,
+                                                         const G4double photonsPerSecond, G4double &outside) {
+    // Weight of every grid energy: linear interpolation between the two neighbours of each spectrum line
+    const std::vector<G4double> &grid = table.energies;
+    std::vector<G4double> weights(grid.size(), 0.0);
+    outside = 0.0;
+    for (std::size_t k = 0; k < energies.size() && k < probabilities.size(); ++k) {
+        const G4double energy = energies[k], probability = probabilities[k];
+        if (energy <= grid.front() || energy >= grid.back()) {
+            weights[energy <= grid.front() ? 0 : grid.size() - 1] += probability;
+            if (energy < grid.front() || energy > grid.back()) outside += probability;
+            continue;
+        }
+        const auto upper = static_cast<std::size_t>(std::upper_bound(grid.begin(), grid.end(), energy) - grid.begin());
+        const G4double t = (energy - grid[upper - 1]) / (grid[upper] - grid[upper - 1]);
+        weights[upper - 1] += probability * (1.0 - t);
+        weights[upper] += probability * t;
+    }
+
+    // The grid runs are independent: their variances add with the squared weights
+    std::vector<Folded> folded;
+    for (std::size_t v = 0; v < table.volumes.size(); ++v) {
+        G4double dose = 0.0, variance = 0.0;
+        for (std::size_t i = 0; i < grid.size(); ++i) {
+            dose += weights[i] * table.dose[v][i];
+            variance += weights[i] * weights[i] * table.error[v][i] * table.error[v][i];
+        }
+        folded.push_back(Folded{table.volumes[v], dose, dose * photonsPerSecond,
+                                dose > 0.0 ? std::sqrt(variance) / dose : 0.0});
+    }
+    return folded;
+}
+
+G4int ResponseMatrix::FoldFiles(const std::string &responseFile, const std::string &spectrumFile,
+                                const G4double photonFlux, const std::string &outputFile) {
+    const auto start = std::chrono::steady_clock::now();
+    Table table;
+    if (!Read(responseFile, table)) return 1;
+    std::shared_ptr<const Spectrum> spectrum;
+    try {
+        spectrum = Spectrum::FromFile(spectrumFile);
+    } catch (const std::runtime_error &) {
+        return 1;
+    }
+    G4double outside = 0.0;
+    const std::vector<Folded> folded = Fold(table, spectrum->GetEnergies(), spectrum->GetProbabilities(),
+                                            photonFlux * beamArea, outside);
+    const G4double milliseconds = std::chrono::duration<G4double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+
+    std::ostringstream report;
+    report << "Response " << responseFile << " (" << table.insect << ", " << table.energies.size() << " energies "
+            << table.energies.front() / keV << "-" << table.energies.back() / keV << " keV, "
+            << table.eventsPerEnergy << " events each)\n"
+            << "Spectrum " << spectrum->GetDescription() << ", photon flux " << photonFlux << " photons/s/mm2\n";
+    if (outside > 0.0) {
+        report << "Warning: " << 100.0 * outside << " % of the spectrum lies outside the response energies "
+                << "(taken at the nearest one)\n";
+    }
+    report << std::setw(20) << "Volume Name" << std::setw(22) << "Dose per photon (Gy)" << std::setw(20)
+            << "Dose rate (Gy/s)" << std::setw(15) << "Rel. error" << "\n";
+    for (const Folded &result: folded) {
+        report << std::setw(20) << result.volume << std::setw(22) << result.dosePerPhoton << std::setw(20)
+                << result.doseRate << std::setw(15) << result.relError << "\n";
+    }
+    G4cout << report.str() << "Folded in " << milliseconds << " ms" << G4endl;
+
+    if (!outputFile.empty()) {
+        std::ofstream out(outputFile);
+        out << report.str();
+        G4cout << "Results saved to " << outputFile << G4endl;
+    }
+    return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "ResponseMessenger.h"
+#include "ResponseMatrix.h"
+#include "PrimaryGeneratorAction.h"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UnitsTable.hh"
+#include "G4SystemOfUnits.hh"
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    std::vector<std::string> SplitWords(const G4String &value) {
+        std::istringstream is(value);
+        std::vector<std::string> words;
+        for (std::string word; is >> word;) words.push_back(word);
+        return words;
+    }
+}
+
+ResponseMessenger::ResponseMessenger(ResponseMatrix *matrix)
+    : matrix(matrix) {
+    // The response runs are driven from the master: do not broadcast these commands to the workers
+    responseDir = new G4UIdirectory("/response/", false);
+    responseDir->SetGuidance("Energy-response matrix (dose per photon on an energy grid) and spectrum folding");
+
+    energiesCmd = new G4UIcmdWithAString("/response/setEnergies", this);
+    energiesCmd->SetGuidance("Energy grid: <min> <max> <n> [unit], n energies evenly spaced (unit default keV)");
+    energiesCmd->SetGuidance("Default: 50 energies over the range of the current spectrum file");
+    energiesCmd->SetParameterName("grid", false);
+
+    eventsCmd = new G4UIcmdWithAnInteger("/response/setEvents", this);
+    eventsCmd->SetGuidance("Events per grid energy (default 100000)");
+    eventsCmd->SetParameterName("n", false);
+    eventsCmd->SetRange("n>0");
+
+    buildCmd = new G4UIcmdWithAString("/response/build", this);
+    buildCmd->SetGuidance("Run every grid energy for the current insect and write the response file");
+    buildCmd->SetGuidance("(default name response_<insect>.bin)");
+    buildCmd->SetParameterName("file", true);
+    buildCmd->SetDefaultValue("");
+    buildCmd->AvailableForStates(G4State_Idle);
+
+    foldCmd = new G4UIcmdWithAString("/response/fold", this);
+    foldCmd->SetGuidance("Dose and dose rate of a spectrum from a response file: <response file> [spectrum file]");
+    foldCmd->SetGuidance("Default spectrum: the current spectrum file; the flux is /generator/setPhotonFlux.");
+    foldCmd->SetGuidance("Writes fold_<response>_<spectrum>.txt");
+    foldCmd->SetParameterName("files", false);
+}
+
+ResponseMessenger::~ResponseMessenger() {
+    delete energiesCmd;
+    delete eventsCmd;
+    delete buildCmd;
+    delete foldCmd;
+    delete responseDir;
+}
+
+void ResponseMessenger::SetNewValue(G4UIcommand *command, G4String newValue) {
+    if (command == energiesCmd) {
+        std::vector<std::string> words = SplitWords(newValue);
+        G4double unit = keV;
+        if (words.size() == 4 && G4UnitDefinition::IsUnitDefined(words.back())) {
+            unit = G4UnitDefinition::GetValueOf(words.back());
+            words.pop_back();
+        }
+        try {
+            if (words.size() != 3) throw std::invalid_argument("grid");
+            matrix->SetEnergies(std::stod(words[0]) * unit, std::stod(words[1]) * unit, std::stoi(words[2]));
+        } catch (const std::exception &) {
+            G4cerr << "ResponseMessenger: expected <min> <max> <n> [unit], got '" << newValue << "'" << G4endl;
+        }
+    } else if (command == eventsCmd) {
+        matrix->SetEvents(G4UIcmdWithAnInteger::GetNewIntValue(newValue));
+    } else if (command == buildCmd) {
+        matrix->Build(newValue);
+    } else if (command == foldCmd) {
+        const std::vector<std::string> words = SplitWords(newValue);
+        if (words.empty() || words.size() > 2) {
+            G4cerr << "ResponseMessenger: expected <response file> [spectrum file]" << G4endl;
+            return;
+        }
+        const PrimaryGeneratorAction *generator = PrimaryGeneratorAction::GetMasterInstance();
+        const std::string spectrum = words.size() > 1 ? words[1] : generator ? generator->GetSpectrumFilename() : "";
+        const std::string output = "fold_" + std::filesystem::path(words[0]).stem().string() + "_" +
+                                   (spectrum.empty() ? "spectrum" : std::filesystem::path(spectrum).stem().string())
+                                   + ".txt";
+        ResponseMatrix::FoldFiles(words[0], spectrum, PrimaryGeneratorAction::GetPhotonFlux(), output);
+    }
+}
@@ -24,12 +24,30 @@
 #include "G4RunManager.hh"
 #include "G4Run.hh"
 #include "G4SystemOfUnits.hh"
+#include "Randomize.hh"
 #include <fstream>
 #include <iomanip>
 #include "parameters.h"
+#include <algorithm>
 #include <cmath>
+#include <ctime>
+#include <numeric>
 
 #include "PrimaryGeneratorAction.h"
+#include "PhysicsList.h"
+#include "RayCastDoseEngine.h"
+#include "SensitivityAnalysis.h"
+#include "PhaseSpaceRecorder.h"
+#include "PartitionedRun.h"
+#include "Checkpoint.h"
+#include "RunTelemetry.h"
+#include "StepProfiler.h"
+#include "ImportanceBiasing.h"
+#include "MemoryReport.h"
+
+RunAction::Summary RunAction::lastSummary;
+G4bool RunAction::reproducible = false;
+long RunAction::eventSeedKey[2] = {0, 0};
 
 RunAction::RunAction()
 {
@@ -41,21 +59,82 @@ RunAction::~RunAction() {
 }
 
 void RunAction::BeginOfRunAction(const G4Run *run) {
-    SteppingAction::getDoseMap().clear();
+    SteppingAction::ClearTallies(IsMaster());
+    SensitivityAnalysis::ClearTallies(IsMaster());
+    StepProfiler::BeginOfRun(IsMaster());
+    // Importances changed since the last run (e.g. by a pilot) reach the store of every thread
+    ImportanceBiasing::BeginOfRun();
+
+    runStart = std::chrono::steady_clock::now();
+    cpuStart = std::clock();
+
+    // Physics tables exist now: keep them for later starts. The master starts its run before the workers, so
+    // the sensitivity tables are ready when they start tracking.
+    if (IsMaster()) {
+        MemoryReport::BeginOfRun();
+        if (PhysicsList *physicsList = PhysicsList::GetInstance()) physicsList->StoreTablesIfNeeded();
+        SensitivityAnalysis::BeginOfRun();
+        PhaseSpaceRecorder::BeginOfRun();
+        PartitionedRun::BeginOfRun();
+    }
+    // After the partition stream is derived, and after the clear (a loaded checkpoint adds its accumulators)
+    Checkpoint::BeginOfRun(run, IsMaster());
+    RunTelemetry::BeginOfRun(IsMaster(), run->GetNumberOfEventToBeProcessed());
+
+    // The event seeds follow from the master stream, so partitions and checkpoint segments stay independent
+    if (IsMaster() && reproducible) {
+        CLHEP::HepRandomEngine *engine = G4Random::getTheEngine();
+        eventSeedKey[0] = static_cast<long>(engine->flat() * 2147483647.0);
+        eventSeedKey[1] = static_cast<long>(engine->flat() * 2147483647.0);
+    }
+}
+
+void RunAction::SeedEvent(const G4int eventID) {
+    const G4int runID = G4RunManager::GetRunManager()->GetCurrentRun()->GetRunID();
+    const long seeds[4] = {eventSeedKey[0], eventSeedKey[1], static_cast<long>(runID), static_cast<long>(eventID)};
+    G4Random::getTheEngine()->setSeeds(seeds, 4);
 }
 
 void RunAction::EndOfRunAction(const G4Run *run) {
+    // Workers hand their tallies to the master, which ends its run after all of them and writes the results
+    RunTelemetry::EndOfRun(IsMaster());
+    if (const auto *threadGenerator = dynamic_cast<const PrimaryGeneratorAction *>(
+        G4RunManager::GetRunManager()->GetUserPrimaryGeneratorAction())) {
+        // Before the merge empties the tallies of the thread
+        MemoryReport::RecordThread(threadGenerator->GetThreadFootprint(), SteppingAction::GetThreadFootprint());
+    }
+    SteppingAction::MergeThreadTallies();
+    SensitivityAnalysis::MergeThreadTallies();
+    StepProfiler::MergeThreadTable();
+    ImportanceBiasing::MergeThreadTally();
+    PhaseSpaceRecorder::EndOfRun(IsMaster(), run->GetNumberOfEvent());
+    if (!IsMaster()) return;
+    MemoryReport::EndOfRun(SteppingAction::GetSharedFootprint());
 
-    G4int nEvents = run->GetNumberOfEvent();
+    // A continued checkpoint brings the events of the earlier segments with its accumulators
+    const G4int runEvents = run->GetNumberOfEvent();
+    const G4long nEvents = runEvents + Checkpoint::GetBaseEvents();
+    Checkpoint::EndOfRun(nEvents);
 
+    if (runEvents == 0) return;
 
-    if (nEvents == 0) return;
+    const G4double wallTime = std::chrono::duration<G4double>(std::chrono::steady_clock::now() - runStart).count();
+    const G4double eventsPerSecond = wallTime > 0.0 ? runEvents / wallTime : 0.0;
+    const PhysicsList *physicsList = PhysicsList::GetInstance();
+    const std::string preset = physicsList ? physicsList->GetPreset() : "";
+    const PrimaryGeneratorAction *generator = PrimaryGeneratorAction::GetMasterInstance();
+    const std::string sampling = generator ? generator->GetSampling() : "pseudo";
 
 
     G4double photonFlux = PrimaryGeneratorAction::GetPhotonFlux(); // photons/s/mm2
 
+    // Doses are normalised per source photon (a phase-space replay event stands for more than one)
+    const G4double sourcePhotons = nEvents * PrimaryGeneratorAction::GetSourcePhotonsPerEvent();
+
     // Get dose map from SteppingAction
     auto &doseMap = SteppingAction::getDoseMap();
+    auto &doseSquaredMap = SteppingAction::getDoseSquaredMap();
+    auto &replicaDoseMap = SteppingAction::getReplicaDoseMap();
     auto &volumeMap = SteppingAction::getVolumeMap();
 
     // Calculate and print dose for each volume
@@ -71,21 +150,28 @@ void RunAction::EndOfRunAction(const G4Run *run) {
     // Open output file with insect name
     std::ostringstream fileName;
     // Use configurable prefix from header
-    fileName << outputPrefix << insectName << ".txt";
+    fileName << outputPrefix << insectName << outputSuffix << ".txt";
     std::ofstream outFile(fileName.str());
 
     // Photon flux (photons / s / mm^2) - from notes
 
     outFile << "Number of events: " << nEvents << "\n";
+    if (sourcePhotons != static_cast<G4double>(nEvents)) outFile << "Source photons: " << sourcePhotons << "\n";
     outFile << "Photon flux: " << photonFlux << " photons/s/mm2\n";
+    outFile << "Physics preset: " << preset << "\n";
+    outFile << "Source sampling: " << sampling << "\n";
+    if (reproducible) outFile << "Reproducible mode: on\n";
+    outFile << "Wall time: " << wallTime << " s\n";
+    outFile << "Events per second: " << eventsPerSecond << "\n";
     outFile << "========================================\n";
     outFile << std::setw(20) << "Volume Name"
             << std::setw(15) << "Volume (mm3)"
             << std::setw(15) << "Density (g/cm3)"
             << std::setw(20) << "Energy Dep (MeV)"
             << std::setw(20) << "Dose (Gy)"
-            << std::setw(20) << "Dose per event (Gy)"
+            << std::setw(20) << "Dose per photon (Gy)"
             << std::setw(20) << "Dose rate (Gy/s) with 100mA"
+            << std::setw(15) << "Rel. error"
             << "\n";
     outFile << "========================================\n";
 
@@ -94,18 +180,27 @@ void RunAction::EndOfRunAction(const G4Run *run) {
     G4double beamArea_mm2 = beamArea; // area in mm^2
     G4double photonsPerSecond = photonFlux * beamArea_mm2;
 
+    std::ostringstream jsonVolumes;
+    lastSummary = Summary{insectName, nEvents, wallTime, {}};
+
     // Iterate over all registered volumes so we print zeros too
     for (const auto &[fst, snd]: volumeMap) {
         std::string volName = fst;
         G4double totalEnergyDep = 0.0; // default if no deposition
         if (auto it = doseMap.find(volName); it != doseMap.end()) totalEnergyDep = it->second; // in MeV
 
+        // Relative standard error of the mean from the per-event deposits, or from the spread of the replicas if
+        // the events are quasi-random (not independent)
+        std::vector<G4double> replicaMeans;
+        if (auto it = replicaDoseMap.find(volName); SteppingAction::GetReplicas() > 1 && it != replicaDoseMap.end()) {
+            replicaMeans = ReplicaMeans(it->second, nEvents);
+        }
+        G4double sumSquares = 0.0;
+        if (auto it = doseSquaredMap.find(volName); it != doseSquaredMap.end()) sumSquares = it->second;
+        const G4double relError = RelativeError(totalEnergyDep, sumSquares, nEvents, replicaMeans);
+
         G4double volume = snd; // in mm3
-        G4double density = 0.95e-3; // g/cm3, // Approximate mass in g (assuming density ~ 1 g/cm3)
-        if (volName == "Tube")
-            density = 1.05E-3; // PMMA density ~1.05 g/cm3
-        if (volName == "Ethanol")
-            density = 0.789E-3;
+        G4double density = VolumeDensity(volName);
 
         G4double mass = volume * density;
 
@@ -116,7 +211,7 @@ void RunAction::EndOfRunAction(const G4Run *run) {
         G4double doseRate = 0.0;
         if (mass > 0.0) {
             dose = totalEnergyDep * 1.602e-10 / mass; // in Gy
-            dosePerEvent = dose / nEvents;
+            dosePerEvent = dose / sourcePhotons;
             doseRate = dosePerEvent * photonsPerSecond; // Gy/s
         }
 
@@ -127,6 +222,7 @@ void RunAction::EndOfRunAction(const G4Run *run) {
                 << std::setw(20) << dose
                 << std::setw(20) << dosePerEvent
                 << std::setw(20) << doseRate
+                << std::setw(15) << relError
                 << G4endl;
 
         outFile << std::setw(20) << volName
@@ -136,14 +232,188 @@ void RunAction::EndOfRunAction(const G4Run *run) {
                 << std::setw(20) << dose
                 << std::setw(20) << dosePerEvent
                 << std::setw(20) << doseRate
+                << std::setw(15) << relError
                 << "\n";
+
+        lastSummary.volumes[volName] = VolumeResult{dosePerEvent, doseRate, relError};
+
+        jsonVolumes << (jsonVolumes.tellp() > 0 ? ", " : "") << "\"" << volName << "\": {"
+                << "\"energyDeposit\": " << totalEnergyDep
+                << ", \"dose\": " << dose
+                << ", \"dosePerEvent\": " << dosePerEvent
+                << ", \"doseRate\": " << doseRate
+                << ", \"relError\": " << relError << "}";
     }
 
     G4cout << "========================================\n" << G4endl;
     outFile << "========================================\n";
+
+    // Tomographic scan: contribution of each angular sector to the dose per source photon (sums to the total)
+    if (const G4int sectors = SteppingAction::GetSectors(); sectors > 0 && generator) {
+        auto &sectorDoseMap = SteppingAction::getSectorDoseMap();
+        const TomographyScan &scan = generator->GetTomography();
+        std::ostringstream header;
+        header << std::setw(20) << "Volume Name";
+        for (G4int i = 0; i < sectors; ++i) {
+            std::ostringstream sector;
+            sector << (scan.GetStart() + scan.GetRange() * i / sectors) / deg << "-"
+                    << (scan.GetStart() + scan.GetRange() * (i + 1) / sectors) / deg << " deg";
+            header << std::setw(20) << sector.str();
+        }
+        G4cout << "Dose per source photon (Gy) by angular sector of the scan" << G4endl << header.str() << G4endl;
+        outFile << "Dose per source photon (Gy) by angular sector of the scan\n" << header.str() << "\n";
+        for (const auto &[volName, volume]: volumeMap) {
+            const G4double mass = volume * VolumeDensity(volName);
+            const auto it = sectorDoseMap.find(volName);
+            std::ostringstream row;
+            row << std::setw(20) << volName;
+            for (G4int i = 0; i < sectors; ++i) {
+                const G4double deposit = it != sectorDoseMap.end() && i < static_cast<G4int>(it->second.size())
+                                             ? it->second[i]
+                                             : 0.0;
+                row << std::setw(20) << (mass > 0.0 ? deposit * 1.602e-10 / mass / sourcePhotons : 0.0);
+            }
+            G4cout << row.str() << G4endl;
+            outFile << row.str() << "\n";
+        }
+        G4cout << "========================================\n" << G4endl;
+        outFile << "========================================\n";
+    }
+
+    // Scatter contribution: compare with the primary dose of the ray-cast engine (if it ran for this insect)
+    if (const auto &rayCast = RayCastDoseEngine::GetLastResult();
+        IsMaster() && rayCast.insect == insectName && !rayCast.dosePerPhoton.empty()) {
+        G4cout << "Scatter contribution (primary dose from /raycast/run, " << rayCast.source << ")" << G4endl;
+        outFile << "Scatter contribution (primary dose from /raycast/run, " << rayCast.source << ")\n";
+        G4cout << std::setw(20) << "Volume Name" << std::setw(20) << "MC dose/event (Gy)"
+                << std::setw(20) << "Primary dose (Gy)" << std::setw(20) << "Scatter fraction" << G4endl;
+        outFile << std::setw(20) << "Volume Name" << std::setw(20) << "MC dose/event (Gy)"
+                << std::setw(20) << "Primary dose (Gy)" << std::setw(20) << "Scatter fraction" << "\n";
+        for (const auto &[volName, primaryDose]: rayCast.dosePerPhoton) {
+            G4double mcDosePerEvent = 0.0;
+            const auto volIt = volumeMap.find(volName);
+            const auto doseIt = doseMap.find(volName);
+            if (volIt != volumeMap.end() && doseIt != doseMap.end()) {
+                if (const G4double mass = volIt->second * VolumeDensity(volName); mass > 0.0)
+                    mcDosePerEvent = doseIt->second * 1.602e-10 / mass / sourcePhotons;
+            }
+            const G4double scatterFraction = mcDosePerEvent > 0.0 ? 1.0 - primaryDose / mcDosePerEvent : 0.0;
+
+            G4cout << std::setw(20) << volName
+                    << std::setw(20) << mcDosePerEvent
+                    << std::setw(20) << primaryDose
+                    << std::setw(20) << scatterFraction
+                    << G4endl;
+            outFile << std::setw(20) << volName
+                    << std::setw(20) << mcDosePerEvent
+                    << std::setw(20) << primaryDose
+                    << std::setw(20) << scatterFraction
+                    << "\n";
+        }
+    }
     outFile.close();
 
     G4cout << "Results saved to " << fileName.str() << G4endl;
+
+    // Raw accumulators of this partition of a split run, for PartitionedRun::Merge
+    if (PartitionedRun::IsActive()) {
+        PartitionedRun::Partial partial;
+        partial.insect = insectName;
+        partial.index = PartitionedRun::GetIndex();
+        partial.count = PartitionedRun::GetCount();
+        partial.events = nEvents;
+        partial.sourcePhotonsPerEvent = PrimaryGeneratorAction::GetSourcePhotonsPerEvent();
+        partial.photonFlux = photonFlux;
+        partial.beamArea = beamArea_mm2;
+        partial.preset = preset;
+        partial.sampling = sampling;
+        if (const G4int sectors = SteppingAction::GetSectors(); sectors > 0 && generator) {
+            partial.sectors = sectors;
+            partial.sectorStart = generator->GetTomography().GetStart();
+            partial.sectorRange = generator->GetTomography().GetRange();
+        }
+        partial.cpuTime = static_cast<G4double>(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+        partial.wallTime = wallTime;
+        for (const auto &[volName, volume]: volumeMap) {
+            PartitionedRun::VolumeAccumulator accumulator;
+            accumulator.name = volName;
+            accumulator.volume = volume;
+            accumulator.density = VolumeDensity(volName);
+            if (auto it = doseMap.find(volName); it != doseMap.end()) accumulator.sum = it->second;
+            if (auto it = doseSquaredMap.find(volName); it != doseSquaredMap.end()) accumulator.sumSquares = it->second;
+            if (auto it = replicaDoseMap.find(volName); it != replicaDoseMap.end()) accumulator.replicaSums = it->second;
+            if (auto it = SteppingAction::getSectorDoseMap().find(volName);
+                partial.sectors > 0 && it != SteppingAction::getSectorDoseMap().end()) {
+                accumulator.sectorSums = it->second;
+            }
+            partial.volumes.push_back(accumulator);
+        }
+        const std::string prefix = PartitionedRun::GetPartialPrefix().empty()
+                                       ? outputPrefix
+                                       : PartitionedRun::GetPartialPrefix();
+        std::ostringstream partialFile;
+        partialFile << prefix << insectName << "_run" << run->GetRunID() << ".part" << partial.index << "of"
+                << partial.count;
+        PartitionedRun::WritePartial(partialFile.str(), partial);
+    }
+
+    if (SensitivityAnalysis::IsActive()) {
+        // Not checkpointed: covers this run only
+        SensitivityAnalysis::WriteReport(outputPrefix + "sensitivity_" + insectName + outputSuffix + ".txt",
+                                         runEvents, runEvents * PrimaryGeneratorAction::GetSourcePhotonsPerEvent());
+    }
+    if (StepProfiler::IsActive()) {
+        StepProfiler::WriteReport(outputPrefix + "profile_" + insectName + outputSuffix + ".txt");
+    }
+    G4cout << "Wall time " << wallTime << " s (" << eventsPerSecond << " events/s)" << G4endl;
+
+    if (IsMaster() && !jsonSummaryFile.empty()) {
+        std::ofstream json(jsonSummaryFile, std::ios::app);
+        json << std::setprecision(10)
+                << "{\"insect\": \"" << insectName << "\""
+                << ", \"preset\": \"" << preset << "\""
+                << ", \"sampling\": \"" << sampling << "\""
+                << ", \"events\": " << nEvents
+                << ", \"wallTime\": " << wallTime
+                << ", \"eventsPerSecond\": " << eventsPerSecond
+                << ", \"volumes\": {" << jsonVolumes.str() << "}}\n";
+    }
+}
+
+std::vector<G4double> RunAction::ReplicaMeans(const std::vector<G4double> &replicaSums, const G4long nEvents) {
+    const auto replicas = static_cast<G4long>(replicaSums.size());
+    std::vector<G4double> means(replicaSums.size(), 0.0);
+    for (G4long r = 0; r < replicas; ++r) {
+        // events r, r + replicas, ... belong to replica r
+        const G4long replicaEvents = (nEvents - r + replicas - 1) / replicas;
+        if (replicaEvents > 0) means[r] = replicaSums[r] / static_cast<G4double>(replicaEvents);
+    }
+    return means;
+}
+
+G4double RunAction::RelativeError(const G4double sum, const G4double sumSquares, const G4long nEvents,
+                                  const std::vector<G4double> &replicaMeans) {
+    if (sum <= 0.0 || nEvents <= 0) return 0.0;
+    if (const auto replicas = static_cast<G4double>(replicaMeans.size()); replicas > 1) {
+        const G4double mean = std::accumulate(replicaMeans.begin(), replicaMeans.end(), 0.0) / replicas;
+        G4double variance = 0.0;
+        for (const G4double m: replicaMeans) variance += (m - mean) * (m - mean);
+        variance /= replicas - 1;
+        return mean > 0.0 ? std::sqrt(variance / replicas) / mean : 0.0;
+    }
+    const auto n = static_cast<G4double>(nEvents);
+    const G4double mean = sum / n;
+    const G4double variance = std::max(0.0, sumSquares / n - mean * mean);
+    return std::sqrt(variance / n) / mean;
+}
+
+G4double RunAction::VolumeDensity(const std::string &volName) {
+    G4double density = 0.95e-3; // g/cm3, // Approximate mass in g (assuming density ~ 1 g/cm3)
+    if (volName == "Tube")
+        density = 1.05E-3; // PMMA density ~1.05 g/cm3
+    if (volName == "Ethanol")
+        density = 0.789E-3;
+    return density;
 }
 
 void RunAction::SetOutputFilePrefix(const std::string &prefix) { outputPrefix = prefix; }
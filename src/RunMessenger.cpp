@@ -20,7 +20,11 @@
 #include "RunMessenger.h"
 #include "RunAction.h"
 #include "G4UIdirectory.hh"
+#include "EventAction.h"
+#include "MemoryReport.h"
 #include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithABool.hh"
 
 RunMessenger::RunMessenger(RunAction *runAction)
     : runAction(runAction) {
@@ -30,15 +34,64 @@ RunMessenger::RunMessenger(RunAction *runAction)
     outputPrefixCmd = new G4UIcmdWithAString("/output/setFileNamePrefix", this);
     outputPrefixCmd->SetGuidance("Set prefix used for output dose filenames (default 'dose_results_')");
     outputPrefixCmd->SetParameterName("prefix", false);
+
+    outputSuffixCmd = new G4UIcmdWithAString("/output/setFileNameSuffix", this);
+    outputSuffixCmd->SetGuidance("Set suffix appended to output dose filenames before '.txt' (default none)");
+    outputSuffixCmd->SetGuidance("Without a suffix none is appended");
+    outputSuffixCmd->SetParameterName("suffix", true);
+    outputSuffixCmd->SetDefaultValue("");
+
+    jsonSummaryCmd = new G4UIcmdWithAString("/output/setJsonSummaryFile", this);
+    jsonSummaryCmd->SetGuidance("Append a one-line JSON summary (timing and doses) of each run to this file");
+    jsonSummaryCmd->SetParameterName("filename", false);
+
+    // Shared by all threads: set on the master only
+    keepEveryCmd = new G4UIcmdWithAnInteger("/event/keepEvery", this);
+    keepEveryCmd->SetGuidance("Keep every k-th event (0: none)");
+    keepEveryCmd->SetGuidance("e.g. to draw only those with /vis/drawOnlyToBeKeptEvents");
+    keepEveryCmd->SetParameterName("k", false);
+    keepEveryCmd->SetRange("k>=0");
+    keepEveryCmd->SetToBeBroadcasted(false);
+
+    reproducibleCmd = new G4UIcmdWithABool("/run/reproducible", this);
+    reproducibleCmd->SetGuidance("Bit-identical results for any number of threads: per-event seeds from the event ID,");
+    reproducibleCmd->SetGuidance("fixed-point dose sums and no block sampling of the source");
+    reproducibleCmd->SetParameterName("on", true);
+    reproducibleCmd->SetDefaultValue(true);
+    reproducibleCmd->SetToBeBroadcasted(false);
+    reproducibleCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    memoryReportCmd = new G4UIcmdWithABool("/run/memoryReport", this);
+    memoryReportCmd->SetGuidance("Print the memory footprint at the start and the end of each run: geometry, physics,");
+    memoryReportCmd->SetGuidance("user actions and scoring per thread, and the memory of one more thread");
+    memoryReportCmd->SetParameterName("on", true);
+    memoryReportCmd->SetDefaultValue(true);
+    memoryReportCmd->SetToBeBroadcasted(false);
+    memoryReportCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
 }
 
 RunMessenger::~RunMessenger() {
     delete outputPrefixCmd;
+    delete outputSuffixCmd;
+    delete jsonSummaryCmd;
+    delete keepEveryCmd;
+    delete reproducibleCmd;
+    delete memoryReportCmd;
     delete runDir;
 }
 
 void RunMessenger::SetNewValue(G4UIcommand *command, G4String newValue) {
     if (command == outputPrefixCmd) {
         runAction->SetOutputFilePrefix(std::string(newValue));
+    } else if (command == outputSuffixCmd) {
+        runAction->SetOutputFileSuffix(std::string(newValue));
+    } else if (command == jsonSummaryCmd) {
+        runAction->SetJsonSummaryFile(std::string(newValue));
+    } else if (command == keepEveryCmd) {
+        EventAction::SetKeepEvery(G4UIcmdWithAnInteger::GetNewIntValue(newValue));
+    } else if (command == reproducibleCmd) {
+        RunAction::SetReproducible(G4UIcmdWithABool::GetNewBoolValue(newValue));
+    } else if (command == memoryReportCmd) {
+        MemoryReport::SetActive(G4UIcmdWithABool::GetNewBoolValue(newValue));
     }
 }
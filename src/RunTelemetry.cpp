@@ -0,0 +1,316 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "RunTelemetry.h"
+#include "TelemetryMessenger.h"
+#include "RunAction.h"
+#include "SteppingAction.h"
+#include "PrimaryGeneratorAction.h"
+#include "G4Threading.hh"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Counters of one thread; its own cache line, so the workers do not share one
+    struct alignas(64) Slot {
+        G4int thread{0};
+        std::atomic<G4long> events{0};
+        G4long publishedRequest{0}; // owner only
+
+        std::mutex mutex; // owner (publishing) against monitor (reading)
+        std::map<std::string, SteppingAction::Tally> tallies;
+        G4long talliesEvents{0};
+
+        G4long sampledEvents{0}; // monitor only
+    };
+
+    std::mutex registryMutex;
+    std::vector<std::unique_ptr<Slot> > slots;
+    std::atomic<G4long> runGeneration{0};
+    std::atomic<G4long> publishRequest{0};
+    std::atomic<bool> active{false};
+
+    thread_local Slot *threadSlot = nullptr;
+    thread_local G4long threadGeneration = -1;
+
+    // Monitor state (master)
+    std::thread monitor;
+    int wakePipe[2] = {-1, -1};
+    int listenFd = -1;
+    G4long eventsToProcess = 0;
+    Clock::time_point runStart;
+    Clock::time_point lastSample;
+    std::string latestJson = "{}";
+    G4bool csvHeaderWritten = false;
+
+    void Publish(Slot &slot) {
+        std::map<std::string, SteppingAction::Tally> tallies = SteppingAction::GetThreadTallies();
+        const G4long events = slot.events.load(std::memory_order_relaxed);
+        std::lock_guard lock(slot.mutex);
+        slot.tallies = std::move(tallies);
+        slot.talliesEvents = events;
+    }
+
+    std::string Quote(const std::string &text) { return "\"" + text + "\""; }
+}
+
+std::string RunTelemetry::file;
+std::string RunTelemetry::socketPath;
+G4double RunTelemetry::interval = 10.0;
+
+RunTelemetry::RunTelemetry() {
+    messenger = new TelemetryMessenger();
+}
+
+RunTelemetry::~RunTelemetry() {
+    delete messenger;
+}
+
+void RunTelemetry::SetInterval(const G4double seconds) {
+    if (seconds > 0.0) interval = seconds;
+}
+
+G4long RunTelemetry::ResidentMemory() {
+    std::ifstream statm("/proc/self/statm");
+    long pages = 0, resident = 0;
+    if (!(statm >> pages >> resident)) return 0;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+namespace {
+    // One sample: returns the JSON snapshot and writes the file
+    void Sample(const std::string &file, const G4bool final) {
+        const Clock::time_point now = Clock::now();
+        const G4double elapsed = std::chrono::duration<G4double>(now - runStart).count();
+        const G4double sinceLast = std::chrono::duration<G4double>(now - lastSample).count();
+        lastSample = now;
+
+        G4long events = 0, talliesEvents = 0;
+        std::vector<std::pair<G4int, G4double> > threadRates;
+        std::map<std::string, SteppingAction::Tally> tallies;
+        {
+            std::lock_guard registry(registryMutex);
+            for (const auto &slot: slots) {
+                const G4long slotEvents = slot->events.load(std::memory_order_relaxed);
+                events += slotEvents;
+                threadRates.emplace_back(slot->thread, sinceLast > 0.0
+                                                           ? (slotEvents - slot->sampledEvents) / sinceLast
+                                                           : 0.0);
+                slot->sampledEvents = slotEvents;
+                std::lock_guard lock(slot->mutex);
+                talliesEvents += slot->talliesEvents;
+                for (const auto &[name, tally]: slot->tallies) tallies[name].Add(tally);
+            }
+        }
+        const G4double rate = elapsed > 0.0 ? events / elapsed : 0.0;
+        const G4double eta = final ? 0.0 : rate > 0.0 ? std::max<G4long>(0, eventsToProcess - events) / rate : -1.0;
+        const G4double residentMB = static_cast<G4double>(RunTelemetry::ResidentMemory()) / (1024.0 * 1024.0);
+
+        // Running dose per source photon from the tallies published so far (consistent with their event count)
+        struct VolumeEstimate {
+            std::string name;
+            G4double dosePerPhoton;
+            G4double relError;
+        };
+        std::vector<VolumeEstimate> volumes;
+        const G4double sourcePhotons = talliesEvents * PrimaryGeneratorAction::GetSourcePhotonsPerEvent();
+        for (const auto &[name, volume]: SteppingAction::getVolumeMap()) {
+            VolumeEstimate estimate{name, 0.0, 0.0};
+            if (const auto it = tallies.find(name); it != tallies.end() && sourcePhotons > 0.0) {
+                const G4double mass = volume * RunAction::VolumeDensity(name);
+                if (mass > 0.0) estimate.dosePerPhoton = it->second.sum * 1.602e-10 / mass / sourcePhotons;
+                std::vector<G4double> replicaMeans;
+                if (it->second.replicaSum.size() > 1) {
+                    replicaMeans = RunAction::ReplicaMeans(it->second.replicaSum, talliesEvents);
+                }
+                estimate.relError = RunAction::RelativeError(it->second.sum, it->second.sum2, talliesEvents,
+                                                             replicaMeans);
+            }
+            volumes.push_back(estimate);
+        }
+
+        std::ostringstream json;
+        json << std::setprecision(8) << "{\"final\": " << (final ? "true" : "false") << ", \"elapsed\": " << elapsed
+                << ", \"events\": " << events << ", \"eventsToProcess\": " << eventsToProcess
+                << ", \"eventsPerSecond\": " << rate << ", \"eta\": " << eta << ", \"residentMemoryMB\": "
+                << residentMB << ", \"threads\": [";
+        for (std::size_t i = 0; i < threadRates.size(); ++i) {
+            json << (i ? ", " : "") << "{\"thread\": " << threadRates[i].first << ", \"eventsPerSecond\": "
+                    << threadRates[i].second << "}";
+        }
+        json << "], \"doseEvents\": " << talliesEvents << ", \"volumes\": {";
+        for (std::size_t i = 0; i < volumes.size(); ++i) {
+            json << (i ? ", " : "") << Quote(volumes[i].name) << ": {\"dosePerPhoton\": " << volumes[i].dosePerPhoton
+                    << ", \"relError\": " << volumes[i].relError << "}";
+        }
+        json << "}}";
+        latestJson = json.str();
+
+        if (file.empty()) return;
+        if (file.size() >= 4 && file.compare(file.size() - 4, 4, ".csv") == 0) {
+            std::ofstream csv(file, csvHeaderWritten ? std::ios::app : std::ios::trunc);
+            if (!csvHeaderWritten) {
+                csv << "elapsed_s,events,events_to_process,events_per_s,eta_s,rss_mb";
+                for (const auto &[thread, threadRate]: threadRates) csv << ",thread" << thread << "_events_per_s";
+                for (const VolumeEstimate &volume: volumes) {
+                    csv << "," << volume.name << "_dose_per_photon_Gy," << volume.name << "_rel_error";
+                }
+                csv << "\n";
+                csvHeaderWritten = true;
+            }
+            csv << std::setprecision(8) << elapsed << "," << events << "," << eventsToProcess << "," << rate << ","
+                    << eta << "," << residentMB;
+            for (const auto &[thread, threadRate]: threadRates) csv << "," << threadRate;
+            for (const VolumeEstimate &volume: volumes) csv << "," << volume.dosePerPhoton << "," << volume.relError;
+            csv << "\n";
+        } else {
+            // Readers never see a half-written snapshot
+            const std::string temporary = file + ".tmp";
+            {
+                std::ofstream out(temporary, std::ios::trunc);
+                out << latestJson << "\n";
+            }
+            std::rename(temporary.c_str(), file.c_str());
+        }
+    }
+
+    // Answers one connection with the latest snapshot (as HTTP, so curl --unix-socket works)
+    void Serve(const int fd) {
+        pollfd request{fd, POLLIN, 0};
+        if (poll(&request, 1, 100) > 0) {
+            char buffer[1024];
+            [[maybe_unused]] const ssize_t n = ::read(fd, buffer, sizeof(buffer));
+        }
+        const std::string response = "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\nContent-Length: " +
+                                     std::to_string(latestJson.size() + 1) + "\r\n\r\n" + latestJson + "\n";
+        [[maybe_unused]] const ssize_t n = ::send(fd, response.data(), response.size(), MSG_NOSIGNAL);
+        ::close(fd);
+    }
+
+    void Monitor(const std::string &file, const G4double interval) {
+        Clock::time_point next = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                     std::chrono::duration<G4double>(interval));
+        while (true) {
+            const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next - Clock::now()).count();
+            pollfd fds[2] = {{wakePipe[0], POLLIN, 0}, {listenFd, POLLIN, 0}};
+            const int ready = poll(fds, listenFd >= 0 ? 2 : 1, static_cast<int>(std::max<long long>(0, wait)));
+            if (ready > 0 && (fds[0].revents & POLLIN)) return; // stopped by EndOfRun
+            if (ready > 0 && listenFd >= 0 && (fds[1].revents & POLLIN)) {
+                if (const int fd = ::accept(listenFd, nullptr, nullptr); fd >= 0) Serve(fd);
+            }
+            if (Clock::now() >= next) {
+                // The workers hand over their tallies with their next event; they enter the following sample
+                publishRequest.fetch_add(1, std::memory_order_relaxed);
+                Sample(file, false);
+                next += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<G4double>(interval));
+            }
+        }
+    }
+}
+
+void RunTelemetry::BeginOfRun(const G4bool master, const G4long events) {
+    if (!master) return;
+    {
+        std::lock_guard registry(registryMutex);
+        slots.clear();
+    }
+    runGeneration.fetch_add(1);
+    active = IsEnabled();
+    if (!active) return;
+
+    eventsToProcess = events;
+    runStart = lastSample = Clock::now();
+    csvHeaderWritten = false;
+    latestJson = "{}";
+    if (::pipe(wakePipe) != 0) {
+        G4cerr << "RunTelemetry: cannot create the monitor pipe" << G4endl;
+        active = false;
+        return;
+    }
+    if (!socketPath.empty()) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+        ::unlink(socketPath.c_str());
+        listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0 || ::bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd, 8) != 0) {
+            G4cerr << "RunTelemetry: cannot listen on '" << socketPath << "'" << G4endl;
+            if (listenFd >= 0) ::close(listenFd);
+            listenFd = -1;
+        }
+    }
+    monitor = std::thread(Monitor, file, interval);
+}
+
+void RunTelemetry::EndOfEvent() {
+    if (!active.load(std::memory_order_relaxed)) return;
+    if (threadGeneration != runGeneration.load(std::memory_order_relaxed)) {
+        // First event of the run on this thread
+        auto slot = std::make_unique<Slot>();
+        slot->thread = G4Threading::G4GetThreadId();
+        threadSlot = slot.get();
+        threadGeneration = runGeneration.load();
+        std::lock_guard registry(registryMutex);
+        slots.push_back(std::move(slot));
+    }
+    threadSlot->events.store(threadSlot->events.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (const G4long request = publishRequest.load(std::memory_order_relaxed);
+        request != threadSlot->publishedRequest) {
+        threadSlot->publishedRequest = request;
+        Publish(*threadSlot);
+    }
+}
+
+void RunTelemetry::EndOfRun(const G4bool master) {
+    if (!active) return;
+    if (threadSlot && threadGeneration == runGeneration.load()) Publish(*threadSlot);
+    if (!master) return;
+
+    // All workers are done: stop the monitor and write the complete last snapshot
+    [[maybe_unused]] const ssize_t n = ::write(wakePipe[1], "x", 1);
+    if (monitor.joinable()) monitor.join();
+    ::close(wakePipe[0]);
+    ::close(wakePipe[1]);
+    Sample(file, true);
+    if (listenFd >= 0) {
+        ::close(listenFd);
+        ::unlink(socketPath.c_str());
+        listenFd = -1;
+    }
+    active = false;
+}
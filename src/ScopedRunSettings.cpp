@@ -0,0 +1,63 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "ScopedRunSettings.h"
+#include "RunAction.h"
+#include "PhysicsList.h"
+#include "G4UImanager.hh"
+#include "G4RunManager.hh"
+#include "G4VVisManager.hh"
+
+ScopedRunSettings::ScopedRunSettings(const G4double maxEnergy) {
+    const auto *runAction = dynamic_cast<const RunAction *>(G4RunManager::GetRunManager()->GetUserRunAction());
+    suffix = runAction ? runAction->GetOutputFileSuffix() : "";
+
+    if (PhysicsList *physicsList = PhysicsList::GetInstance(); physicsList && maxEnergy > 0.0) {
+        physicsList->HoldBeamMaxEnergy(maxEnergy);
+        energyHeld = true;
+    }
+
+    visEnabled = G4VVisManager::GetConcreteInstance() != nullptr;
+    if (visEnabled) G4UImanager::GetUIpointer()->ApplyCommand("/vis/disable");
+}
+
+ScopedRunSettings::~ScopedRunSettings() {
+    G4UImanager *uiManager = G4UImanager::GetUIpointer();
+    uiManager->ApplyCommand("/output/setFileNameSuffix " + suffix);
+    if (visEnabled) uiManager->ApplyCommand("/vis/enable");
+    if (PhysicsList *physicsList = PhysicsList::GetInstance(); physicsList && energyHeld) {
+        physicsList->HoldBeamMaxEnergy(0.0);
+    }
+}
+
+G4bool ScopedRunSettings::BeamOn(const G4long events, const std::string &label) const {
+    G4UImanager *uiManager = G4UImanager::GetUIpointer();
+    uiManager->ApplyCommand("/output/setFileNameSuffix " + suffix + label);
+
+    RunAction::ClearLastSummary();
+    if (const G4int status = uiManager->ApplyCommand("/run/beamOn " + std::to_string(events)); status != 0) {
+        G4cerr << "Run '" << label << "' failed: /run/beamOn returned " << status << G4endl;
+        return false;
+    }
+    if (RunAction::GetLastSummary().volumes.empty()) {
+        G4cerr << "Run '" << label << "' gave no result" << G4endl;
+        return false;
+    }
+    return true;
+}
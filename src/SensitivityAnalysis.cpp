@@ -0,0 +1,373 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "SensitivityAnalysis.h"
+#include "SensitivityMessenger.h"
+#include "SteppingAction.h"
+#include "RunAction.h"
+#include "DetectorConstruction.h"
+#include "PhysicsList.h"
+#include "PrimaryGeneratorAction.h"
+#include "G4Step.hh"
+#include "G4Track.hh"
+#include "G4Gamma.hh"
+#include "G4Material.hh"
+#include "G4NistManager.hh"
+#include "G4EmCalculator.hh"
+#include "G4GammaGeneralProcess.hh"
+#include "G4RunManager.hh"
+#include "G4AutoLock.hh"
+#include "G4SystemOfUnits.hh"
+#include "G4PhysicalConstants.hh"
+#include "G4UnitsTable.hh"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unordered_map>
+
+namespace {
+    // Photon interactions that are reweighted, in table order
+    const std::vector<G4String> interactionNames = {"phot", "compt", "Rayl", "conv"};
+    const G4int nInteractions = 4;
+
+    // Per-thread state: weights of the live tracks (tracks without an entry have weight 1 for all variants) and
+    // the weighted deposits of the current event, by volume name
+    thread_local std::unordered_map<const G4Track *, std::vector<G4double> > trackWeights;
+    thread_local std::map<std::string, std::vector<G4double> > eventDeposits;
+    thread_local std::map<std::string, std::vector<G4double> > threadSum;
+    thread_local std::map<std::string, std::vector<G4double> > threadSum2;
+    thread_local std::map<std::string, std::vector<G4double> > threadDiff2;
+
+    G4Mutex sensitivityMutex = G4MUTEX_INITIALIZER;
+
+    void AddTo(std::vector<G4double> &target, const std::vector<G4double> &values) {
+        if (target.size() < values.size()) target.resize(values.size(), 0.0);
+        for (std::size_t v = 0; v < values.size(); ++v) target[v] += values[v];
+    }
+}
+
+std::vector<SensitivityAnalysis::Variant> SensitivityAnalysis::variants;
+G4bool SensitivityAnalysis::active = false;
+const G4Material *SensitivityAnalysis::insectMaterial = nullptr;
+std::vector<G4double> SensitivityAnalysis::muTable;
+G4double SensitivityAnalysis::logEmin = 0.0;
+G4double SensitivityAnalysis::invDLogE = 0.0;
+G4int SensitivityAnalysis::nBins = 0;
+std::map<std::string, SensitivityAnalysis::Tally> SensitivityAnalysis::tallies;
+
+SensitivityAnalysis::SensitivityAnalysis() {
+    messenger = new SensitivityMessenger();
+}
+
+SensitivityAnalysis::~SensitivityAnalysis() {
+    delete messenger;
+}
+
+void SensitivityAnalysis::AddDensityScale(const G4double scale) {
+    if (scale <= 0.0) {
+        G4cerr << "SensitivityAnalysis: density scale must be positive" << G4endl;
+        return;
+    }
+    std::ostringstream label;
+    label << "density x" << scale;
+    variants.push_back({label.str(), scale, "", 0.0});
+}
+
+G4bool SensitivityAnalysis::AddMassFractionChange(const G4String &element, const G4double delta) {
+    if (!G4NistManager::Instance()->FindOrBuildElement(element)) {
+        G4cerr << "SensitivityAnalysis: unknown element '" << element << "'" << G4endl;
+        return false;
+    }
+    std::ostringstream label;
+    label << element << (delta >= 0.0 ? " +" : " ") << delta;
+    variants.push_back({label.str(), 1.0, element, delta});
+    return true;
+}
+
+void SensitivityAnalysis::Clear() {
+    variants.clear();
+}
+
+void SensitivityAnalysis::BeginOfRun() {
+    active = false;
+    insectMaterial = G4Material::GetMaterial("insectMat", false);
+    if (variants.empty() || !insectMaterial) return;
+
+    // The likelihood ratio needs the photon path inside the insect, but Woodcock steps cross its boundary
+    if (const PhysicsList *physicsList = PhysicsList::GetInstance(); physicsList && physicsList->IsWoodcock()) {
+        G4cerr << "SensitivityAnalysis: not available with Woodcock tracking (/physics/setWoodcock), no sensitivity "
+                "report for this run" << G4endl;
+        return;
+    }
+
+    // Energy range of the photons in the insect: fluorescence up to the highest source energy
+    G4double maxEnergy = 100 * keV;
+    if (const PrimaryGeneratorAction *generator = PrimaryGeneratorAction::GetMasterInstance();
+        generator && !generator->GetSpectrumEnergies().empty()) {
+        maxEnergy = generator->GetSpectrumEnergies().back();
+    }
+    const G4double minEnergy = 100 * eV;
+    nBins = 512;
+    logEmin = std::log(minEnergy);
+    invDLogE = (nBins - 1) / (std::log(1.01 * maxEnergy) - logEmin);
+
+    // Element lists and atom densities (1/mm3) of the nominal material and all variants
+    const std::size_t nMaterials = variants.size() + 1;
+    std::vector<const G4Element *> elements;
+    std::vector<G4double> nominalFractions;
+    for (std::size_t e = 0; e < insectMaterial->GetNumberOfElements(); ++e) {
+        elements.push_back(insectMaterial->GetElement(static_cast<G4int>(e)));
+        nominalFractions.push_back(insectMaterial->GetFractionVector()[e]);
+    }
+    for (const auto &variant: variants) {
+        if (variant.element.empty()) continue;
+        const G4Element *element = G4NistManager::Instance()->FindOrBuildElement(variant.element);
+        if (std::find(elements.begin(), elements.end(), element) == elements.end()) {
+            elements.push_back(element);
+            nominalFractions.push_back(0.0);
+        }
+    }
+
+    std::vector<std::vector<G4double> > atomDensities(nMaterials, std::vector<G4double>(elements.size(), 0.0));
+    for (std::size_t m = 0; m < nMaterials; ++m) {
+        std::vector<G4double> fractions = nominalFractions;
+        G4double density = insectMaterial->GetDensity();
+        if (m > 0) {
+            const Variant &variant = variants[m - 1];
+            density *= variant.densityScale;
+            if (!variant.element.empty()) {
+                const auto idx = std::find(elements.begin(), elements.end(),
+                                           G4NistManager::Instance()->FindOrBuildElement(variant.element)) - elements.begin();
+                const G4double newFraction = std::min(1.0, std::max(0.0, fractions[idx] + variant.massFractionDelta));
+                const G4double rest = 1.0 - fractions[idx];
+                for (std::size_t e = 0; e < fractions.size(); ++e) {
+                    if (static_cast<G4long>(e) != idx && rest > 0.0) fractions[e] *= (1.0 - newFraction) / rest;
+                }
+                fractions[idx] = newFraction;
+            }
+        }
+        for (std::size_t e = 0; e < elements.size(); ++e) {
+            atomDensities[m][e] = density * Avogadro * fractions[e] / elements[e]->GetA();
+        }
+    }
+
+    // mu_i(E) = sum over elements of n * sigma_i(Z, E); sigma from the physics list of this run
+    G4EmCalculator calculator;
+    const G4ParticleDefinition *gamma = G4Gamma::Definition();
+    muTable.assign(nMaterials * (nInteractions + 1) * nBins, 0.0);
+    for (G4int bin = 0; bin < nBins; ++bin) {
+        const G4double energy = std::exp(logEmin + bin / invDLogE);
+        for (G4int i = 0; i < nInteractions; ++i) {
+            std::vector<G4double> sigma(elements.size());
+            for (std::size_t e = 0; e < elements.size(); ++e) {
+                sigma[e] = calculator.ComputeCrossSectionPerAtom(energy, gamma, interactionNames[i],
+                                                                 elements[e]->GetZ(), elements[e]->GetA());
+            }
+            for (std::size_t m = 0; m < nMaterials; ++m) {
+                G4double mu = 0.0;
+                for (std::size_t e = 0; e < elements.size(); ++e) mu += atomDensities[m][e] * sigma[e];
+                muTable[(m * (nInteractions + 1) + i) * nBins + bin] = mu;
+                muTable[(m * (nInteractions + 1) + nInteractions) * nBins + bin] += mu;
+            }
+        }
+    }
+
+    active = true;
+    G4cout << "SensitivityAnalysis: " << variants.size() << " material variants of '" << insectMaterial->GetName()
+            << "' up to " << G4BestUnit(maxEnergy, "Energy") << G4endl;
+}
+
+G4double SensitivityAnalysis::Mu(const std::size_t v, const G4int i, const G4double energy) {
+    const G4double x = (std::log(energy) - logEmin) * invDLogE;
+    const G4double *table = &muTable[(v * (nInteractions + 1) + i) * nBins];
+    if (x <= 0.0) return table[0];
+    const auto bin = static_cast<G4int>(x);
+    if (bin >= nBins - 1) return table[nBins - 1];
+    const G4double f = x - bin;
+    return table[bin] + f * (table[bin + 1] - table[bin]);
+}
+
+G4int SensitivityAnalysis::InteractionIndex(const G4Step *step) {
+    const G4VProcess *process = step->GetPostStepPoint()->GetProcessDefinedStep();
+    if (!process) return -1;
+    const G4String *name = &process->GetProcessName();
+    // With the general gamma process the interaction is one of its sub-processes
+    if (const auto *general = dynamic_cast<const G4GammaGeneralProcess *>(process)) name = &general->GetSubProcessName();
+    for (G4int i = 0; i < nInteractions; ++i) {
+        if (*name == interactionNames[i]) return i;
+    }
+    return -1;
+}
+
+void SensitivityAnalysis::ProcessStep(const G4Step *step) {
+    const G4Track *track = step->GetTrack();
+    const std::size_t nVariants = variants.size();
+
+    std::vector<G4double> *weights = nullptr;
+    if (const auto it = trackWeights.find(track); it != trackWeights.end()) weights = &it->second;
+
+    // Likelihood ratio of the photon step in the insect material
+    const G4StepPoint *preStep = step->GetPreStepPoint();
+    if (track->GetDefinition() == G4Gamma::Definition() && preStep->GetMaterial() == insectMaterial) {
+        if (!weights) weights = &(trackWeights[track] = std::vector<G4double>(nVariants, 1.0));
+        const G4double energy = preStep->GetKineticEnergy();
+        const G4double length = step->GetStepLength();
+        const G4int interaction = InteractionIndex(step);
+        const G4double mu0 = Mu(0, nInteractions, energy);
+        const G4double mu0i = interaction >= 0 ? Mu(0, interaction, energy) : 0.0;
+        for (std::size_t v = 0; v < nVariants; ++v) {
+            G4double ratio = std::exp(-(Mu(v + 1, nInteractions, energy) - mu0) * length);
+            if (interaction >= 0 && mu0i > 0.0) ratio *= Mu(v + 1, interaction, energy) / mu0i;
+            (*weights)[v] *= ratio;
+        }
+    }
+
+    // Secondaries carry the weight of their parent at creation
+    if (weights) {
+        if (const auto *secondaries = step->GetSecondaryInCurrentStep()) {
+            for (const G4Track *secondary: *secondaries) trackWeights[secondary] = *weights;
+        }
+    }
+
+    if (const G4double energyDep = step->GetTotalEnergyDeposit() * preStep->GetWeight(); energyDep > 0.0) {
+        const G4VPhysicalVolume *volume = preStep->GetTouchableHandle()->GetVolume();
+        if (volume && volume->GetName() != "World" && volume->GetName() != DetectorConstruction::kSpecimenRegion) {
+            std::vector<G4double> &deposits = eventDeposits[volume->GetName()];
+            deposits.resize(nVariants + 1, 0.0);
+            deposits[0] += energyDep;
+            for (std::size_t v = 0; v < nVariants; ++v) deposits[v + 1] += energyDep * (weights ? (*weights)[v] : 1.0);
+        }
+    }
+
+    if (weights && track->GetTrackStatus() == fStopAndKill) trackWeights.erase(track);
+}
+
+void SensitivityAnalysis::EndOfEvent() {
+    for (auto &[name, deposits]: eventDeposits) {
+        std::vector<G4double> squares(deposits.size()), differences(deposits.size());
+        for (std::size_t v = 0; v < deposits.size(); ++v) {
+            squares[v] = deposits[v] * deposits[v];
+            differences[v] = (deposits[v] - deposits[0]) * (deposits[v] - deposits[0]);
+        }
+        AddTo(threadSum[name], deposits);
+        AddTo(threadSum2[name], squares);
+        AddTo(threadDiff2[name], differences);
+    }
+    eventDeposits.clear();
+    // Tracks of this event are gone; their addresses will be reused
+    trackWeights.clear();
+}
+
+void SensitivityAnalysis::MergeThreadTallies() {
+    G4AutoLock lock(&sensitivityMutex);
+    for (const auto &[name, sum]: threadSum) {
+        Tally &tally = tallies[name];
+        AddTo(tally.sum, sum);
+        AddTo(tally.sum2, threadSum2[name]);
+        AddTo(tally.diff2, threadDiff2[name]);
+    }
+    threadSum.clear();
+    threadSum2.clear();
+    threadDiff2.clear();
+}
+
+void SensitivityAnalysis::ClearTallies(const G4bool master) {
+    trackWeights.clear();
+    eventDeposits.clear();
+    threadSum.clear();
+    threadSum2.clear();
+    threadDiff2.clear();
+    if (master) {
+        G4AutoLock lock(&sensitivityMutex);
+        tallies.clear();
+    }
+}
+
+void SensitivityAnalysis::WriteReport(const std::string &fileName, const G4int nEvents,
+                                      const G4double sourcePhotons) {
+    if (!active || nEvents <= 0 || sourcePhotons <= 0.0) return;
+
+    // Volumes made of the insect material change their mass with the density
+    std::vector<G4String> insectVolumes;
+    if (const auto *detector = dynamic_cast<const DetectorConstruction *>(
+        G4RunManager::GetRunManager()->GetUserDetectorConstruction())) {
+        for (const auto &mesh: detector->GetMeshes()) {
+            if (mesh.material == insectMaterial) insectVolumes.push_back(mesh.name);
+        }
+    }
+
+    std::ofstream outFile(fileName);
+    outFile << "Correlated-sampling sensitivity to the insect material (" << nEvents << " events)\n";
+    // Same normalisation as the main dose table: per source photon
+    if (sourcePhotons != nEvents) outFile << "Source photons: " << sourcePhotons << "\n";
+    outFile << "Derivative: relative dose change per unit density scale or per unit mass fraction\n";
+    outFile << "========================================\n";
+    outFile << std::setw(20) << "Volume Name"
+            << std::setw(20) << "Variant"
+            << std::setw(20) << "Dose per photon (Gy)"
+            << std::setw(15) << "Rel. change"
+            << std::setw(15) << "Std. error"
+            << std::setw(15) << "Derivative"
+            << "\n";
+    outFile << "========================================\n";
+
+    const auto &volumeMap = SteppingAction::getVolumeMap();
+    for (const auto &[volName, volume]: volumeMap) {
+        const auto it = tallies.find(volName);
+        if (it == tallies.end() || it->second.sum.empty() || it->second.sum[0] <= 0.0) continue;
+        const Tally &tally = it->second;
+        const bool isInsect = std::find(insectVolumes.begin(), insectVolumes.end(), volName) != insectVolumes.end();
+        const G4double mass = volume * RunAction::VolumeDensity(volName);
+        if (mass <= 0.0) continue;
+
+        const G4double nominalDose = tally.sum[0] * 1.602e-10 / mass / sourcePhotons;
+        outFile << std::setw(20) << volName << std::setw(20) << "nominal" << std::setw(20) << nominalDose << "\n";
+
+        for (std::size_t v = 0; v < variants.size() && v + 1 < tally.sum.size(); ++v) {
+            const Variant &variant = variants[v];
+            const G4double massScale = isInsect ? variant.densityScale : 1.0;
+            const G4double dose = tally.sum[v + 1] * 1.602e-10 / (mass * massScale) / sourcePhotons;
+            const G4double relChange = dose / nominalDose - 1.0;
+
+            // Standard error of the deposit difference from the per-event differences of the shared histories
+            const G4double meanDiff = (tally.sum[v + 1] - tally.sum[0]) / nEvents;
+            const G4double varDiff = std::max(0.0, tally.diff2[v + 1] / nEvents - meanDiff * meanDiff) / nEvents;
+            const G4double stdError = std::sqrt(varDiff) / (tally.sum[0] / nEvents) / massScale;
+
+            const G4double parameterChange = variant.element.empty()
+                                                 ? variant.densityScale - 1.0
+                                                 : variant.massFractionDelta;
+            const G4double derivative = parameterChange != 0.0 ? relChange / parameterChange : 0.0;
+
+            outFile << std::setw(20) << volName
+                    << std::setw(20) << variant.label
+                    << std::setw(20) << dose
+                    << std::setw(15) << relChange
+                    << std::setw(15) << stdError
+                    << std::setw(15) << derivative
+                    << "\n";
+        }
+    }
+    outFile << "========================================\n";
+    outFile.close();
+
+    G4cout << "Sensitivity results saved to " << fileName << G4endl;
+}
@@ -0,0 +1,73 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "SensitivityMessenger.h"
+#include "SensitivityAnalysis.h"
+#include "G4UIdirectory.hh"
+#include "G4UIcommand.hh"
+#include "G4UIparameter.hh"
+#include "G4UIcmdWithADouble.hh"
+#include "G4UIcmdWithoutParameter.hh"
+#include <sstream>
+
+SensitivityMessenger::SensitivityMessenger() {
+    // Variants are configured on the master, which builds their tables: do not broadcast to the workers
+    sensitivityDir = new G4UIdirectory("/sensitivity/", false);
+    sensitivityDir->SetGuidance("Correlated-sampling sensitivity of the dose to the insect material");
+
+    densityScaleCmd = new G4UIcmdWithADouble("/sensitivity/addDensityScale", this);
+    densityScaleCmd->SetGuidance("Add a variant with the insect density scaled by the given factor (e.g. 1.05)");
+    densityScaleCmd->SetParameterName("scale", false);
+    densityScaleCmd->SetRange("scale>0");
+    densityScaleCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    massFractionCmd = new G4UIcommand("/sensitivity/addMassFractionChange", this);
+    massFractionCmd->SetGuidance("Add a variant with the mass fraction of an element changed by delta");
+    massFractionCmd->SetGuidance("The other elements are rescaled so the fractions sum to 1");
+    auto *elementParam = new G4UIparameter("element", 's', false);
+    massFractionCmd->SetParameter(elementParam);
+    auto *deltaParam = new G4UIparameter("delta", 'd', false);
+    massFractionCmd->SetParameter(deltaParam);
+    massFractionCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    clearCmd = new G4UIcmdWithoutParameter("/sensitivity/clear", this);
+    clearCmd->SetGuidance("Remove all variants (disables the sensitivity analysis)");
+    clearCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+SensitivityMessenger::~SensitivityMessenger() {
+    delete densityScaleCmd;
+    delete massFractionCmd;
+    delete clearCmd;
+    delete sensitivityDir;
+}
+
+void SensitivityMessenger::SetNewValue(G4UIcommand *command, G4String newValue) {
+    if (command == densityScaleCmd) {
+        SensitivityAnalysis::AddDensityScale(G4UIcmdWithADouble::GetNewDoubleValue(newValue));
+    } else if (command == massFractionCmd) {
+        std::istringstream is(newValue);
+        G4String element;
+        G4double delta = 0.0;
+        is >> element >> delta;
+        SensitivityAnalysis::AddMassFractionChange(element, delta);
+    } else if (command == clearCmd) {
+        SensitivityAnalysis::Clear();
+    }
+}
@@ -0,0 +1,358 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "SimulationDaemon.h"
+#include "RunAction.h"
+#include "ScopedRunSettings.h"
+#include "G4StateManager.hh"
+#include "G4UImanager.hh"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    std::string Quote(const std::string &text) {
+        std::string quoted = "\"";
+        for (const char c: text) {
+            if (c == '"' || c == '\\') {
+                quoted += '\\';
+                quoted += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                quoted += ' ';
+            } else {
+                quoted += c;
+            }
+        }
+        return quoted + "\"";
+    }
+
+    std::string Record(const std::string &id, const std::string &status, const std::string &extra = "") {
+        return "{\"id\": " + Quote(id) + ", \"status\": " + Quote(status) + extra + "}";
+    }
+
+    // Minimal reader for the flat job objects: string, number and boolean values, arrays of strings
+    class JobParser {
+    public:
+        explicit JobParser(const std::string &text) : text(text) {}
+
+        bool Parse(std::map<std::string, std::string> &fields, std::vector<std::string> &commands,
+                   std::string &error) {
+            if (!Expect('{')) return Fail(error, "expected '{'");
+            if (Peek() == '}') return Expect('}');
+            do {
+                std::string key;
+                if (!String(key)) return Fail(error, "expected a key");
+                if (!Expect(':')) return Fail(error, "expected ':' after \"" + key + "\"");
+                if (Peek() == '[') {
+                    Expect('[');
+                    if (Peek() != ']') {
+                        do {
+                            std::string item;
+                            if (!String(item)) return Fail(error, "\"" + key + "\" must be an array of strings");
+                            commands.push_back(item);
+                        } while (Expect(','));
+                    }
+                    if (!Expect(']')) return Fail(error, "expected ']'");
+                    if (key != "macro") return Fail(error, "only \"macro\" takes an array");
+                } else if (Peek() == '"') {
+                    if (!String(fields[key])) return Fail(error, "unterminated string");
+                } else {
+                    std::string value;
+                    while (pos < text.size() && (std::isalnum(static_cast<unsigned char>(text[pos])) ||
+                                                 std::strchr("+-.", text[pos]))) {
+                        value += text[pos++];
+                    }
+                    if (value.empty()) return Fail(error, "bad value of \"" + key + "\"");
+                    fields[key] = value;
+                }
+            } while (Expect(','));
+            if (!Expect('}')) return Fail(error, "expected '}'");
+            return true;
+        }
+
+    private:
+        char Peek() {
+            while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) ++pos;
+            return pos < text.size() ? text[pos] : '\0';
+        }
+
+        bool Expect(const char c) {
+            if (Peek() != c) return false;
+            ++pos;
+            return true;
+        }
+
+        bool String(std::string &value) {
+            if (!Expect('"')) return false;
+            value.clear();
+            while (pos < text.size() && text[pos] != '"') {
+                if (text[pos] == '\\' && pos + 1 < text.size()) ++pos;
+                value += text[pos++];
+            }
+            return pos++ < text.size();
+        }
+
+        static bool Fail(std::string &error, const std::string &message) {
+            error = message;
+            return false;
+        }
+
+        const std::string &text;
+        std::size_t pos{0};
+    };
+}
+
+SimulationDaemon::Client::~Client() {
+    if (fd > 2) ::close(fd);
+}
+
+void SimulationDaemon::Client::Send(const std::string &record) {
+    std::lock_guard lock(writeMutex);
+    const std::string line = record + "\n";
+    for (std::size_t written = 0; written < line.size();) {
+        const ssize_t n = ::write(fd, line.data() + written, line.size() - written);
+        if (n <= 0) return; // the client went away, the job still runs
+        written += static_cast<std::size_t>(n);
+    }
+}
+
+SimulationDaemon::SimulationDaemon(const G4int maxQueued) : maxQueued(std::max(1, maxQueued)) {
+}
+
+int SimulationDaemon::Serve(const std::string &socketPath) {
+    std::signal(SIGPIPE, SIG_IGN); // a closed connection must not end the daemon
+
+    // Initialise once, unless the setup macro did
+    G4UImanager *uiManager = G4UImanager::GetUIpointer();
+    if (G4StateManager::GetStateManager()->GetCurrentState() == G4State_PreInit) {
+        uiManager->ApplyCommand("/run/initialize");
+    }
+
+    std::thread acceptor;
+    if (socketPath == "-") {
+        // Records go to stdout among the log output: they are the lines starting with '{'
+        auto client = std::make_shared<Client>(STDOUT_FILENO);
+        {
+            std::lock_guard lock(queueMutex);
+            ++activeReaders;
+        }
+        std::thread([this, client] {
+            std::string line;
+            while (!stopping && std::getline(std::cin, line)) Submit(line, client);
+            Shutdown();
+            std::lock_guard lock(queueMutex);
+            --activeReaders;
+            readersDone.notify_all();
+        }).detach();
+    } else {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(address.sun_path)) {
+            G4cerr << "SimulationDaemon: socket path '" << socketPath << "' is too long" << G4endl;
+            return 1;
+        }
+        std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+        ::unlink(socketPath.c_str());
+        listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0 || ::bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+            ::listen(listenFd, 16) != 0) {
+            G4cerr << "SimulationDaemon: cannot listen on '" << socketPath << "': " << std::strerror(errno) << G4endl;
+            if (listenFd >= 0) ::close(listenFd);
+            return 1;
+        }
+        acceptor = std::thread([this] {
+            while (true) {
+                const int fd = ::accept(listenFd, nullptr, nullptr);
+                if (fd < 0) {
+                    if (errno == EINTR) continue;
+                    break; // closed by Shutdown()
+                }
+                auto client = std::make_shared<Client>(fd);
+                std::lock_guard lock(queueMutex);
+                if (stopping) break;
+                clients.push_back(client);
+                ++activeReaders;
+                std::thread(&SimulationDaemon::ReadClient, this, client).detach();
+            }
+        });
+    }
+    G4cout << "SimulationDaemon: ready for jobs on " << (socketPath == "-" ? "stdin" : socketPath)
+            << " (at most " << maxQueued << " queued)" << G4endl;
+
+    // Runs are executed here, on the main thread, one after the other
+    while (true) {
+        std::unique_lock lock(queueMutex);
+        queueReady.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty()) break;
+        const Job job = queue.front();
+        queue.pop_front();
+        lock.unlock();
+        Execute(job);
+    }
+
+    if (acceptor.joinable()) acceptor.join();
+    {
+        std::unique_lock lock(queueMutex);
+        for (const auto &weak: clients) {
+            if (const auto client = weak.lock()) ::shutdown(client->fd, SHUT_RDWR);
+        }
+        readersDone.wait(lock, [this] { return activeReaders == 0; });
+    }
+    if (listenFd >= 0) {
+        ::close(listenFd);
+        ::unlink(socketPath.c_str());
+    }
+    G4cout << "SimulationDaemon: shut down" << G4endl;
+    return 0;
+}
+
+void SimulationDaemon::ReadClient(const std::shared_ptr<Client> &client) {
+    std::string buffer;
+    char chunk[4096];
+    while (!stopping) {
+        const ssize_t n = ::read(client->fd, chunk, sizeof(chunk));
+        if (n <= 0) break;
+        buffer.append(chunk, static_cast<std::size_t>(n));
+        for (auto end = buffer.find('\n'); end != std::string::npos; end = buffer.find('\n')) {
+            Submit(buffer.substr(0, end), client);
+            buffer.erase(0, end + 1);
+        }
+    }
+    std::lock_guard lock(queueMutex);
+    --activeReaders;
+    readersDone.notify_all();
+}
+
+void SimulationDaemon::Shutdown() {
+    std::lock_guard lock(queueMutex);
+    stopping = true;
+    if (listenFd >= 0) ::shutdown(listenFd, SHUT_RDWR); // wakes accept()
+    queueReady.notify_all();
+}
+
+void SimulationDaemon::Submit(const std::string &text, const std::shared_ptr<Client> &client) {
+    std::string line = text;
+    while (!line.empty() && std::isspace(static_cast<unsigned char>(line.back()))) line.pop_back();
+    line.erase(0, std::min(line.size(), line.find_first_not_of(" \t")));
+    if (line.empty() || line[0] == '#') return;
+
+    Job job;
+    job.client = client;
+    if (line[0] == '/') {
+        job.commands.push_back(line);
+    } else {
+        std::string error;
+        if (!JobParser(line).Parse(job.fields, job.commands, error)) {
+            client->Send(Record("", "error", ", \"message\": " + Quote("invalid job: " + error)));
+            return;
+        }
+        // The id ends up in output file names: no spaces, no path separators
+        if (const auto id = job.fields.find("id"); id != job.fields.end() &&
+            (id->second.empty() || id->second.find_first_not_of(
+                 "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_.-") != std::string::npos)) {
+            client->Send(Record("", "error", ", \"message\": " + Quote(
+                                    "invalid job: id '" + id->second + "' may only contain letters, digits, _ . -")));
+            return;
+        }
+        if (job.fields["command"] == "shutdown") {
+            client->Send(Record(job.fields["id"], "shutdown"));
+            Shutdown();
+            return;
+        }
+    }
+
+    std::lock_guard lock(queueMutex);
+    job.id = job.fields.count("id") ? job.fields["id"] : "job" + std::to_string(++jobCounter);
+    if (stopping || static_cast<G4int>(queue.size()) >= maxQueued) {
+        client->Send(Record(job.id, "rejected", ", \"message\": " + Quote(stopping ? "shutting down" : "queue full")));
+        return;
+    }
+    queue.push_back(job);
+    client->Send(Record(job.id, "queued", ", \"position\": " + std::to_string(queue.size())));
+    queueReady.notify_all();
+}
+
+void SimulationDaemon::Execute(const Job &job) {
+    job.client->Send(Record(job.id, "started"));
+    const auto field = [&job](const std::string &key) {
+        const auto it = job.fields.find(key);
+        return it != job.fields.end() ? it->second : std::string();
+    };
+
+    // The job's settings as macro commands, in the order a macro would give them
+    std::vector<std::string> commands;
+    if (const std::string insect = field("insect"); !insect.empty()) {
+        commands.push_back("/detector/selectInsect " + insect);
+    }
+    if (const std::string spectrum = field("spectrum"); !spectrum.empty()) {
+        commands.push_back("/generator/setSpectrumFile " + spectrum);
+        commands.push_back("/generator/setMonochromatic false");
+    } else if (const std::string energy = field("energy"); !energy.empty()) {
+        commands.push_back("/generator/setMonoEnergy " + energy + " keV");
+        commands.push_back("/generator/setMonochromatic true");
+    }
+    if (const std::string seed = field("seed"); !seed.empty()) {
+        commands.push_back("/random/setSeeds " + seed + " " + std::to_string(std::atol(seed.c_str()) ^ 0x5bd1e995L));
+    }
+    commands.insert(commands.end(), job.commands.begin(), job.commands.end());
+
+    G4UImanager *uiManager = G4UImanager::GetUIpointer();
+    for (const std::string &command: commands) {
+        if (const int status = uiManager->ApplyCommand(command); status != 0) {
+            job.client->Send(Record(job.id, "error", ", \"message\": " + Quote(
+                                        "command failed (" + std::to_string(status) + "): " + command)));
+            return;
+        }
+    }
+
+    const long events = std::atol(field("events").c_str());
+    if (events <= 0) {
+        job.client->Send(Record(job.id, "done"));
+        return;
+    }
+
+    // Output files of the job get its id in the suffix
+    if (!ScopedRunSettings().BeamOn(events, "_" + job.id)) {
+        job.client->Send(Record(job.id, "error", ", \"message\": " + Quote("the run failed or gave no result")));
+        return;
+    }
+
+    const RunAction::Summary &summary = RunAction::GetLastSummary();
+    std::ostringstream extra;
+    extra << std::setprecision(10) << ", \"insect\": " << Quote(summary.insect) << ", \"events\": "
+            << summary.events << ", \"wallTime\": " << summary.wallTime << ", \"volumes\": {";
+    G4bool first = true;
+    for (const auto &[volume, result]: summary.volumes) {
+        extra << (first ? "" : ", ") << Quote(volume) << ": {\"dosePerEvent\": " << result.dosePerEvent
+                << ", \"doseRate\": " << result.doseRate << ", \"relError\": " << result.relError << "}";
+        first = false;
+    }
+    extra << "}";
+    job.client->Send(Record(job.id, "done", extra.str()));
+}
@@ -0,0 +1,77 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "SobolSequence.h"
+
+namespace {
+    // Degree s, coefficients a and initial m of the primitive polynomials of dimensions 2-4
+    struct Polynomial {
+        unsigned s;
+        unsigned a;
+        std::uint32_t m[3];
+    };
+    constexpr Polynomial kPolynomials[SobolSequence::kDimensions - 1] = {
+        {1, 0, {1, 0, 0}},
+        {2, 1, {1, 3, 0}},
+        {3, 1, {1, 3, 1}},
+    };
+
+    std::uint64_t SplitMix64(std::uint64_t &state) {
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+}
+
+SobolSequence::SobolSequence() {
+    // First dimension: van der Corput in base 2
+    for (unsigned k = 0; k < 32; ++k) directions[0][k] = 1u << (31 - k);
+
+    for (int d = 1; d < kDimensions; ++d) {
+        const Polynomial &p = kPolynomials[d - 1];
+        auto &v = directions[d];
+        for (unsigned k = 0; k < p.s; ++k) v[k] = p.m[k] << (31 - k);
+        for (unsigned k = p.s; k < 32; ++k) {
+            v[k] = v[k - p.s] ^ (v[k - p.s] >> p.s);
+            for (unsigned j = 1; j < p.s; ++j) {
+                if ((p.a >> (p.s - 1 - j)) & 1u) v[k] ^= v[k - j];
+            }
+        }
+    }
+}
+
+void SobolSequence::Point(const std::uint32_t index, const Shift &shift, G4double *point) const {
+    for (int d = 0; d < kDimensions; ++d) {
+        std::uint32_t x = shift[d];
+        std::uint32_t i = index;
+        for (unsigned k = 0; i != 0; ++k, i >>= 1) {
+            if (i & 1u) x ^= directions[d][k];
+        }
+        // Centre of the 2^-32 cell: never exactly 0 or 1
+        point[d] = (static_cast<G4double>(x) + 0.5) * (1.0 / 4294967296.0);
+    }
+}
+
+SobolSequence::Shift SobolSequence::MakeShift(const std::uint64_t seed, const G4int run, const G4int replica) {
+    std::uint64_t state = seed ^ (static_cast<std::uint64_t>(run) << 32) ^ static_cast<std::uint64_t>(replica);
+    Shift shift{};
+    for (auto &s: shift) s = static_cast<std::uint32_t>(SplitMix64(state) >> 32);
+    return shift;
+}
@@ -0,0 +1,148 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "Spectrum.h"
+#include "G4AutoLock.hh"
+#include <CLHEP/Units/SystemOfUnits.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+std::shared_ptr<const Spectrum> Spectrum::current;
+std::atomic<std::uint64_t> Spectrum::generation{0};
+
+namespace {
+    G4Mutex currentMutex = G4MUTEX_INITIALIZER;
+}
+
+std::shared_ptr<const Spectrum> Spectrum::Monochromatic(const G4double energy) {
+    std::shared_ptr<Spectrum> spectrum(new Spectrum());
+    spectrum->energies = {energy};
+    spectrum->probabilities = {1.0};
+    spectrum->sampler = SpectrumSampler(spectrum->energies, spectrum->probabilities);
+    spectrum->description = "monochromatic";
+
+    G4cout << "Initialized monochromatic spectrum at " << energy / CLHEP::keV << " keV" << G4endl;
+    return spectrum;
+}
+
+std::shared_ptr<const Spectrum> Spectrum::FromFile(const std::string &filename) {
+    // Try to read a spectrum file from the provided filename or the `spectra/` directory.
+    namespace fs = std::filesystem;
+    std::vector<std::pair<G4double, G4double> > parsed; // pair<energy_eV, intensity>
+
+    fs::path fileToOpen;
+    if (!filename.empty()) {
+        if (fs::path p(filename); p.is_absolute()) {
+            if (fs::exists(p)) fileToOpen = p;
+        } else {
+            // check in project spectra dir first
+            if (fs::path candidate = fs::path("spectra") / p; fs::exists(candidate)) fileToOpen = candidate;
+            else if (fs::exists(p)) fileToOpen = p; // relative to cwd
+        }
+    } else {
+        // auto-detect first supported file
+        std::vector<fs::path> candidates = {"spectra", "./spectra", "../spectra"};
+        for (const auto &d: candidates) {
+            fs::path dir = d;
+            if (!fs::exists(dir) || !fs::is_directory(dir)) continue;
+            for (auto &entry: fs::directory_iterator(dir)) {
+                if (!entry.is_regular_file()) continue;
+                auto ext = entry.path().extension().string();
+                std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+                if (ext == ".txt" || ext == ".dat" || ext == ".spc") {
+                    fileToOpen = entry.path();
+                    break;
+                }
+            }
+            if (!fileToOpen.empty()) break;
+        }
+    }
+
+    bool fileLoaded = false;
+    if (!fileToOpen.empty()) {
+        if (std::ifstream ifs(fileToOpen); ifs) {
+            G4cout << "Reading spectrum file: " << fileToOpen.string() << G4endl;
+            std::string line;
+            while (std::getline(ifs, line)) {
+                // remove comments after '#'
+                if (auto commentPos = line.find('#'); commentPos != std::string::npos) line.resize(commentPos);
+                // trim
+                std::istringstream iss(line);
+                double e_eV = 0.0, inten = 0.0;
+                if (!(iss >> e_eV)) continue; // skip empty/invalid lines
+                // some files may have only energy + counts per bin; if intensity missing, treat as 1
+                if (!(iss >> inten)) inten = 1.0;
+                parsed.emplace_back(e_eV, inten);
+            }
+            if (!parsed.empty()) fileLoaded = true;
+        }
+    }
+    if (!fileLoaded) {
+        G4cerr << "ERROR: Could not load spectrum file '" << filename << G4endl;
+        throw std::runtime_error("Failed to load spectrum file");
+    }
+
+    // Convert parsed pairs into the member vectors. Ensure energies are sorted ascending.
+    std::sort(parsed.begin(), parsed.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+    std::shared_ptr<Spectrum> spectrum(new Spectrum());
+    for (auto &[energy, intensity]: parsed) {
+        spectrum->energies.push_back(energy * CLHEP::eV);
+        spectrum->probabilities.push_back(intensity);
+    }
+
+
+    // Normalize (alias table below)
+    if (spectrum->probabilities.empty()) {
+        spectrum->energies = {15.2 * CLHEP::keV};
+        spectrum->probabilities = {1.0};
+    }
+
+    G4double sum = std::accumulate(spectrum->probabilities.begin(), spectrum->probabilities.end(), 0.0);
+    if (sum <= 0.0) {
+        // avoid division by zero
+        std::fill(spectrum->probabilities.begin(), spectrum->probabilities.end(), 1.0);
+        sum = static_cast<G4double>(spectrum->probabilities.size());
+    }
+
+    // Normalize and build the alias table
+    for (double &spectrumIntensity: spectrum->probabilities) spectrumIntensity /= sum;
+    spectrum->sampler = SpectrumSampler(spectrum->energies, spectrum->probabilities);
+    spectrum->description = fileToOpen.string();
+
+    G4cout << "Initialized polychromatic spectrum with " << spectrum->energies.size() << " energy bins" << G4endl;
+    G4cout << "Energy range: " << spectrum->energies.front() / CLHEP::keV << " - " << spectrum->energies.back() /
+            CLHEP::keV << " keV" << G4endl;
+    return spectrum;
+
+}
+
+void Spectrum::Publish(std::shared_ptr<const Spectrum> spectrum) {
+    G4AutoLock lock(&currentMutex);
+    current = std::move(spectrum);
+    generation.fetch_add(1, std::memory_order_acq_rel);
+}
+
+std::shared_ptr<const Spectrum> Spectrum::GetCurrent() {
+    G4AutoLock lock(&currentMutex);
+    return current;
+}
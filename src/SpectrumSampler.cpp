@@ -0,0 +1,73 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "SpectrumSampler.h"
+
+SpectrumSampler::SpectrumSampler(const std::vector<G4double> &energies, const std::vector<G4double> &probabilities)
+    : nBins(static_cast<std::uint32_t>(energies.size())),
+      threshold(energies.size(), 1.0),
+      alias(energies.size()),
+      lowEdge(energies),
+      width(energies.size(), 0.0) {
+    for (std::size_t i = 0; i + 1 < energies.size(); ++i) width[i] = energies[i + 1] - energies[i];
+
+    // Vose: split the columns scaled to mean 1 into under- and overfull ones and let each underfull column be
+    // topped up by an overfull one
+    G4double sum = 0.0;
+    for (const G4double p: probabilities) sum += p;
+    std::vector<G4double> scaled(nBins);
+    std::vector<std::uint32_t> small, large;
+    for (std::uint32_t i = 0; i < nBins; ++i) {
+        scaled[i] = sum > 0.0 ? probabilities[i] * nBins / sum : 1.0;
+        alias[i] = i;
+        (scaled[i] < 1.0 ? small : large).push_back(i);
+    }
+    while (!small.empty() && !large.empty()) {
+        const std::uint32_t s = small.back();
+        small.pop_back();
+        const std::uint32_t l = large.back();
+        threshold[s] = scaled[s];
+        alias[s] = l;
+        scaled[l] -= 1.0 - scaled[s];
+        if (scaled[l] < 1.0) {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+    // Whatever is left is full up to rounding
+    for (const std::uint32_t i: small) threshold[i] = 1.0;
+    for (const std::uint32_t i: large) threshold[i] = 1.0;
+}
+
+void SpectrumSampler::SampleBatch(const G4double *u1, const G4double *u2, G4double *energies,
+                                  const std::size_t n) const {
+    const G4double *thresholds = threshold.data();
+    const std::uint32_t *aliases = alias.data();
+    const G4double *low = lowEdge.data();
+    const G4double *widths = width.data();
+    const G4double bins = nBins;
+    const std::uint32_t lastColumn = nBins - 1;
+    for (std::size_t k = 0; k < n; ++k) {
+        const G4double scaled = u1[k] * bins;
+        std::uint32_t column = static_cast<std::uint32_t>(scaled);
+        column = column > lastColumn ? lastColumn : column;
+        const std::uint32_t bin = scaled - column < thresholds[column] ? column : aliases[column];
+        energies[k] = low[bin] + u2[k] * widths[bin];
+    }
+}
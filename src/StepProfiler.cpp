@@ -0,0 +1,229 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "StepProfiler.h"
+#include "ProfilerMessenger.h"
+#include "G4Step.hh"
+#include "G4StepPoint.hh"
+#include "G4Track.hh"
+#include "G4VProcess.hh"
+#include "G4VPhysicalVolume.hh"
+#include "G4ParticleDefinition.hh"
+#include "G4AutoLock.hh"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+G4bool StepProfiler::active = false;
+G4int StepProfiler::sampleInterval = 100;
+G4int StepProfiler::topRows = 25;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // Particle definitions and volumes are shared, processes belong to the thread: pointers identify them within
+    // a thread and run, the merge goes by name
+    struct Key {
+        const G4ParticleDefinition *particle{nullptr};
+        const G4VProcess *process{nullptr};
+        const G4VPhysicalVolume *volume{nullptr};
+
+        bool operator==(const Key &other) const {
+            return particle == other.particle && process == other.process && volume == other.volume;
+        }
+    };
+
+    struct KeyHash {
+        std::size_t operator()(const Key &key) const noexcept {
+            constexpr std::uint64_t multiplier = 0x9E3779B97F4A7C15ULL;
+            std::uint64_t h = reinterpret_cast<std::uintptr_t>(key.particle);
+            h = (h ^ reinterpret_cast<std::uintptr_t>(key.process)) * multiplier;
+            h = (h ^ reinterpret_cast<std::uintptr_t>(key.volume)) * multiplier;
+            return static_cast<std::size_t>(h ^ (h >> 32));
+        }
+    };
+
+    struct Cell {
+        G4long steps{0};
+        G4double length{0.0}; // mm
+        G4long timedSteps{0};
+        G4double time{0.0}; // s, sum over the timed steps
+
+        void Add(const Cell &other) {
+            steps += other.steps;
+            length += other.length;
+            timedSteps += other.timedSteps;
+            time += other.time;
+        }
+
+        // Mean cost of the timed steps times all steps
+        [[nodiscard]] G4double EstimatedTime() const { return timedSteps > 0 ? time / timedSteps * steps : 0.0; }
+    };
+
+    struct ThreadTable {
+        std::unordered_map<Key, std::uint32_t, KeyHash> index;
+        std::vector<Key> keys;
+        std::vector<Cell> cells;
+        // Consecutive steps often share the triple (a photon crossing air, an electron slowing down)
+        Key lastKey;
+        std::uint32_t lastCell{0};
+        G4bool hasLast{false};
+        G4int untilSample{0};
+        G4bool timing{false};
+        Clock::time_point start;
+
+        void Clear() {
+            index.clear();
+            keys.clear();
+            cells.clear();
+            hasLast = false;
+            timing = false;
+        }
+    };
+
+    thread_local ThreadTable threadTable;
+
+    // (particle, process, volume) -> merged counts of all threads
+    std::map<std::tuple<std::string, std::string, std::string>, Cell> mergedTable;
+    G4Mutex mergeMutex = G4MUTEX_INITIALIZER;
+}
+
+StepProfiler::StepProfiler() {
+    messenger = new ProfilerMessenger();
+}
+
+StepProfiler::~StepProfiler() {
+    delete messenger;
+}
+
+void StepProfiler::BeginOfRun(const G4bool master) {
+    threadTable.Clear();
+    if (!master) return;
+    G4AutoLock lock(&mergeMutex);
+    mergedTable.clear();
+}
+
+void StepProfiler::ProcessStep(const G4Step *step) {
+    ThreadTable &table = threadTable;
+    const Key key{step->GetTrack()->GetParticleDefinition(), step->GetPostStepPoint()->GetProcessDefinedStep(),
+                  step->GetPreStepPoint()->GetPhysicalVolume()};
+    if (!table.hasLast || !(key == table.lastKey)) {
+        const auto [it, inserted] = table.index.try_emplace(key, static_cast<std::uint32_t>(table.cells.size()));
+        if (inserted) {
+            table.keys.push_back(key);
+            table.cells.emplace_back();
+        }
+        table.lastKey = key;
+        table.lastCell = it->second;
+        table.hasLast = true;
+    }
+    Cell &cell = table.cells[table.lastCell];
+    ++cell.steps;
+    cell.length += step->GetStepLength();
+
+    // The time from here to the next step is the cost of that step
+    if (table.timing) {
+        cell.time += std::chrono::duration<G4double>(Clock::now() - table.start).count();
+        ++cell.timedSteps;
+        table.timing = false;
+    } else if (--table.untilSample <= 0) {
+        table.untilSample = sampleInterval;
+        table.timing = true;
+        table.start = Clock::now();
+    }
+}
+
+void StepProfiler::EndOfEvent() {
+    threadTable.timing = false;
+}
+
+void StepProfiler::MergeThreadTable() {
+    ThreadTable &table = threadTable;
+    if (table.cells.empty()) return;
+    {
+        G4AutoLock lock(&mergeMutex);
+        for (std::size_t i = 0; i < table.cells.size(); ++i) {
+            const Key &key = table.keys[i];
+            mergedTable[{key.particle ? std::string(key.particle->GetParticleName()) : "unknown",
+                         key.process ? std::string(key.process->GetProcessName()) : "none",
+                         key.volume ? std::string(key.volume->GetName()) : "outside"}].Add(table.cells[i]);
+        }
+    }
+    table.Clear();
+}
+
+void StepProfiler::WriteReport(const std::string &filename) {
+    struct Row {
+        std::string particle, process, volume;
+        Cell cell;
+        G4double time;
+    };
+    std::vector<Row> rows;
+    Cell total;
+    G4double totalTime = 0.0;
+    for (const auto &[key, cell]: mergedTable) {
+        rows.push_back(Row{std::get<0>(key), std::get<1>(key), std::get<2>(key), cell, cell.EstimatedTime()});
+        total.Add(cell);
+        totalTime += rows.back().time;
+    }
+    if (total.steps == 0) return;
+    std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) {
+        return a.time != b.time ? a.time > b.time : a.cell.steps > b.cell.steps;
+    });
+
+    std::ostringstream header;
+    header << "Step profile: " << total.steps << " steps, " << total.timedSteps << " timed (every "
+            << sampleInterval << "th), estimated tracking time " << totalTime << " s (all threads)\n"
+            << std::setw(14) << "Particle" << std::setw(22) << "Process" << std::setw(20) << "Volume"
+            << std::setw(14) << "Steps" << std::setw(9) << "Steps %" << std::setw(15) << "Length (mm)"
+            << std::setw(12) << "Time (s)" << std::setw(9) << "Time %" << std::setw(12) << "ns/step" << "\n";
+
+    const auto formatRow = [&](const Row &row) {
+        std::ostringstream line;
+        line << std::setw(14) << row.particle << std::setw(22) << row.process << std::setw(20) << row.volume
+                << std::setw(14) << row.cell.steps
+                << std::setw(9) << std::fixed << std::setprecision(2) << 100.0 * row.cell.steps / total.steps
+                << std::setw(15) << std::defaultfloat << std::setprecision(6) << row.cell.length
+                << std::setw(12) << row.time
+                << std::setw(9) << std::fixed << std::setprecision(2)
+                << (totalTime > 0.0 ? 100.0 * row.time / totalTime : 0.0)
+                << std::setw(12) << std::setprecision(1)
+                << (row.cell.timedSteps > 0 ? 1e9 * row.cell.time / row.cell.timedSteps : 0.0) << "\n";
+        return line.str();
+    };
+
+    const std::size_t shown = topRows > 0 ? std::min(rows.size(), static_cast<std::size_t>(topRows)) : rows.size();
+    G4cout << "\n========================================" << G4endl << header.str();
+    for (std::size_t i = 0; i < shown; ++i) G4cout << formatRow(rows[i]);
+    if (shown < rows.size()) G4cout << "... " << rows.size() - shown << " more rows" << G4endl;
+    G4cout << "========================================\n" << G4endl;
+
+    if (filename.empty()) return;
+    std::ofstream out(filename);
+    out << header.str();
+    for (const Row &row: rows) out << formatRow(row);
+    G4cout << "Step profile saved to " << filename << G4endl;
+}
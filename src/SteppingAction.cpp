@@ -18,11 +18,130 @@
  */
 
 #include "SteppingAction.h"
+#include "DetectorConstruction.h"
+#include "SensitivityAnalysis.h"
+#include "PhaseSpaceRecorder.h"
+#include "StepProfiler.h"
+#include "ImportanceBiasing.h"
+#include "RunAction.h"
 #include "G4Step.hh"
 #include "G4RunManager.hh"
+#include "G4AutoLock.hh"
+#include <algorithm>
+#include <cmath>
 
 std::map<std::string, G4double> SteppingAction::doseMap;
+std::map<std::string, G4double> SteppingAction::doseSquaredMap;
 std::map<std::string, G4double> SteppingAction::volumeMap;
+std::map<std::string, std::vector<G4double> > SteppingAction::replicaDoseMap;
+G4int SteppingAction::replicas = 0;
+std::map<std::string, std::vector<G4double> > SteppingAction::sectorDoseMap;
+G4int SteppingAction::sectors = 0;
+
+namespace {
+    // Reproducible runs sum in fixed point (2^-52 MeV): integer sums do not depend on the order of the events
+    __extension__ typedef __int128 Fixed;
+    constexpr int kFixedBits = 52;
+
+    Fixed ToFixed(const G4double value) {
+        const G4double whole = std::floor(value);
+        return (static_cast<Fixed>(static_cast<long long>(whole)) << kFixedBits) +
+               std::llround(std::ldexp(value - whole, kFixedBits));
+    }
+
+    G4double ToDouble(const Fixed value) {
+        const Fixed whole = value >> kFixedBits;
+        return static_cast<G4double>(whole) + std::ldexp(static_cast<G4double>(value - (whole << kFixedBits)),
+                                                         -kFixedBits);
+    }
+
+    struct FixedTally {
+        Fixed sum{0};
+        Fixed sum2{0};
+        std::vector<Fixed> replicaSum;
+        std::vector<Fixed> sectorSum;
+    };
+
+    // Per-thread scoring state: no locking in the event loop
+    thread_local std::map<std::string, G4double> eventDeposits;
+    thread_local std::map<std::string, SteppingAction::Tally> threadTallies;
+    thread_local std::map<std::string, FixedTally> threadFixedTallies;
+
+    // Shared fixed-point sums of a reproducible run, the dose maps hold their conversion
+    std::map<std::string, FixedTally> fixedTallies;
+
+    template<typename T>
+    void AddInto(std::vector<T> &target, const std::vector<T> &source) {
+        if (source.empty()) return;
+        target.resize(std::max(target.size(), source.size()), T{0});
+        for (std::size_t i = 0; i < source.size(); ++i) target[i] += source[i];
+    }
+
+    template<typename TallyType, typename Convert>
+    void AddEvent(TallyType &tally, const G4double deposit, const G4int replicas, const G4int replica,
+                  const G4int sectors, const G4int sector, Convert convert) {
+        tally.sum += convert(deposit);
+        tally.sum2 += convert(deposit * deposit);
+        if (replicas > 0) {
+            tally.replicaSum.resize(replicas, 0);
+            tally.replicaSum[replica] += convert(deposit);
+        }
+        if (sectors > 0) {
+            tally.sectorSum.resize(sectors, 0);
+            tally.sectorSum[sector] += convert(deposit);
+        }
+    }
+
+    FixedTally ToFixed(const SteppingAction::Tally &tally) {
+        FixedTally fixed{ToFixed(tally.sum), ToFixed(tally.sum2), {}, {}};
+        for (const G4double sum: tally.replicaSum) fixed.replicaSum.push_back(ToFixed(sum));
+        for (const G4double sum: tally.sectorSum) fixed.sectorSum.push_back(ToFixed(sum));
+        return fixed;
+    }
+
+    SteppingAction::Tally ToDouble(const FixedTally &fixed) {
+        SteppingAction::Tally tally{ToDouble(fixed.sum), ToDouble(fixed.sum2), {}, {}};
+        for (const Fixed sum: fixed.replicaSum) tally.replicaSum.push_back(ToDouble(sum));
+        for (const Fixed sum: fixed.sectorSum) tally.sectorSum.push_back(ToDouble(sum));
+        return tally;
+    }
+
+    void AddFixed(FixedTally &target, const FixedTally &source) {
+        target.sum += source.sum;
+        target.sum2 += source.sum2;
+        AddInto(target.replicaSum, source.replicaSum);
+        AddInto(target.sectorSum, source.sectorSum);
+    }
+
+    G4Mutex mergeMutex = G4MUTEX_INITIALIZER;
+
+    // Bytes of a std::map: per node the tree links, the key (heap part beyond the short-string buffer) and the value
+    template<typename Value, typename ValueBytes>
+    std::size_t MapFootprint(const std::map<std::string, Value> &map, ValueBytes valueBytes) {
+        constexpr std::size_t nodeLinks = 4 * sizeof(void *);
+        std::size_t bytes = sizeof(map);
+        for (const auto &[name, value]: map) {
+            bytes += nodeLinks + sizeof(std::pair<const std::string, Value>) + valueBytes(value);
+            if (name.capacity() > 15) bytes += name.capacity() + 1;
+        }
+        return bytes;
+    }
+
+    template<typename T>
+    std::size_t VectorFootprint(const std::vector<T> &vector) { return vector.capacity() * sizeof(T); }
+
+    std::size_t TallyFootprint(const SteppingAction::Tally &tally) {
+        return VectorFootprint(tally.replicaSum) + VectorFootprint(tally.sectorSum);
+    }
+
+    std::size_t FixedTallyFootprint(const FixedTally &tally) {
+        return VectorFootprint(tally.replicaSum) + VectorFootprint(tally.sectorSum);
+    }
+
+    std::size_t NoFootprint(const G4double) { return 0; }
+
+    std::size_t VectorValueFootprint(const std::vector<G4double> &vector) { return VectorFootprint(vector); }
+}
 
 SteppingAction::SteppingAction()
 = default;
@@ -31,6 +150,13 @@ SteppingAction::~SteppingAction()
 = default;
 
 void SteppingAction::UserSteppingAction(const G4Step *step) {
+    if (StepProfiler::IsActive()) StepProfiler::ProcessStep(step);
+
+    // Correlated-sampling weights must follow every photon step, not only those depositing energy
+    if (SensitivityAnalysis::IsActive()) SensitivityAnalysis::ProcessStep(step);
+    if (PhaseSpaceRecorder::IsRecording()) PhaseSpaceRecorder::ProcessStep(step);
+    if (ImportanceBiasing::IsPiloting()) ImportanceBiasing::ProcessStep(step);
+
     // Get energy deposition in this step
     const G4double energyDep = step->GetTotalEnergyDeposit();
 
@@ -42,14 +168,121 @@ void SteppingAction::UserSteppingAction(const G4Step *step) {
 
     const G4String volumeName = volume->GetName();
 
-    // Skip world volume
-    if (volumeName == "World") return;
+    // Skip the world and the air envelope of the Woodcock region
+    if (volumeName == "World" || volumeName == DetectorConstruction::kSpecimenRegion) return;
 
     // Accumulate energy deposition for this volume
     const std::string &volNameStr = volumeName;
-    doseMap[volNameStr] += energyDep;
+    // Weighted by the statistical weight of the track (phase-space and ray-file sources carry weights)
+    eventDeposits[volNameStr] += energyDep * step->GetPreStepPoint()->GetWeight();
+}
+
+void SteppingAction::EndOfEvent(const G4int replica, const G4int sector) {
+    const G4bool reproducible = RunAction::IsReproducible();
+    for (auto &[name, deposit]: eventDeposits) {
+        if (deposit == 0.0) continue;
+        if (reproducible) {
+            AddEvent(threadFixedTallies[name], deposit, replicas, replica, sectors, sector,
+                     [](const G4double value) { return ToFixed(value); });
+        } else {
+            AddEvent(threadTallies[name], deposit, replicas, replica, sectors, sector,
+                     [](const G4double value) { return value; });
+        }
+        deposit = 0.0;
+    }
+}
+
+void SteppingAction::Tally::Add(const Tally &other) {
+    sum += other.sum;
+    sum2 += other.sum2;
+    AddInto(replicaSum, other.replicaSum);
+    AddInto(sectorSum, other.sectorSum);
+}
+
+void SteppingAction::MergeThreadTallies() {
+    AddTallies(threadTallies);
+    threadTallies.clear();
+    if (!threadFixedTallies.empty()) {
+        G4AutoLock lock(&mergeMutex);
+        for (const auto &[name, fixed]: threadFixedTallies) AddFixed(fixedTallies[name], fixed);
+        UpdateFromFixed();
+        threadFixedTallies.clear();
+    }
+}
+
+void SteppingAction::UpdateFromFixed() {
+    for (const auto &[name, fixed]: fixedTallies) {
+        const Tally tally = ToDouble(fixed);
+        doseMap[name] = tally.sum;
+        doseSquaredMap[name] = tally.sum2;
+        if (!tally.replicaSum.empty()) replicaDoseMap[name] = tally.replicaSum;
+        if (!tally.sectorSum.empty()) sectorDoseMap[name] = tally.sectorSum;
+    }
+}
+
+void SteppingAction::AddTallies(const std::map<std::string, Tally> &tallies) {
+    G4AutoLock lock(&mergeMutex);
+    if (RunAction::IsReproducible()) {
+        for (const auto &[name, tally]: tallies) AddFixed(fixedTallies[name], ToFixed(tally));
+        UpdateFromFixed();
+        return;
+    }
+    for (const auto &[name, tally]: tallies) {
+        doseMap[name] += tally.sum;
+        doseSquaredMap[name] += tally.sum2;
+        if (!tally.replicaSum.empty()) AddInto(replicaDoseMap[name], tally.replicaSum);
+        if (!tally.sectorSum.empty()) AddInto(sectorDoseMap[name], tally.sectorSum);
+    }
+}
+
+std::map<std::string, SteppingAction::Tally> SteppingAction::GetThreadTallies() {
+    std::map<std::string, Tally> tallies = threadTallies;
+    for (const auto &[name, fixed]: threadFixedTallies) tallies[name].Add(ToDouble(fixed));
+    return tallies;
+}
+
+std::size_t SteppingAction::GetThreadFootprint() {
+    return MapFootprint(eventDeposits, NoFootprint) + MapFootprint(threadTallies, TallyFootprint) +
+           MapFootprint(threadFixedTallies, FixedTallyFootprint);
+}
+
+std::size_t SteppingAction::GetSharedFootprint() {
+    G4AutoLock lock(&mergeMutex);
+    return MapFootprint(doseMap, NoFootprint) + MapFootprint(doseSquaredMap, NoFootprint) +
+           MapFootprint(replicaDoseMap, VectorValueFootprint) + MapFootprint(sectorDoseMap, VectorValueFootprint) +
+           MapFootprint(fixedTallies, FixedTallyFootprint) + MapFootprint(volumeMap, NoFootprint);
+}
+
+std::map<std::string, SteppingAction::Tally> SteppingAction::GetMergedTallies() {
+    G4AutoLock lock(&mergeMutex);
+    std::map<std::string, Tally> tallies;
+    for (const auto &[name, sum]: doseMap) tallies[name].sum = sum;
+    for (const auto &[name, sum2]: doseSquaredMap) tallies[name].sum2 = sum2;
+    for (const auto &[name, replicaSum]: replicaDoseMap) tallies[name].replicaSum = replicaSum;
+    for (const auto &[name, sectorSum]: sectorDoseMap) tallies[name].sectorSum = sectorSum;
+    return tallies;
+}
+
+void SteppingAction::ClearTallies(const G4bool master) {
+    eventDeposits.clear();
+    threadTallies.clear();
+    threadFixedTallies.clear();
+    if (master) {
+        G4AutoLock lock(&mergeMutex);
+        fixedTallies.clear();
+        doseMap.clear();
+        doseSquaredMap.clear();
+        replicaDoseMap.clear();
+        sectorDoseMap.clear();
+    }
 }
 
 std::map<std::string, G4double> &SteppingAction::getDoseMap() { return doseMap; }
 
+std::map<std::string, G4double> &SteppingAction::getDoseSquaredMap() { return doseSquaredMap; }
+
+std::map<std::string, std::vector<G4double> > &SteppingAction::getReplicaDoseMap() { return replicaDoseMap; }
+
+std::map<std::string, std::vector<G4double> > &SteppingAction::getSectorDoseMap() { return sectorDoseMap; }
+
 std::map<std::string, G4double> &SteppingAction::getVolumeMap() { return volumeMap; }
@@ -0,0 +1,166 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "SweepEngine.h"
+#include "SweepMessenger.h"
+#include "RunAction.h"
+#include "ScopedRunSettings.h"
+#include "Spectrum.h"
+#include "G4UImanager.hh"
+#include "G4SystemOfUnits.hh"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+SweepEngine::SweepEngine() {
+    messenger = new SweepMessenger(this);
+}
+
+SweepEngine::~SweepEngine() {
+    delete messenger;
+}
+
+void SweepEngine::Clear() {
+    insects.clear();
+    energies.clear();
+    spectra.clear();
+}
+
+void SweepEngine::ReadFile(const std::string &filename) {
+    std::ifstream in(filename);
+    if (!in) {
+        G4cerr << "SweepEngine: cannot open sweep file '" << filename << "'" << G4endl;
+        return;
+    }
+    G4UImanager *uiManager = G4UImanager::GetUIpointer();
+    std::string line;
+    while (std::getline(in, line)) {
+        if (const auto hash = line.find('#'); hash != std::string::npos) line.erase(hash);
+        const auto begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos) continue;
+        line.erase(0, begin);
+        // Only settings: the sweep is started by /sweep/run
+        if (line.rfind("run", 0) == 0 && (line.size() == 3 || std::isspace(static_cast<unsigned char>(line[3])))) {
+            continue;
+        }
+        uiManager->ApplyCommand("/sweep/" + line);
+    }
+}
+
+void SweepEngine::Run() {
+    // Sources in run order: monochromatic energies, then spectrum files
+    struct Source {
+        std::string label; // for the results table and the output file suffix
+        std::vector<G4String> commands;
+    };
+    std::vector<Source> sources;
+    G4double maxEnergy = 0.0;
+    for (const G4double energy: energies) {
+        std::ostringstream label;
+        label << energy / keV << "keV";
+        std::ostringstream setEnergy;
+        setEnergy << std::setprecision(10) << "/generator/setMonoEnergy " << energy / keV << " keV";
+        sources.push_back({label.str(), {setEnergy.str(), "/generator/setMonochromatic true"}});
+        maxEnergy = std::max(maxEnergy, energy);
+    }
+    for (const std::string &file: spectra) {
+        try {
+            maxEnergy = std::max(maxEnergy, Spectrum::FromFile(file)->GetEnergies().back());
+        } catch (const std::runtime_error &error) {
+            G4cerr << "SweepEngine: skipping spectrum '" << file << "': " << error.what() << G4endl;
+            continue;
+        }
+        // Set the file first: in mono mode this does not read it, switching mono off then reads it once
+        sources.push_back({std::filesystem::path(file).stem().string(),
+                           {"/generator/setSpectrumFile " + file, "/generator/setMonochromatic false"}});
+    }
+    if (sources.empty()) sources.push_back({"current", {}});
+    const std::vector<std::string> sweepInsects = insects.empty() ? std::vector<std::string>{""} : insects;
+
+    std::ofstream results(resultsFile, std::ios::trunc);
+    if (!results) {
+        G4cerr << "SweepEngine: cannot write '" << resultsFile << "'" << G4endl;
+        return;
+    }
+    results << std::setw(15) << "Insect" << std::setw(25) << "Source" << std::setw(20) << "Volume Name"
+            << std::setw(12) << "Events" << std::setw(20) << "Dose per photon (Gy)" << std::setw(20)
+            << "Dose rate (Gy/s)" << std::setw(15) << "Rel. error" << std::setw(15) << "Wall time (s)" << "\n";
+
+    // Tables for the whole sweep at once; geometry and materials are the only reasons left to rebuild them.
+    // Per-run output files keep the configured suffix plus the source label.
+    const ScopedRunSettings runSettings(maxEnergy);
+
+    G4UImanager *uiManager = G4UImanager::GetUIpointer();
+
+    G4cout << "SweepEngine: " << sweepInsects.size() * sources.size() << " runs of " << events << " events"
+            << G4endl;
+    // A run that cannot be set up or fails keeps its row, marked FAILED, and the sweep goes on
+    const auto fail = [&results](const std::string &insect, const std::string &source, const std::string &reason) {
+        G4cerr << "SweepEngine: " << (insect.empty() ? "current insect" : insect) << ", " << source << ": " << reason
+                << G4endl;
+        results << std::setw(15) << (insect.empty() ? "current" : insect) << std::setw(25) << source
+                << std::setw(20) << "FAILED" << "\n";
+        results.flush();
+    };
+    for (const std::string &insect: sweepInsects) {
+        // A no-op for the current insect, so the geometry is only rebuilt when it changes
+        if (!insect.empty()) {
+            if (const G4int status = uiManager->ApplyCommand("/detector/selectInsect " + insect); status != 0) {
+                for (const Source &source: sources) {
+                    fail(insect, source.label, "/detector/selectInsect failed (" + std::to_string(status) + ")");
+                }
+                continue;
+            }
+        }
+        for (const Source &source: sources) {
+            G4int status = 0;
+            for (const G4String &command: source.commands) {
+                if ((status = uiManager->ApplyCommand(command)) != 0) {
+                    fail(insect, source.label, "command failed (" + std::to_string(status) + "): " + command);
+                    break;
+                }
+            }
+            if (status != 0) continue;
+            if (!runSettings.BeamOn(events, "_" + source.label)) {
+                fail(insect, source.label, "the run failed or gave no result");
+                continue;
+            }
+
+            // The summary must be the one of this run's insect, not of an earlier one
+            const RunAction::Summary &summary = RunAction::GetLastSummary();
+            if (!insect.empty() && summary.insect != insect) {
+                fail(insect, source.label, "the run simulated '" + summary.insect + "'");
+                continue;
+            }
+            for (const auto &[volume, result]: summary.volumes) {
+                results << std::setw(15) << summary.insect << std::setw(25) << source.label << std::setw(20)
+                        << volume << std::setw(12) << summary.events << std::setw(20) << result.dosePerEvent
+                        << std::setw(20) << result.doseRate << std::setw(15) << result.relError << std::setw(15)
+                        << summary.wallTime << "\n";
+            }
+            results.flush(); // finished runs survive an aborted sweep
+        }
+    }
+
+    G4cout << "SweepEngine: results written to '" << resultsFile << "'" << G4endl;
+}
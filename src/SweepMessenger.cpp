@@ -0,0 +1,124 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "SweepMessenger.h"
+#include "SweepEngine.h"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithAnInteger.hh"
+#include "G4UIcmdWithoutParameter.hh"
+#include "G4UnitsTable.hh"
+#include "G4SystemOfUnits.hh"
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    std::vector<std::string> SplitWords(const G4String &value) {
+        std::istringstream is(value);
+        std::vector<std::string> words;
+        for (std::string word; is >> word;) words.push_back(word);
+        return words;
+    }
+}
+
+SweepMessenger::SweepMessenger(SweepEngine *engine)
+    : engine(engine) {
+    // The sweep drives the runs from the master: do not broadcast these commands to the workers
+    sweepDir = new G4UIdirectory("/sweep/", false);
+    sweepDir->SetGuidance("Parameter sweep over insects and sources in one process");
+
+    insectsCmd = new G4UIcmdWithAString("/sweep/insects", this);
+    insectsCmd->SetGuidance("Insects of the sweep, e.g. 'drosophila leptopilina sitophilus' (default: current)");
+    insectsCmd->SetParameterName("insects", false);
+
+    energiesCmd = new G4UIcmdWithAString("/sweep/energies", this);
+    energiesCmd->SetGuidance("Monochromatic energies of the sweep, optionally followed by a unit (default keV)");
+    energiesCmd->SetParameterName("energies", false);
+
+    spectraCmd = new G4UIcmdWithAString("/sweep/spectra", this);
+    spectraCmd->SetGuidance("Spectrum files of the sweep (relative to spectra/ or absolute)");
+    spectraCmd->SetParameterName("files", false);
+
+    eventsCmd = new G4UIcmdWithAnInteger("/sweep/events", this);
+    eventsCmd->SetGuidance("Events per run of the sweep (default 100000)");
+    eventsCmd->SetParameterName("n", false);
+    eventsCmd->SetRange("n>0");
+
+    resultsFileCmd = new G4UIcmdWithAString("/sweep/resultsFile", this);
+    resultsFileCmd->SetGuidance("Combined results table of the sweep (default sweep_results.txt)");
+    resultsFileCmd->SetParameterName("filename", false);
+
+    readFileCmd = new G4UIcmdWithAString("/sweep/readFile", this);
+    readFileCmd->SetGuidance("Read the sweep settings from a file, one /sweep/ command without the prefix per line");
+    readFileCmd->SetParameterName("filename", false);
+
+    clearCmd = new G4UIcmdWithoutParameter("/sweep/clear", this);
+    clearCmd->SetGuidance("Forget insects, energies and spectra of the sweep");
+
+    runCmd = new G4UIcmdWithoutParameter("/sweep/run", this);
+    runCmd->SetGuidance("Run every insect with every source and write the combined results table");
+    runCmd->AvailableForStates(G4State_Idle);
+}
+
+SweepMessenger::~SweepMessenger() {
+    delete insectsCmd;
+    delete energiesCmd;
+    delete spectraCmd;
+    delete eventsCmd;
+    delete resultsFileCmd;
+    delete readFileCmd;
+    delete clearCmd;
+    delete runCmd;
+    delete sweepDir;
+}
+
+void SweepMessenger::SetNewValue(G4UIcommand *command, G4String newValue) {
+    if (command == insectsCmd) {
+        engine->SetInsects(SplitWords(newValue));
+    } else if (command == energiesCmd) {
+        std::vector<std::string> words = SplitWords(newValue);
+        G4double unit = keV;
+        if (!words.empty() && G4UnitDefinition::IsUnitDefined(words.back())) {
+            unit = G4UnitDefinition::GetValueOf(words.back());
+            words.pop_back();
+        }
+        std::vector<G4double> energies;
+        try {
+            for (const std::string &word: words) energies.push_back(std::stod(word) * unit);
+        } catch (const std::exception &) {
+            G4cerr << "SweepMessenger: cannot read the energies '" << newValue << "'" << G4endl;
+            return;
+        }
+        engine->SetEnergies(energies);
+    } else if (command == spectraCmd) {
+        engine->SetSpectra(SplitWords(newValue));
+    } else if (command == eventsCmd) {
+        engine->SetEvents(G4UIcmdWithAnInteger::GetNewIntValue(newValue));
+    } else if (command == resultsFileCmd) {
+        engine->SetResultsFile(newValue);
+    } else if (command == readFileCmd) {
+        engine->ReadFile(newValue);
+    } else if (command == clearCmd) {
+        engine->Clear();
+    } else if (command == runCmd) {
+        engine->Run();
+    }
+}
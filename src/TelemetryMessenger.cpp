@@ -0,0 +1,75 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "TelemetryMessenger.h"
+#include "RunTelemetry.h"
+#include "G4UIdirectory.hh"
+#include "G4UIcmdWithAString.hh"
+#include "G4UIcmdWithADoubleAndUnit.hh"
+#include "G4UIcmdWithoutParameter.hh"
+#include "G4SystemOfUnits.hh"
+
+TelemetryMessenger::TelemetryMessenger() {
+    // The monitor runs on the master: do not broadcast these commands to the workers
+    telemetryDir = new G4UIdirectory("/telemetry/", false);
+    telemetryDir->SetGuidance("Live progress snapshots of a run (events, rates, ETA, running doses, memory)");
+
+    fileCmd = new G4UIcmdWithAString("/telemetry/setFile", this);
+    fileCmd->SetGuidance("Write the snapshots to this file: JSON (replaced every sample)");
+    fileCmd->SetGuidance("or, for a name ending in .csv, one row per sample");
+    fileCmd->SetParameterName("file", false);
+    fileCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    socketCmd = new G4UIcmdWithAString("/telemetry/setSocket", this);
+    socketCmd->SetGuidance("Serve the latest snapshot over HTTP on this Unix domain socket while a run is going on");
+    socketCmd->SetParameterName("path", false);
+    socketCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    intervalCmd = new G4UIcmdWithADoubleAndUnit("/telemetry/setInterval", this);
+    intervalCmd->SetGuidance("Time between snapshots (default 10 s)");
+    intervalCmd->SetParameterName("interval", false);
+    intervalCmd->SetRange("interval>0");
+    intervalCmd->SetDefaultUnit("s");
+    intervalCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+
+    offCmd = new G4UIcmdWithoutParameter("/telemetry/off", this);
+    offCmd->SetGuidance("Stop writing and serving snapshots");
+    offCmd->AvailableForStates(G4State_PreInit, G4State_Idle);
+}
+
+TelemetryMessenger::~TelemetryMessenger() {
+    delete fileCmd;
+    delete socketCmd;
+    delete intervalCmd;
+    delete offCmd;
+    delete telemetryDir;
+}
+
+void TelemetryMessenger::SetNewValue(G4UIcommand *command, G4String newValue) {
+    if (command == fileCmd) {
+        RunTelemetry::SetFile(newValue);
+    } else if (command == socketCmd) {
+        RunTelemetry::SetSocket(newValue);
+    } else if (command == intervalCmd) {
+        RunTelemetry::SetInterval(G4UIcmdWithADoubleAndUnit::GetNewDoubleValue(newValue) / s);
+    } else if (command == offCmd) {
+        RunTelemetry::SetFile("");
+        RunTelemetry::SetSocket("");
+    }
+}
@@ -0,0 +1,108 @@
+/*
+ * Geant4 based dose simulation for insects
+ * Copyright (C) 2025
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 3 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "TomographyScan.h"
+#include "G4Event.hh"
+#include "G4PrimaryVertex.hh"
+#include "G4PrimaryParticle.hh"
+#include "G4SystemOfUnits.hh"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+void TomographyScan::SetRegular(const G4double scanStart, const G4double scanRange, const G4int projections) {
+    start = scanStart;
+    range = scanRange;
+    continuous = projections <= 0;
+    angles.clear();
+    cumulative.clear();
+    for (G4int i = 0; i < projections; ++i) {
+        angles.push_back(start + range * i / projections);
+        cumulative.push_back(static_cast<G4double>(i + 1) / projections);
+    }
+    active = true;
+}
+
+G4bool TomographyScan::LoadSchedule(const std::string &filename) {
+    std::ifstream in(filename);
+    if (!in) {
+        G4cerr << "TomographyScan: cannot open schedule '" << filename << "'" << G4endl;
+        return false;
+    }
+    std::vector<G4double> fileAngles, exposures;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (const auto hash = line.find('#'); hash != std::string::npos) line.erase(hash);
+        std::istringstream fields(line);
+        G4double angle, exposure = 1.0;
+        if (!(fields >> angle)) continue;
+        fields >> exposure;
+        if (exposure <= 0.0) continue;
+        fileAngles.push_back(angle * deg);
+        exposures.push_back(exposure);
+    }
+    if (fileAngles.empty()) {
+        G4cerr << "TomographyScan: no angles in '" << filename << "'" << G4endl;
+        return false;
+    }
+
+    angles = fileAngles;
+    cumulative.clear();
+    G4double sum = 0.0;
+    for (const G4double exposure: exposures) cumulative.push_back(sum += exposure);
+    for (G4double &c: cumulative) c /= sum;
+
+    const auto [first, last] = std::minmax_element(angles.begin(), angles.end());
+    const G4double step = angles.size() > 1 ? (*last - *first) / static_cast<G4double>(angles.size() - 1) : 1.0 * deg;
+    start = *first;
+    range = *last - *first + step;
+    continuous = false;
+    active = true;
+    G4cout << "TomographyScan: " << angles.size() << " projections from " << start / deg << " to " << *last / deg
+            << " deg" << G4endl;
+    return true;
+}
+
+G4double TomographyScan::Sample(const G4double u) const {
+    if (continuous) return start + u * range;
+    const auto it = std::upper_bound(cumulative.begin(), cumulative.end(), u);
+    return angles[std::min<std::size_t>(it - cumulative.begin(), angles.size() - 1)];
+}
+
+G4int TomographyScan::Sector(const G4double angle) const {
+    if (sectors <= 0 || range <= 0.0) return 0;
+    const auto sector = static_cast<G4int>((angle - start) / range * sectors);
+    return std::clamp(sector, 0, sectors - 1);
+}
+
+void TomographyScan::RotateEvent(G4Event *event, const G4double angle, const G4ThreeVector &axisCentre) const {
+    for (G4int v = 0; v < event->GetNumberOfPrimaryVertex(); ++v) {
+        G4PrimaryVertex *vertex = event->GetPrimaryVertex(v);
+        G4ThreeVector position = vertex->GetPosition() - axisCentre;
+        position.rotate(-angle, axis);
+        position += axisCentre;
+        vertex->SetPosition(position.x(), position.y(), position.z());
+        for (G4int p = 0; p < vertex->GetNumberOfParticle(); ++p) {
+            G4PrimaryParticle *particle = vertex->GetPrimary(p);
+            G4ThreeVector direction = particle->GetMomentumDirection();
+            direction.rotate(-angle, axis);
+            particle->SetMomentumDirection(direction);
+        }
+    }
+}